@@ -0,0 +1,124 @@
+// Host benchmark: JSON vs MessagePack for the REST API bodies
+//
+// Builds the same documents RestApi sends for /api/devices, /api/status and
+// the /api/devices/toggle request/reply, then measures encoded size and
+// encode/decode time with ArduinoJson's JSON and MessagePack serializers.
+//
+// Build and run on the host (ArduinoJson is header-only):
+//   g++ -std=c++17 -O2 -I .pio/libdeps/esp32devV3x/ArduinoJson/src \
+//       bench/msgpack/main.cpp -o bench_msgpack && ./bench_msgpack
+
+#include <ArduinoJson.h>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static const int ITERATIONS = 20000;
+
+// Same shape as RestApi::handleGetDevices for an admin with the default devices
+static void buildDevices(JsonDocument& doc) {
+    const char* names[] = {"Luz_Cozinha", "Luz_Lavanderia", "Luz_Corredor_Quintal", "Luz_Quarto"};
+    const char* alexaNames[] = {"Kitchen Light", "Laundry Light", "Corridor Light", "Bedroom Light"};
+    const int inputPins[][2] = {{25, -1}, {33, -1}, {32, -1}, {26, 27}};
+    const int outputPins[] = {21, 22, 23, 19};
+    
+    JsonArray devicesArray = doc.createNestedArray("devices");
+    for (int i = 0; i < 4; i++) {
+        JsonObject deviceObj = devicesArray.createNestedObject();
+        deviceObj["channel"] = i;
+        deviceObj["name"] = names[i];
+        deviceObj["state"] = (i % 2) == 0;
+        deviceObj["canControl"] = true;
+        deviceObj["alexaEnabled"] = true;
+        deviceObj["alexaName"] = alexaNames[i];
+        
+        JsonArray inputPinsArray = deviceObj.createNestedArray("inputPins");
+        for (int pin : inputPins[i]) {
+            if (pin >= 0) {
+                inputPinsArray.add(pin);
+            }
+        }
+        deviceObj.createNestedArray("outputPins").add(outputPins[i]);
+    }
+}
+
+// Same shape as RestApi::handleGetStatus
+static void buildStatus(JsonDocument& doc) {
+    doc["wifi"]["connected"] = true;
+    doc["wifi"]["ssid"] = "YourWiFiSSID";
+    doc["wifi"]["rssi"] = -61;
+    doc["wifi"]["ip"] = "192.168.0.222";
+    doc["uptime"] = 123456;
+    doc["freeHeap"] = 187324;
+}
+
+// Toggle request body sent by the UI
+static void buildToggleRequest(JsonDocument& doc) {
+    doc["channel"] = 2;
+    doc["state"] = true;
+}
+
+// Toggle reply from RestApi::sendMessage
+static void buildToggleReply(JsonDocument& doc) {
+    doc["success"] = true;
+    doc["message"] = "Device toggled";
+}
+
+typedef void (*Builder)(JsonDocument&);
+
+static double elapsedNs(std::chrono::steady_clock::time_point start, int iterations) {
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+static void bench(const char* name, Builder build) {
+    DynamicJsonDocument source(2048);
+    build(source);
+    
+    std::string json;
+    serializeJson(source, json);
+    std::vector<uint8_t> msgpack(measureMsgPack(source));
+    serializeMsgPack(source, msgpack.data(), msgpack.size());
+    
+    // Encode
+    std::vector<char> buffer(2048);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        serializeJson(source, buffer.data(), buffer.size());
+    }
+    double jsonEncode = elapsedNs(start, ITERATIONS);
+    
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        serializeMsgPack(source, buffer.data(), buffer.size());
+    }
+    double msgpackEncode = elapsedNs(start, ITERATIONS);
+    
+    // Decode
+    DynamicJsonDocument target(2048);
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        deserializeJson(target, json.data(), json.size());
+    }
+    double jsonDecode = elapsedNs(start, ITERATIONS);
+    
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        deserializeMsgPack(target, msgpack.data(), msgpack.size());
+    }
+    double msgpackDecode = elapsedNs(start, ITERATIONS);
+    
+    printf("%-16s %6zu %6zu %8.0f %8.0f %8.0f %8.0f\n", name,
+           json.size(), msgpack.size(), jsonEncode, msgpackEncode, jsonDecode, msgpackDecode);
+}
+
+int main() {
+    printf("%-16s %6s %6s %8s %8s %8s %8s\n", "body", "json B", "mpk B", "json enc", "mpk enc", "json dec", "mpk dec");
+    printf("%-16s %6s %6s %8s %8s %8s %8s\n", "", "", "", "ns", "ns", "ns", "ns");
+    bench("/api/devices", buildDevices);
+    bench("/api/status", buildStatus);
+    bench("toggle request", buildToggleRequest);
+    bench("toggle reply", buildToggleReply);
+    return 0;
+}
@@ -1,8 +1,5 @@
 // Admin panel JavaScript
 document.addEventListener('DOMContentLoaded', function() {
-    // Check if user is logged in and has admin access
-    checkAdminAuth();
-    
     // Setup event listeners
     document.getElementById('logout-btn').addEventListener('click', logout);
     
@@ -12,50 +9,53 @@ document.addEventListener('DOMContentLoaded', function() {
     // Setup modal functionality
     setupModal();
     
-    // Get system status
-    getSystemStatus();
+    // Setup firmware upload
+    document.getElementById('firmware-form').addEventListener('submit', uploadFirmware);
     
-    // Get users
-    getUsers();
+    // Load user, status and devices in one request
+    bootstrap();
     
-    // Get devices
-    getDevices();
+    // Setup event source for status updates
+    setupEventSource();
     
-    // Refresh status every 30 seconds
-    setInterval(getSystemStatus, 30000);
+    // Uptime is counted locally between status events
+    setInterval(renderUptime, 1000);
 });
 
-// Check if user is authenticated and has admin access
-function checkAdminAuth() {
-    fetch('/api/users')
+// Boot time derived from the last reported uptime
+let bootTime = null;
+
+// Load everything the page needs (redirects if not authenticated or not admin)
+function bootstrap() {
+    fetch('/api/bootstrap')
         .then(response => {
             if (response.status === 401) {
                 // Redirect to login page if not authenticated
                 window.location.href = '/login';
                 return;
             }
-            if (response.status === 403) {
-                // Redirect to home page if not admin
-                window.location.href = '/';
-                return;
-            }
             return response.json();
         })
         .then(data => {
-            if (data) {
-                // Get username from session
-                const cookies = document.cookie.split(';');
-                for (let cookie of cookies) {
-                    const [name, value] = cookie.trim().split('=');
-                    if (name === 'username') {
-                        document.getElementById('username').textContent = decodeURIComponent(value);
-                        break;
-                    }
-                }
+            if (!data) {
+                return;
+            }
+            
+            if (!data.user.isAdmin) {
+                // Redirect to home page if not admin
+                window.location.href = '/';
+                return;
             }
+            
+            document.getElementById('username').textContent = data.user.username;
+            renderStatus(data.status);
+            renderDevices(data.devices);
+            
+            // Users are only needed by the admin panel
+            getUsers();
         })
         .catch(error => {
-            console.error('Error checking authentication:', error);
+            console.error('Error loading page:', error);
         });
 }
 
@@ -231,26 +231,39 @@ function populateDeviceCheckboxes() {
         });
 }
 
-// Get system status
-function getSystemStatus() {
-    fetch('/api/status')
-        .then(response => response.json())
-        .then(data => {
-            document.getElementById('wifi-ssid').textContent = data.wifi.ssid;
-            document.getElementById('wifi-signal').textContent = data.wifi.rssi + ' dBm';
-            document.getElementById('ip-address-admin').textContent = data.wifi.ip;
-            
-            // Format uptime
-            const uptime = formatUptime(data.uptime);
-            document.getElementById('uptime-admin').textContent = uptime;
-            
-            // Format memory
-            const memory = formatMemory(data.freeHeap);
-            document.getElementById('free-memory').textContent = memory;
-        })
-        .catch(error => {
-            console.error('Error getting system status:', error);
-        });
+// Setup event source for status updates
+function setupEventSource() {
+    if (!!window.EventSource) {
+        const eventSource = new EventSource('/events');
+        
+        // Pushed only when something shown here changes
+        eventSource.addEventListener('status', function(e) {
+            renderStatus(JSON.parse(e.data));
+        }, false);
+    } else {
+        console.error('EventSource not supported');
+    }
+}
+
+// Show system status
+function renderStatus(data) {
+    document.getElementById('wifi-ssid').textContent = data.wifi.ssid;
+    document.getElementById('wifi-signal').textContent = data.wifi.rssi + ' dBm';
+    document.getElementById('ip-address-admin').textContent = data.wifi.ip;
+    
+    bootTime = Date.now() - data.uptime * 1000;
+    renderUptime();
+    
+    // Format memory
+    const memory = formatMemory(data.freeHeap);
+    document.getElementById('free-memory').textContent = memory;
+}
+
+// Show uptime
+function renderUptime() {
+    if (bootTime !== null) {
+        document.getElementById('uptime-admin').textContent = formatUptime(Math.floor((Date.now() - bootTime) / 1000));
+    }
 }
 
 // Format uptime in days, hours, minutes, seconds
@@ -426,79 +439,82 @@ function deleteUser(username) {
 function getDevices() {
     fetch('/api/devices')
         .then(response => response.json())
-        .then(data => {
-            const devicesTableBody = document.getElementById('devices-table-body');
-            devicesTableBody.innerHTML = '';
-            
-            data.devices.forEach(device => {
-                const row = document.createElement('tr');
-                
-                // Channel
-                const channelCell = document.createElement('td');
-                channelCell.textContent = device.channel;
-                row.appendChild(channelCell);
-                
-                // Name
-                const nameCell = document.createElement('td');
-                nameCell.textContent = device.name.replace(/_/g, ' ');
-                row.appendChild(nameCell);
-                
-                // State
-                const stateCell = document.createElement('td');
-                const stateSwitch = document.createElement('label');
-                stateSwitch.className = 'switch';
-                
-                const stateInput = document.createElement('input');
-                stateInput.type = 'checkbox';
-                stateInput.checked = device.state;
-                stateInput.addEventListener('change', () => toggleDevice(device.channel, stateInput.checked));
-                
-                const stateSlider = document.createElement('span');
-                stateSlider.className = 'slider';
-                
-                stateSwitch.appendChild(stateInput);
-                stateSwitch.appendChild(stateSlider);
-                stateCell.appendChild(stateSwitch);
-                row.appendChild(stateCell);
-                
-                // Alexa Enabled
-                const alexaCell = document.createElement('td');
-                const alexaSwitch = document.createElement('label');
-                alexaSwitch.className = 'switch';
-                
-                const alexaInput = document.createElement('input');
-                alexaInput.type = 'checkbox';
-                alexaInput.checked = device.alexaEnabled;
-                alexaInput.addEventListener('change', () => toggleAlexaEnabled(device.channel, alexaInput.checked));
-                
-                const alexaSlider = document.createElement('span');
-                alexaSlider.className = 'slider';
-                
-                alexaSwitch.appendChild(alexaInput);
-                alexaSwitch.appendChild(alexaSlider);
-                alexaCell.appendChild(alexaSwitch);
-                row.appendChild(alexaCell);
-                
-                // Actions
-                const actionsCell = document.createElement('td');
-                
-                // Edit button
-                const editButton = document.createElement('button');
-                editButton.className = 'btn btn-primary';
-                editButton.textContent = 'Edit';
-                editButton.addEventListener('click', () => editDevice(device));
-                actionsCell.appendChild(editButton);
-                
-                row.appendChild(actionsCell);
-                
-                devicesTableBody.appendChild(row);
-            });
-        })
+        .then(data => renderDevices(data.devices))
         .catch(error => {
             console.error('Error getting devices:', error);
         });
 }
 
+// Show devices table
+function renderDevices(devices) {
+    const devicesTableBody = document.getElementById('devices-table-body');
+    devicesTableBody.innerHTML = '';
+    
+    devices.forEach(device => {
+        const row = document.createElement('tr');
+        
+        // Channel
+        const channelCell = document.createElement('td');
+        channelCell.textContent = device.channel;
+        row.appendChild(channelCell);
+        
+        // Name
+        const nameCell = document.createElement('td');
+        nameCell.textContent = device.name.replace(/_/g, ' ');
+        row.appendChild(nameCell);
+        
+        // State
+        const stateCell = document.createElement('td');
+        const stateSwitch = document.createElement('label');
+        stateSwitch.className = 'switch';
+        
+        const stateInput = document.createElement('input');
+        stateInput.type = 'checkbox';
+        stateInput.checked = device.state;
+        stateInput.addEventListener('change', () => toggleDevice(device.channel, stateInput.checked));
+        
+        const stateSlider = document.createElement('span');
+        stateSlider.className = 'slider';
+        
+        stateSwitch.appendChild(stateInput);
+        stateSwitch.appendChild(stateSlider);
+        stateCell.appendChild(stateSwitch);
+        row.appendChild(stateCell);
+        
+        // Alexa Enabled
+        const alexaCell = document.createElement('td');
+        const alexaSwitch = document.createElement('label');
+        alexaSwitch.className = 'switch';
+        
+        const alexaInput = document.createElement('input');
+        alexaInput.type = 'checkbox';
+        alexaInput.checked = device.alexaEnabled;
+        alexaInput.addEventListener('change', () => toggleAlexaEnabled(device.channel, alexaInput.checked));
+        
+        const alexaSlider = document.createElement('span');
+        alexaSlider.className = 'slider';
+        
+        alexaSwitch.appendChild(alexaInput);
+        alexaSwitch.appendChild(alexaSlider);
+        alexaCell.appendChild(alexaSwitch);
+        row.appendChild(alexaCell);
+        
+        // Actions
+        const actionsCell = document.createElement('td');
+        
+        // Edit button
+        const editButton = document.createElement('button');
+        editButton.className = 'btn btn-primary';
+        editButton.textContent = 'Edit';
+        editButton.addEventListener('click', () => editDevice(device));
+        actionsCell.appendChild(editButton);
+        
+        row.appendChild(actionsCell);
+        
+        devicesTableBody.appendChild(row);
+    });
+}
+
 // Toggle device state
 function toggleDevice(channel, state) {
     fetch('/api/devices/toggle', {
@@ -530,17 +546,74 @@ function toggleDevice(channel, state) {
     });
 }
 
+// Send a partial device update
+function updateDevice(changes) {
+    return fetch('/api/devices/update', {
+        method: 'POST',
+        headers: {
+            'Content-Type': 'application/json'
+        },
+        body: JSON.stringify(changes)
+    })
+    .then(response => response.json().then(data => {
+        if (!response.ok || !data.success) {
+            throw new Error(data.message || 'Failed to update device');
+        }
+        return data;
+    }));
+}
+
 // Toggle Alexa enabled
 function toggleAlexaEnabled(channel, enabled) {
-    // This would be implemented in a real system
-    console.log(`Toggle Alexa enabled for device ${channel}: ${enabled}`);
+    updateDevice({
+        channel: channel,
+        alexaEnabled: enabled
+    })
+    .catch(error => {
+        alert(error.message);
+        getDevices();
+    });
+}
+
+// Parse a comma separated pin list
+function parsePins(value) {
+    return value.split(',')
+        .map(pin => pin.trim())
+        .filter(pin => pin.length > 0)
+        .map(pin => parseInt(pin));
 }
 
 // Edit device
 function editDevice(device) {
-    // This would be implemented in a real system
-    console.log('Edit device:', device);
-    alert('Device editing not implemented in this demo');
+    const name = prompt('Device name', device.name);
+    if (name === null) {
+        return;
+    }
+    
+    const alexaName = prompt('Alexa name', device.alexaName || name);
+    if (alexaName === null) {
+        return;
+    }
+    
+    const inputPins = prompt('Input pins (comma separated)', (device.inputPins || []).join(', '));
+    if (inputPins === null) {
+        return;
+    }
+    
+    const outputPins = prompt('Output pins (comma separated)', (device.outputPins || []).join(', '));
+    if (outputPins === null) {
+        return;
+    }
+    
+    updateDevice({
+        channel: device.channel,
+        name: name,
+        alexaName: alexaName,
+        inputPins: parsePins(inputPins),
+        outputPins: parsePins(outputPins)
+    })
+    .then(() => getDevices())
+    .catch(error => alert(error.message));
 }
 
 // Logout function
@@ -558,3 +631,45 @@ function logout() {
         console.error('Error logging out:', error);
     });
 }
+
+// Upload a firmware image (XHR, for upload progress)
+function uploadFirmware(e) {
+    e.preventDefault();
+    
+    const file = document.getElementById('firmware-file').files[0];
+    const sha256 = document.getElementById('firmware-sha256').value.trim();
+    const progress = document.getElementById('firmware-progress');
+    const message = document.getElementById('firmware-message');
+    
+    const xhr = new XMLHttpRequest();
+    xhr.open('POST', '/ota/firmware');
+    xhr.setRequestHeader('Content-Type', 'application/octet-stream');
+    xhr.setRequestHeader('X-Firmware-SHA256', sha256);
+    
+    xhr.upload.addEventListener('progress', function(event) {
+        if (event.lengthComputable) {
+            progress.value = Math.round(event.loaded * 100 / event.total);
+        }
+    });
+    
+    xhr.addEventListener('load', function() {
+        let data = {};
+        try {
+            data = JSON.parse(xhr.responseText);
+        } catch (error) {
+            data.message = 'Unexpected response (' + xhr.status + ')';
+        }
+        message.textContent = data.message;
+        message.className = 'form-message ' + (data.success ? 'success' : 'error');
+    });
+    
+    xhr.addEventListener('error', function() {
+        message.textContent = 'Upload failed';
+        message.className = 'form-message error';
+    });
+    
+    progress.value = 0;
+    message.textContent = '';
+    message.className = 'form-message';
+    xhr.send(file);
+}
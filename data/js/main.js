@@ -1,27 +1,24 @@
 // Main JavaScript for the device control interface
 document.addEventListener('DOMContentLoaded', function() {
-    // Check if user is logged in
-    checkAuth();
-    
     // Setup event listeners
     document.getElementById('logout-btn').addEventListener('click', logout);
     
-    // Setup event source for real-time updates
-    setupEventSource();
-    
-    // Get system status
-    getSystemStatus();
+    // Load user, status and devices in one request
+    bootstrap();
     
-    // Get devices
-    getDevices();
+    // Setup event source for real-time updates (device states and status)
+    setupEventSource();
     
-    // Refresh status every 30 seconds
-    setInterval(getSystemStatus, 30000);
+    // Uptime is counted locally between status events
+    setInterval(renderUptime, 1000);
 });
 
-// Check if user is authenticated
-function checkAuth() {
-    fetch('/api/status')
+// Boot time derived from the last reported uptime
+let bootTime = null;
+
+// Load everything the page needs (redirects to login if not authenticated)
+function bootstrap() {
+    fetch('/api/bootstrap')
         .then(response => {
             if (response.status === 401) {
                 // Redirect to login page if not authenticated
@@ -32,55 +29,37 @@ function checkAuth() {
         })
         .then(data => {
             if (data) {
-                // Get username from session
-                const cookies = document.cookie.split(';');
-                for (let cookie of cookies) {
-                    const [name, value] = cookie.trim().split('=');
-                    if (name === 'username') {
-                        document.getElementById('username').textContent = decodeURIComponent(value);
-                        
-                        // Show admin link if user is admin
-                        checkAdminAccess();
-                        break;
-                    }
+                document.getElementById('username').textContent = data.user.username;
+                
+                // Show admin link if user is admin
+                if (data.user.isAdmin) {
+                    document.getElementById('admin-link').style.display = 'inline-block';
                 }
+                
+                renderStatus(data.status);
+                renderDevices(data.devices);
             }
         })
         .catch(error => {
-            console.error('Error checking authentication:', error);
+            console.error('Error loading page:', error);
         });
 }
 
-// Check if user has admin access
-function checkAdminAccess() {
-    fetch('/api/users')
-        .then(response => {
-            if (response.status === 200) {
-                // User is admin, show admin link
-                document.getElementById('admin-link').style.display = 'inline-block';
-            }
-        })
-        .catch(error => {
-            console.error('Error checking admin access:', error);
-        });
+// Show system status
+function renderStatus(data) {
+    document.getElementById('wifi-status').textContent = data.wifi.connected ? 'Connected' : 'Disconnected';
+    document.getElementById('wifi-status').className = 'status-value ' + (data.wifi.connected ? 'connected' : 'disconnected');
+    document.getElementById('ip-address').textContent = data.wifi.ip;
+    
+    bootTime = Date.now() - data.uptime * 1000;
+    renderUptime();
 }
 
-// Get system status
-function getSystemStatus() {
-    fetch('/api/status')
-        .then(response => response.json())
-        .then(data => {
-            document.getElementById('wifi-status').textContent = data.wifi.connected ? 'Connected' : 'Disconnected';
-            document.getElementById('wifi-status').className = 'status-value ' + (data.wifi.connected ? 'connected' : 'disconnected');
-            document.getElementById('ip-address').textContent = data.wifi.ip;
-            
-            // Format uptime
-            const uptime = formatUptime(data.uptime);
-            document.getElementById('uptime').textContent = uptime;
-        })
-        .catch(error => {
-            console.error('Error getting system status:', error);
-        });
+// Show uptime
+function renderUptime() {
+    if (bootTime !== null) {
+        document.getElementById('uptime').textContent = formatUptime(Math.floor((Date.now() - bootTime) / 1000));
+    }
 }
 
 // Format uptime in days, hours, minutes, seconds
@@ -101,22 +80,15 @@ function formatUptime(seconds) {
     return result;
 }
 
-// Get devices
-function getDevices() {
-    fetch('/api/devices')
-        .then(response => response.json())
-        .then(data => {
-            const devicesList = document.getElementById('devices-list');
-            devicesList.innerHTML = '';
-            
-            data.devices.forEach(device => {
-                const deviceCard = createDeviceCard(device);
-                devicesList.appendChild(deviceCard);
-            });
-        })
-        .catch(error => {
-            console.error('Error getting devices:', error);
-        });
+// Show device cards
+function renderDevices(devices) {
+    const devicesList = document.getElementById('devices-list');
+    devicesList.innerHTML = '';
+    
+    devices.forEach(device => {
+        const deviceCard = createDeviceCard(device);
+        devicesList.appendChild(deviceCard);
+    });
 }
 
 // Create device card
@@ -157,9 +129,48 @@ function createDeviceCard(device) {
     deviceCard.appendChild(deviceName);
     deviceCard.appendChild(deviceStatus);
     
+    // Dimmers get a level slider, sent when released
+    if (device.type === 'dimmer') {
+        const levelInput = document.createElement('input');
+        levelInput.type = 'range';
+        levelInput.className = 'level-slider';
+        levelInput.min = 1;
+        levelInput.max = 255;
+        levelInput.value = device.level;
+        levelInput.disabled = !device.canControl;
+        levelInput.addEventListener('change', () => setLevel(device.channel, parseInt(levelInput.value, 10)));
+        deviceCard.appendChild(levelInput);
+    }
+    
     return deviceCard;
 }
 
+// Set dimmer level
+function setLevel(channel, level) {
+    fetch('/api/devices/level', {
+        method: 'POST',
+        headers: {
+            'Content-Type': 'application/json'
+        },
+        body: JSON.stringify({
+            channel: channel,
+            level: level
+        })
+    })
+    .then(response => {
+        if (!response.ok) {
+            throw new Error('Failed to set level');
+        }
+        return response.json();
+    })
+    .then(data => {
+        console.log('Level set:', data);
+    })
+    .catch(error => {
+        console.error('Error setting level:', error);
+    });
+}
+
 // Toggle device state
 function toggleDevice(channel, state) {
     fetch('/api/devices/toggle', {
@@ -196,9 +207,17 @@ function setupEventSource() {
     if (!!window.EventSource) {
         const eventSource = new EventSource('/events');
         
-        eventSource.addEventListener('state', function(e) {
+        // Full state on connect (or after falling behind), then batched changes
+        const applyStates = function(e) {
             const data = JSON.parse(e.data);
-            updateDeviceState(data.channel, data.state);
+            data.devices.forEach(device => updateDeviceState(device.channel, device.state));
+        };
+        eventSource.addEventListener('snapshot', applyStates, false);
+        eventSource.addEventListener('states', applyStates, false);
+        
+        // Pushed only when something shown here changes
+        eventSource.addEventListener('status', function(e) {
+            renderStatus(JSON.parse(e.data));
         }, false);
         
         eventSource.addEventListener('error', function(e) {
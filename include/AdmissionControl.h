@@ -0,0 +1,92 @@
+#ifndef ADMISSION_CONTROL_H
+#define ADMISSION_CONTROL_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <vector>
+#include <ESPAsyncWebServer.h>
+
+// Request priority classes, lowest priority is shed first
+enum class RequestPriority {
+    CONTROL,    // Device control, never shed
+    NORMAL,     // API reads and event streams
+    BULK        // Static files, admin pages and admin API
+};
+
+// Memory / concurrency pressure levels
+enum class PressureLevel {
+    NONE,
+    ELEVATED,   // Bulk traffic is rejected
+    CRITICAL    // Only device control is admitted
+};
+
+// Called for every admitted request (e.g. to keep the radio awake)
+typedef std::function<void()> ActivityListener;
+
+class AdmissionControl {
+private:
+    ActivityListener activityListener = nullptr;
+    
+    // Requests currently being processed
+    std::atomic<int> inFlight;
+    
+    // Handlers run when a request's connection is released. Requests keep a
+    // single disconnect handler, so everything that needs one shares it
+    // through onRelease() (only used from the async_tcp task)
+    std::map<AsyncWebServerRequest*, std::vector<ArDisconnectHandler>> releaseHandlers;
+    
+    // Statistics
+    std::atomic<int> peakInFlight;
+    std::atomic<uint32_t> minLargestBlock;
+    std::atomic<uint32_t> admittedCount;
+    std::atomic<uint32_t> shedCount;
+    
+    // Thresholds
+    uint32_t elevatedMinBlock = 24 * 1024;   // Largest free block below this = elevated
+    uint32_t criticalMinBlock = 12 * 1024;   // Largest free block below this = critical
+    int elevatedMaxInFlight = 6;
+    int criticalMaxInFlight = 10;
+    int retryAfterSeconds = 5;
+    
+    // Classify a request by URL
+    RequestPriority classify(AsyncWebServerRequest *request);
+    
+    // Reject a request with 503 and Retry-After
+    void reject(AsyncWebServerRequest *request);
+    
+    // Run and forget the release handlers of a request
+    void release(AsyncWebServerRequest *request);
+
+public:
+    AdmissionControl();
+    
+    // Install the admission middleware on a server (must run before routes are added)
+    void attach(AsyncWebServer* server);
+    
+    // Set the listener called for every admitted request
+    void onActivity(ActivityListener listener);
+    
+    // Run a handler once the request's connection is released; routes use this
+    // instead of request->onDisconnect(), which would replace the tracking
+    void onRelease(AsyncWebServerRequest *request, ArDisconnectHandler handler);
+    
+    // Configure thresholds
+    void setThresholds(uint32_t elevatedMinBlock, uint32_t criticalMinBlock, int elevatedMaxInFlight, int criticalMaxInFlight);
+    
+    // Current pressure level
+    PressureLevel getPressureLevel();
+    
+    // Check whether a request of the given priority would be admitted now
+    bool admit(RequestPriority priority);
+    
+    // Statistics
+    int getInFlight();
+    int getPeakInFlight();
+    uint32_t getMinLargestBlock();
+    uint32_t getAdmittedCount();
+    uint32_t getShedCount();
+};
+
+#endif // ADMISSION_CONTROL_H
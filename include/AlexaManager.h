@@ -1,25 +1,119 @@
 #ifndef ALEXA_MANAGER_H
 #define ALEXA_MANAGER_H
 
+// Use the application's AsyncWebServer instead of a second server on port 80
+#define ESPALEXA_ASYNC
+
 #include <Arduino.h>
+#include <map>
+#include <memory>
+#include <ESPAsyncWebServer.h>
 #include <Espalexa.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "DeviceManager.h"
+#include "ControlPlane.h"
+
+// Number of Hue light ids the registry can hand out
+#define ALEXA_MAX_SLOTS 32
+
+// A Hue light id assigned to a channel. The assignment is kept (and saved)
+// when the device is disabled or removed, so an Echo that already knows the
+// light keeps controlling the same channel if it comes back.
+struct AlexaSlot {
+    int channel;            // Owning channel, -1 when free
+    bool active;            // Listed in discovery and accepting commands
+    bool dimmable;          // Exposed as a dimmable light
+    bool state;             // Last known on/off state
+    uint8_t brightness;     // Hue brightness (1-254)
+    std::string name;       // Name shown in the Alexa app
+    std::shared_ptr<const String> rendered;     // Hue JSON of the light, null until rendered
+};
 
+// Alexa (Hue bridge emulation) integration.
+// Espalexa is created once and only answers SSDP discovery, description.xml
+// and pairing; the /api/<user>/lights endpoints are served here from the
+// slot registry, so devices can be added, renamed, disabled or removed
+// one slot at a time without rebuilding Espalexa.
+// Light JSON and the discovery document are rendered once per change and
+// shared with every response, so repeated polls don't build JSON.
+// Commands are answered as soon as they are posted to the control plane,
+// which applies them to the devices, so a slow flash write never delays the
+// Hue reply.
 class AlexaManager {
 private:
     Espalexa* alexa;
     DeviceManager* deviceManager;
+    ControlPlane* controlPlane = nullptr;
     bool initialized;
+    const char* configFile = "/alexa.json";
+    
+    // Slot registry (index + 1 is the Hue light id), guarded by mutex
+    SemaphoreHandle_t mutex;
+    AlexaSlot slots[ALEXA_MAX_SLOTS];
+    
+    // Device state changes waiting to be applied by handle()
+    std::map<int, bool> pendingStates;
+    
+    // Discovery document assembled from the rendered lights, null until
+    // the next discovery request after a change
+    std::shared_ptr<const String> discoveryDoc;
+    
+    // MAC derived parts of light keys and unique ids
+    uint32_t lightKeyPrefix;
+    String uniqueIdPrefix;
+    
+    // Find the slot assigned to a channel, -1 if none
+    int findSlot(int channel);
+    
+    // Find or assign a slot for a channel, -1 if the registry is full
+    int assignSlot(int channel);
+    
+    // Load slot assignments from file system
+    bool loadSlots();
     
-    // Map to store device IDs by channel
-    std::map<int, uint8_t> deviceIds;
+    // Save slot assignments to file system
+    bool saveSlots();
     
+    // Light key used by Alexa for a slot
+    uint32_t lightKey(int slot);
+    
+    // Slot for a light key, -1 if unknown
+    int slotFromKey(uint32_t key);
+    
+    // Fill in the Hue description of a slot
+    void fillLight(JsonObject lightObj, int slot);
+    
+    // Drop the rendered JSON of a slot and the discovery document
+    void markChanged(int slot);
+    
+    // Rendered Hue JSON of a slot, rendered again only after a change
+    std::shared_ptr<const String> renderLight(int slot);
+    
+    // Discovery document, assembled again only after a change
+    std::shared_ptr<const String> renderDiscovery();
+    
+    // Send rendered JSON, keeping it alive until the response is done
+    void sendRendered(AsyncWebServerRequest* request, std::shared_ptr<const String> json);
+    
+    // Handle a Hue lights request (list, single light or state change)
+    void handleHueRequest(AsyncWebServerRequest* request, uint8_t* body, size_t len);
+    
+    // Apply pending device state changes to their slots
+    void applyPendingStates();
+    
+    // Send a Hue "resource not available" error
+    void sendHueError(AsyncWebServerRequest* request, const String& address);
+
 public:
     AlexaManager(DeviceManager* deviceManager);
     ~AlexaManager();
     
-    // Initialize Alexa integration
-    bool begin();
+    // Initialize Alexa integration on the given server
+    bool begin(AsyncWebServer* server);
+    
+    // Set the control plane that applies Alexa commands
+    void setControlPlane(ControlPlane* controlPlane);
     
     // Handle Alexa events (should be called in loop)
     void handle();
@@ -33,8 +127,9 @@ public:
     // Update all devices in Alexa
     void updateAllDevices();
     
-    // Device callback (called when Alexa changes device state)
-    void deviceCallback(int channel, uint8_t brightness);
+    // Device callback (called when Alexa changes device state), returns
+    // false if the command couldn't be queued
+    bool deviceCallback(int channel, uint8_t brightness);
 };
 
 #endif // ALEXA_MANAGER_H
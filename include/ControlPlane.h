@@ -0,0 +1,89 @@
+#ifndef CONTROL_PLANE_H
+#define CONTROL_PLANE_H
+
+#include <Arduino.h>
+#include <functional>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "DeviceManager.h"
+#include "MpscQueue.h"
+
+// What a device command does
+enum class DeviceCommandType {
+    TOGGLE,         // Invert the output
+    SET_STATE,      // Switch on or off
+    SET_LEVEL,      // Set a dimmer's level (0 = off)
+    CALL            // Run a function on the control plane and report its result
+};
+
+// A function run on the control plane, with the caller waiting for it
+struct ControlPlaneCall {
+    std::function<bool()> function;
+    bool result;
+    SemaphoreHandle_t done;
+};
+
+// A command posted to the control plane
+struct DeviceCommand {
+    DeviceCommandType type;
+    int channel;
+    bool state;                 // SET_STATE
+    uint8_t level;              // SET_LEVEL
+    uint16_t fadeMs;            // SET_LEVEL
+    ControlPlaneCall* call;     // CALL
+    uint32_t postedMicros;
+};
+
+// Device control plane.
+// A single task owns every DeviceManager mutation. Buttons, REST handlers
+// and Alexa post commands through a lock-free queue and return at once;
+// the task applies them in arrival order. It runs on core 1 at a priority
+// above the web server and below the Wi-Fi/lwIP tasks on core 0, so a busy
+// network stack can't hold up a relay.
+// The same task scans the buttons and saves coalesced state changes; the
+// devices file itself is written by DeviceManager's lower priority writer.
+// Configuration changes (add, update, delete) run on it through call();
+// other tasks read devices through DeviceManager's locked copies.
+class ControlPlane {
+public:
+    static const size_t QUEUE_LENGTH = 32;
+    static const uint32_t INPUT_SCAN_MS = 30;          // Button scan period (also debounces)
+    static const UBaseType_t TASK_PRIORITY = 12;       // Above async_tcp (10)
+    static const BaseType_t TASK_CORE = 1;
+
+private:
+    DeviceManager* deviceManager;
+    MpscQueue<DeviceCommand, QUEUE_LENGTH> queue;
+    TaskHandle_t taskHandle;
+    
+    // Control plane task
+    static void task(void* parameter);
+    
+    // Apply a command to the devices
+    void execute(const DeviceCommand& command);
+
+public:
+    ControlPlane(DeviceManager* deviceManager);
+    
+    // Start the control plane task
+    bool begin();
+    
+    // Post a command, returns false if the queue is full
+    bool post(DeviceCommand command);
+    
+    // Post a toggle
+    bool toggle(int channel);
+    
+    // Post an on/off command
+    bool setState(int channel, bool state);
+    
+    // Post a dimmer level (0 = off)
+    bool setLevel(int channel, uint8_t level, uint16_t fadeMs = DeviceManager::DIMMER_DEFAULT_FADE_MS);
+    
+    // Run a function on the control plane and wait for its result
+    // (runs directly before the task is started or when called from it)
+    bool call(std::function<bool()> function);
+};
+
+#endif // CONTROL_PLANE_H
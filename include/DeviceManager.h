@@ -4,8 +4,20 @@
 #include <Arduino.h>
 #include <vector>
 #include <string>
+#include <atomic>
+#include <functional>
 #include <ArduinoJson.h>
 #include <LittleFS.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "driver/ledc.h"
+
+// Kind of output a device drives
+enum class DeviceType {
+    RELAY,      // On/off relay, active low
+    DIMMER      // PWM output faded by the LEDC peripheral, active high
+};
 
 // Device structure
 struct Device {
@@ -17,20 +29,87 @@ struct Device {
     std::string name;
     std::string alexaName;  // Name for Alexa integration
     bool alexaEnabled;      // Whether this device is exposed to Alexa
+    DeviceType type = DeviceType::RELAY;
+    uint8_t level = 255;    // Dimmer brightness when on (1-255)
+    int ledcChannel = -1;   // LEDC channel driving a dimmer, assigned at runtime
 };
 
+// Called after a device output changes state
+typedef std::function<void(int channel, bool state)> DeviceStateListener;
+
 class DeviceManager {
+public:
+    // Dimmer PWM settings
+    static const uint32_t DIMMER_PWM_FREQUENCY = 5000;
+    static const ledc_timer_bit_t DIMMER_RESOLUTION = LEDC_TIMER_10_BIT;
+    static const uint32_t DIMMER_MAX_DUTY = (1 << 10) - 1;
+    static const uint8_t DIMMER_MAX_CHANNELS = 8;
+    static const uint16_t DIMMER_DEFAULT_FADE_MS = 400;
+    static const uint16_t DIMMER_MAX_FADE_MS = 10000;
+    
+    // Quiet time before state changes are written to file
+    static const uint32_t STATE_SAVE_DELAY_MS = 2000;
+    
+    // File writer task, below the control plane so flash writes never hold up a relay
+    static const UBaseType_t WRITER_PRIORITY = 1;
+    static const BaseType_t WRITER_CORE = 1;
+
 private:
+    // Only the control plane changes the list and reads it without the lock;
+    // it holds mutex while changing it, and other tasks get copies made under it
     std::vector<Device> devices;
+    SemaphoreHandle_t mutex;
+    std::vector<DeviceStateListener> stateListeners;
     String configFile = "/devices.json";
     bool initialized = false;
     
-    // Save devices to file
+    // LEDC channels in use by dimmers (bit per channel)
+    uint8_t ledcChannelsUsed = 0;
+    bool fadeInstalled = false;
+    
+    // State changes not yet written to file
+    std::atomic<bool> savePending;
+    std::atomic<uint32_t> lastStateChange;
+    
+    // Devices file contents waiting for the writer task (latest wins)
+    TaskHandle_t writerHandle;
+    SemaphoreHandle_t writeMutex;
+    String pendingWrite;
+    bool writePending;
+    
+    // Save devices to file, handing the write to the writer task once it runs
     bool saveDevices();
     
+    // Serialize the devices file contents
+    String serializeDevices();
+    
+    // Write the devices file
+    bool writeFile(const String& json);
+    
+    // Writer task
+    static void writerTask(void* parameter);
+    
+    // Save state changes once they settle, coalescing bursts into one write
+    void scheduleSave();
+    
+    // Drive a dimmer output to its current level, fading over fadeMs
+    void writeDimmer(const Device& device, uint16_t fadeMs);
+    
     // Load devices from file
     bool loadDevices();
     
+    // Configure the GPIOs used by a single device
+    void setupDevicePins(Device& device);
+    
+    // Return the GPIOs used by a single device to a safe, unconfigured state
+    void releaseDevicePins(const Device& device);
+    
+    // Check if a pin is used by any device other than the given channel
+    bool isPinInUse(int pin, int ignoreChannel);
+    
+    // Get device by channel (live entry, control plane only)
+    Device* getDeviceByChannel(int channel);
+
 public:
     DeviceManager();
     
@@ -49,23 +128,41 @@ public:
     // Delete a device
     bool deleteDevice(int channel);
     
-    // Get all devices
-    std::vector<Device>& getAllDevices();
+    // Validate a device definition (pins, state vectors, conflicts with other channels)
+    bool validateDevice(const Device& device, int ignoreChannel, String& error);
     
-    // Get device by channel
-    Device* getDeviceByChannel(int channel);
+    // Get a copy of all devices (safe from any task)
+    std::vector<Device> getAllDevices();
     
-    // Toggle device state
-    bool toggleDevice(int channel, bool newState = -1);
+    // Get a copy of a device, returns false if there is none (safe from any task)
+    bool getDevice(int channel, Device& device);
+    
+    // Check if a device exists (safe from any task)
+    bool hasDevice(int channel);
+    
+    // Set device state (the control plane turns toggles into an explicit state)
+    bool toggleDevice(int channel, bool newState);
+    
+    // Set a dimmer's level (0 = off), fading over fadeMs
+    bool setDeviceLevel(int channel, uint8_t level, uint16_t fadeMs = DIMMER_DEFAULT_FADE_MS);
     
     // Get device state
     bool getDeviceState(int channel);
     
+    // Write coalesced state changes to file (called by the control plane)
+    void handle();
+    
+    // Start the task that writes the devices file (called by the control plane)
+    bool startWriter();
+    
     // Create default devices if none exist
     void createDefaultDevicesIfNeeded();
     
-    // Check device inputs (buttons)
-    void checkInputs();
+    // Check device inputs (buttons), reporting the channel of each press
+    void checkInputs(const std::function<void(int channel)>& onPress);
+    
+    // Register a listener for device state changes (call before tasks start)
+    void onStateChange(DeviceStateListener listener);
 };
 
 #endif // DEVICE_MANAGER_H
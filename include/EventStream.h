@@ -0,0 +1,129 @@
+#ifndef EVENT_STREAM_H
+#define EVENT_STREAM_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <vector>
+#include <ESPAsyncWebServer.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "DeviceManager.h"
+
+// A state change kept for Last-Event-ID replay
+struct StateEvent {
+    uint32_t seq;
+    int channel;
+    bool state;
+};
+
+// Fills in the system status published as "status" events
+typedef std::function<void(JsonObject statusObj)> StatusProvider;
+
+// Per-client bookkeeping for the event stream
+struct EventClient {
+    AsyncEventSourceClient* client;
+    bool needsResync;       // Updates were dropped, send a snapshot next time
+    uint8_t stalledBeats;   // Heartbeats seen with data still queued
+};
+
+// Server-sent events for the web UI.
+// New clients get a snapshot sent to them only; state changes are coalesced
+// per flush window into one "states" event; clients that fall behind have
+// updates dropped and get a fresh snapshot once they catch up; clients that
+// stop draining their queue are closed on the heartbeat.
+// Every state change gets a sequence number used as the SSE event ID; a
+// reconnecting browser sends it back in Last-Event-ID and only the changes it
+// missed are replayed from a ring of recent events, or a snapshot if the gap
+// is larger than the ring.
+// System status is pushed as a "status" event only when something the UI
+// shows changes meaningfully (connection, IP, RSSI bucket, heap bucket).
+// Status is checked on Wi-Fi events, with a slow fallback check for RSSI and
+// heap drift, which raise no event; the task sleeps while nobody is connected.
+// Connections are admitted by a filter (the web server requires a session).
+class EventStream {
+private:
+    AsyncEventSource* events;
+    DeviceManager* deviceManager;
+    
+    // Recent state changes kept for replay
+    static const size_t RING_SIZE = 64;
+    
+    // Connected clients and recent state changes, guarded by mutex
+    SemaphoreHandle_t mutex;
+    std::vector<EventClient> clients;
+    StateEvent ring[RING_SIZE];
+    size_t ringCount;           // Valid entries in the ring
+    uint32_t currentSeq;        // Sequence number of the latest change
+    uint32_t flushedSeq;        // Latest change already sent to clients
+    
+    // Task that flushes updates and sends heartbeats
+    TaskHandle_t taskHandle;
+    
+    // System status
+    StatusProvider statusProvider;
+    String lastStatusKey;               // Bucketed fields of the last published status
+    std::atomic<bool> statusCheckRequested;
+    
+    // Settings
+    static const uint32_t FLUSH_WINDOW_MS = 50;
+    static const uint32_t HEARTBEAT_INTERVAL_MS = 15000;
+    static const size_t MAX_CLIENT_QUEUE = 8;       // Messages queued before updates are dropped
+    static const uint8_t MAX_STALLED_BEATS = 3;     // Heartbeats without progress before reaping
+    static const uint32_t STATUS_CHECK_INTERVAL_MS = 60000;    // Fallback for RSSI and heap drift
+    static const int RSSI_BUCKET_DB = 10;
+    static const uint32_t HEAP_BUCKET_BYTES = 16 * 1024;
+    
+    // Event stream task
+    static void eventStreamTask(void* parameter);
+    
+    // Send pending state changes to all clients
+    void flush();
+    
+    // Send heartbeats and close dead clients
+    void heartbeat();
+    
+    // Time the task may sleep before the next heartbeat or status check is due
+    TickType_t nextWakeTicks(unsigned long lastHeartbeat, unsigned long lastStatusCheck);
+    
+    // Publish the system status if it changed meaningfully
+    void checkStatus();
+    
+    // Build the system status message and its change key
+    String buildStatus(String& key);
+    
+    // Build the full device state message
+    String buildSnapshot();
+    
+    // Build one "states" message with the changes after a sequence number,
+    // returns false if they are no longer all in the ring
+    bool buildSince(uint32_t seq, String& message);
+    
+    // Send a message to a single client, tracking drops
+    bool sendTo(AsyncEventSourceClient* client, const char* message, const char* event, uint32_t id);
+    
+public:
+    EventStream(const char* url, DeviceManager* deviceManager);
+    
+    // Attach the event source to a server and start the task
+    void begin(AsyncWebServer* server);
+    
+    // Queue a device state change for the next flush
+    void publishState(int channel, bool state);
+    
+    // Only admit clients whose connect request passes the filter
+    void setFilter(ArRequestFilterFunction filter);
+    
+    // Set the system status source (enables "status" events)
+    void setStatusProvider(StatusProvider provider);
+    
+    // Check the system status on the next task iteration (e.g. after a WiFi event)
+    void requestStatusCheck();
+    
+    // Number of connected clients
+    size_t clientCount();
+};
+
+#endif // EVENT_STREAM_H
@@ -0,0 +1,93 @@
+#ifndef LOOP_MONITOR_H
+#define LOOP_MONITOR_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
+
+// Handlers run by loop()
+enum class LoopHandler {
+    NETWORK,        // Starting the network services
+    ALEXA,          // Alexa discovery and state sync
+    OTA,            // Firmware update reboot
+    COUNT
+};
+
+// Number of duration buckets (including +Inf), see LoopMonitor.cpp
+static const size_t LOOP_BUCKET_COUNT = 12;
+
+// Duration statistics of one handler
+struct LoopHandlerStats {
+    std::atomic<uint32_t> count;
+    std::atomic<uint32_t> sumMicros;    // Wraps, exported as a counter
+    std::atomic<uint32_t> maxMicros;
+    std::atomic<uint32_t> buckets[LOOP_BUCKET_COUNT];
+};
+
+// Main loop tracer and software watchdog.
+// loop() brackets each handler with enter()/leave(), which feeds a per-handler
+// duration histogram (exported with max and estimated percentiles on
+// /api/metrics). A one-shot timer armed for every iteration fires if the
+// iteration runs over its budget and logs the handler still running; the
+// iteration's final duration and slowest handler are logged when it ends.
+// Between iterations the loop sleeps until woken by wake() or the poll
+// period runs out (Espalexa's UDP discovery socket can only be polled).
+class LoopMonitor {
+public:
+    static const uint32_t ITERATION_BUDGET_MS = 50;
+    static const uint32_t POLL_PERIOD_MS = 100;
+
+private:
+    LoopHandlerStats handlers[static_cast<size_t>(LoopHandler::COUNT)];
+    TaskHandle_t loopTask;
+    TimerHandle_t watchdogTimer;
+    
+    // Current iteration (written by the loop task, read by the watchdog timer)
+    std::atomic<int> currentHandler;                // -1 between handlers
+    std::atomic<uint32_t> handlerStartMicros;
+    std::atomic<bool> overrunReported;
+    uint32_t iterationStartMicros;
+    int slowestHandler;
+    uint32_t slowestMicros;
+    
+    std::atomic<uint32_t> iterations;
+    std::atomic<uint32_t> overruns;
+    std::atomic<uint32_t> wakeups;                  // Iterations started by wake()
+    
+    // Watchdog timer callback
+    static void watchdogCallback(TimerHandle_t timer);
+    
+    // Estimate a percentile of a handler's durations in microseconds
+    static uint32_t percentile(const LoopHandlerStats& stats, uint32_t permille);
+
+public:
+    LoopMonitor();
+    
+    // Start monitoring (call from the loop task)
+    bool begin();
+    
+    // Sleep until woken or the poll period runs out, then start an iteration
+    void wait();
+    
+    // Wake the loop (safe from any task)
+    void wake();
+    
+    // Start timing a handler
+    void enter(LoopHandler handler);
+    
+    // Stop timing the current handler
+    void leave();
+    
+    // Finish the iteration and check it against the budget
+    void endIteration();
+    
+    // Render loop statistics in text exposition format
+    void render(Print& out);
+};
+
+// Global loop monitor instance
+extern LoopMonitor loopMonitor;
+
+#endif // LOOP_MONITOR_H
@@ -0,0 +1,109 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include <atomic>
+
+// Number of latency buckets (including +Inf) and tracked routes, see Metrics.cpp
+static const size_t METRICS_LATENCY_BUCKET_COUNT = 10;
+static const size_t METRICS_ROUTE_COUNT = 16;
+
+// Counters and histogram for a single route
+struct RouteMetrics {
+    std::atomic<uint32_t> count;
+    std::atomic<uint32_t> sumMicros;  // Wraps, exported as a counter
+    std::atomic<uint32_t> buckets[METRICS_LATENCY_BUCKET_COUNT];
+};
+
+// Counters for a persisted file
+struct WriteMetrics {
+    std::atomic<uint32_t> count;
+    std::atomic<uint32_t> failures;
+    std::atomic<uint32_t> sumMicros;
+    std::atomic<uint32_t> maxMicros;
+};
+
+// Firmware metrics, exported in Prometheus text exposition format.
+// All counters are lock-free atomics so they can be updated from any task.
+class Metrics {
+private:
+    RouteMetrics routes[METRICS_ROUTE_COUNT];
+    
+    // Request latency by WiFi power-save mode (0 = off, 1 = modem sleep)
+    RouteMetrics wifiModeLatency[2];
+    
+    // Find the route slot for a URL
+    size_t routeIndex(const String& url);
+    
+    // Add a duration to a histogram
+    static void recordLatency(RouteMetrics& histogram, uint32_t durationMicros);
+    
+    // Write one histogram's buckets, sum and count
+    static void renderHistogram(Print& out, const char* name, const char* label, const char* value, RouteMetrics& histogram);
+    
+    // Update an atomic maximum
+    static void updateMax(std::atomic<uint32_t>& target, uint32_t value);
+    
+    // Write one write-metrics block
+    void renderWrites(Print& out, const char* file, WriteMetrics& writes);
+
+public:
+    // Persistence
+    WriteMetrics deviceWrites;
+    WriteMetrics userWrites;
+    
+    // Server-sent events
+    std::atomic<uint32_t> sseClients;
+    std::atomic<uint32_t> sseEventsSent;
+    std::atomic<uint32_t> sseEventsDropped;
+    
+    // Admission control
+    std::atomic<uint32_t> requestsShed;
+    
+    // Alexa
+    std::atomic<uint32_t> alexaCommandsOn;
+    std::atomic<uint32_t> alexaCommandsOff;
+    std::atomic<uint32_t> alexaCommandsDropped;    // Command queue was full
+    
+    // Device control plane
+    std::atomic<uint32_t> controlCommands;
+    std::atomic<uint32_t> controlCommandsDropped;  // Command queue was full
+    std::atomic<uint32_t> controlLatencyMaxMicros; // Longest wait from post to applied
+    
+    // WiFi power save
+    std::atomic<bool> wifiPowerSave;               // Modem sleep currently enabled
+    std::atomic<uint32_t> wifiPowerSaveSwitches;
+    
+    // Firmware updates (bytes are for the current or last update)
+    std::atomic<bool> otaInProgress;
+    std::atomic<uint32_t> otaBytesTotal;           // Upload size (compressed if the image is)
+    std::atomic<uint32_t> otaBytesReceived;
+    std::atomic<uint32_t> otaBytesWritten;         // Image bytes written to flash
+    std::atomic<uint32_t> otaThroughputBps;        // Upload rate in bytes per second
+    std::atomic<uint32_t> otaUpdatesSucceeded;
+    std::atomic<uint32_t> otaUpdatesFailed;
+    std::atomic<uint32_t> otaFsFilesWritten;       // Web assets replaced by delta updates
+    std::atomic<uint32_t> otaFsBytesWritten;
+    
+    Metrics();
+    
+    // Record a completed HTTP request (powerSave: modem sleep was on when it arrived)
+    void recordRequest(const String& url, uint32_t durationMicros, bool powerSave);
+    
+    // Average request latency in microseconds with power save on or off, 0 if none seen
+    uint32_t getAverageLatency(bool powerSave);
+    
+    // Record a command applied by the control plane
+    void recordControlCommand(uint32_t latencyMicros);
+    
+    // Record a file write
+    void recordWrite(WriteMetrics& writes, uint32_t durationMicros, bool success);
+    
+    // Render all metrics in text exposition format
+    void render(Print& out);
+};
+
+// Global metrics instance
+extern Metrics metrics;
+
+#endif // METRICS_H
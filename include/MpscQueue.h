@@ -0,0 +1,75 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Bounded lock-free queue for many producers and a single consumer.
+// Each cell carries a sequence number: producers claim a position with a
+// compare-and-swap on the enqueue index and publish the cell by bumping its
+// sequence, so push() never blocks and never takes a lock (safe from any
+// task; not from ISRs, which may spin against a preempted producer).
+// Only one task may call pop().
+template <typename T, size_t Capacity>
+class MpscQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+    
+    Cell cells[Capacity];
+    std::atomic<size_t> enqueuePos;
+    size_t dequeuePos;      // Only touched by the consumer
+
+public:
+    MpscQueue() : enqueuePos(0), dequeuePos(0) {
+        for (size_t i = 0; i < Capacity; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+    
+    // Add an item, returns false if the queue is full
+    bool push(const T& item) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells[pos & (Capacity - 1)];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+            
+            if (diff == 0) {
+                // Cell is free at this position, try to claim it
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.data = item;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                // The consumer hasn't freed this cell yet
+                return false;
+            } else {
+                // Another producer claimed it first
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+    
+    // Take the oldest item, returns false if the queue is empty (consumer only)
+    bool pop(T& item) {
+        Cell& cell = cells[dequeuePos & (Capacity - 1)];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        if ((intptr_t)sequence - (intptr_t)(dequeuePos + 1) < 0) {
+            return false;
+        }
+        
+        item = cell.data;
+        cell.sequence.store(dequeuePos + Capacity, std::memory_order_release);
+        dequeuePos++;
+        return true;
+    }
+};
+
+#endif // MPSC_QUEUE_H
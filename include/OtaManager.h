@@ -2,17 +2,132 @@
 #define OTA_MANAGER_H
 
 #include <Arduino.h>
-#include <ElegantOTA.h>
+#include <vector>
 #include <ESPAsyncWebServer.h>
+#include <AsyncJson.h>
+#include <ArduinoJson.h>
+#include <LittleFS.h>
 #include <Update.h>
+#include <mbedtls/sha256.h>
+#include "esp32/rom/miniz.h"
+#include "UserManager.h"
+#include "SessionManager.h"
+#include "AdmissionControl.h"
 
+// An update being received
+struct OtaSession {
+    AsyncWebServerRequest* request;     // Request that streamed the latest image (compared only)
+    bool active;                        // Update running, buffers held
+    bool compressed;                    // Gzip image, inflated while streaming
+    bool inflateDone;                   // Deflate stream complete (trailer is ignored)
+    const char* error;                  // First error, null while all is well
+    uint8_t expectedDigest[32];
+    mbedtls_sha256_context sha;
+    tinfl_decompressor* inflator;       // Only allocated for compressed images
+    uint8_t* window;                    // Inflate output / dictionary (TINFL_LZ_DICT_SIZE)
+    size_t windowPos;
+    uint32_t startMillis;
+};
+
+// A web asset file being received
+struct FsUploadSession {
+    AsyncWebServerRequest* request;     // Request that streamed the latest file (compared only)
+    bool active;                        // Upload running, temporary file open
+    const char* error;                  // First error, null while all is well
+    String path;
+    File file;                          // Written as <path>.tmp, renamed once verified
+    uint8_t expectedDigest[32];
+    mbedtls_sha256_context sha;
+};
+
+// Firmware updates over HTTP.
+// POST /ota/firmware streams a raw or gzip compressed image straight into
+// the update partition: compressed images are inflated chunk by chunk with
+// the ROM inflater, and a SHA-256 of the image (hardware accelerated through
+// mbedTLS) is checked against the X-Firmware-SHA256 header before the new
+// partition is activated. A truncated or corrupted upload is rejected here
+// instead of being left to the bootloader.
+// Requires an admin session; progress and throughput are in the metrics.
+//
+// The web UI in LittleFS is updated file by file: POST /ota/fs/manifest
+// lists every asset with its SHA-256 and gets back the ones that differ,
+// which are then sent to POST /ota/fs/file. Only web asset paths (/css,
+// /js, /img and the gzipped pages) are accepted, so user, device and Alexa
+// configuration are never touched.
 class OtaManager {
 private:
     AsyncWebServer* server;
+    UserManager* userManager;
+    SessionManager* sessionManager;
+    AdmissionControl* admissionControl;
     bool otaEnabled;
     
+    OtaSession session;
+    FsUploadSession fsUpload;
+    
+    // Restart time after a successful update, 0 if none is due
+    uint32_t rebootAtMillis;
+    
+    // Start an update from the first chunk, returns false (with session.error set) if it can't;
+    // headerLength is set to the bytes preceding the image (gzip header)
+    bool startUpdate(AsyncWebServerRequest* request, const uint8_t* data, size_t len, size_t total, size_t& headerLength);
+    
+    // Feed a chunk of the upload
+    void receiveChunk(uint8_t* data, size_t len);
+    
+    // Write image bytes to the update partition and the digest
+    void writeImage(const uint8_t* data, size_t len);
+    
+    // Check the digest and activate the new partition
+    void finishUpdate();
+    
+    // Abort the update and release its buffers
+    void abortUpdate(const char* error);
+    
+    // Release the session buffers
+    void releaseSession();
+    
+    // Run a handler once the request's connection is released
+    void onRelease(AsyncWebServerRequest* request, ArDisconnectHandler handler);
+    
+    // Compare a web asset manifest with the file system, optionally removing stale assets
+    void handleManifest(AsyncWebServerRequest* request, JsonVariant& json);
+    
+    // Start receiving a web asset, returns false (with fsUpload.error set) if it can't
+    bool startFileUpload(AsyncWebServerRequest* request);
+    
+    // Check the digest and move the file into place
+    void finishFileUpload();
+    
+    // Abort the file upload and remove the partial file
+    void abortFileUpload(const char* error);
+    
+    // Remove assets in a directory that are not in the manifest
+    void pruneAssets(const char* dir, JsonArray files, JsonArray removed);
+    
+    // Whether a path is a web asset that may be replaced
+    static bool isAssetPath(const String& path);
+    
+    // Whether the request body is sent as application/octet-stream
+    static bool isBinaryBody(AsyncWebServerRequest* request);
+    
+    // Send a JSON error response
+    static void sendError(AsyncWebServerRequest* request, int code, const char* message);
+    
+    // Skip the gzip header, returns its length or 0 if it is invalid
+    static size_t gzipHeaderLength(const uint8_t* data, size_t len);
+    
+    // Parse a hex SHA-256 digest
+    static bool parseDigest(const String& hex, uint8_t* digest);
+
 public:
-    OtaManager(AsyncWebServer* server);
+    OtaManager(AsyncWebServer* server, UserManager* userManager, SessionManager* sessionManager);
+    
+    // SHA-256 of a file, returns false if it can't be read
+    static bool hashFile(const String& path, uint8_t* digest);
+    
+    // Share request cleanup with the admission layer (set before begin())
+    void setAdmissionControl(AdmissionControl* admissionControl);
     
     // Initialize OTA manager
     void begin();
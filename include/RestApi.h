@@ -8,6 +8,10 @@
 #include "UserManager.h"
 #include "DeviceManager.h"
 #include "SessionManager.h"
+#include "WiFiManager.h"
+#include "ControlPlane.h"
+
+class AlexaManager;
 
 class RestApi {
 private:
@@ -15,6 +19,9 @@ private:
     UserManager* userManager;
     DeviceManager* deviceManager;
     SessionManager* sessionManager;
+    AlexaManager* alexaManager = nullptr;
+    WiFiManager* wifiManager = nullptr;
+    ControlPlane* controlPlane = nullptr;
     
     // Setup API routes
     void setupRoutes();
@@ -24,17 +31,55 @@ private:
     void handleLogout(AsyncWebServerRequest *request);
     void handleGetDevices(AsyncWebServerRequest *request);
     void handleToggleDevice(AsyncWebServerRequest *request, JsonVariant &json);
+    void handleSetLevel(AsyncWebServerRequest *request, JsonVariant &json);
+    void handleAddDevice(AsyncWebServerRequest *request, JsonVariant &json);
+    void handleUpdateDevice(AsyncWebServerRequest *request, JsonVariant &json);
+    void handleDeleteDevice(AsyncWebServerRequest *request, JsonVariant &json);
     void handleGetUsers(AsyncWebServerRequest *request);
     void handleAddUser(AsyncWebServerRequest *request, JsonVariant &json);
     void handleUpdateUser(AsyncWebServerRequest *request, JsonVariant &json);
     void handleDeleteUser(AsyncWebServerRequest *request, JsonVariant &json);
     void handleGetStatus(AsyncWebServerRequest *request);
+    void handleGetMetrics(AsyncWebServerRequest *request);
+    void handleGetTasks(AsyncWebServerRequest *request);
+    void handleBootstrap(AsyncWebServerRequest *request);
+    void handleSetWiFiPower(AsyncWebServerRequest *request, JsonVariant &json);
+    
+    // Add the devices visible to a user, with their permissions
+    void addDevices(JsonArray devicesArray, const String& username);
+    
+    // Check if the client asked for a MessagePack response (Accept: application/msgpack)
+    bool wantsMsgPack(AsyncWebServerRequest *request);
+    
+    // Send a document as JSON or MessagePack depending on the Accept header
+    void sendDocument(AsyncWebServerRequest *request, int code, const JsonDocument& doc);
+    
+    // Send a {success, message} reply as JSON or MessagePack
+    void sendMessage(AsyncWebServerRequest *request, int code, bool success, const char* message);
+    
+    // Decode a MessagePack request body and pass it to a JSON handler
+    void handleMsgPackBody(AsyncWebServerRequest *request, void (RestApi::*handler)(AsyncWebServerRequest*, JsonVariant&));
     
+    // Fill a device from a JSON body, keeping fields that are not present
+    void parseDevice(JsonObject jsonObj, Device& device);
+
 public:
     RestApi(AsyncWebServer* server, UserManager* userManager, DeviceManager* deviceManager, SessionManager* sessionManager);
     
     // Initialize the REST API
     void begin();
+    
+    // Set the Alexa manager notified of device configuration changes
+    void setAlexaManager(AlexaManager* alexaManager);
+    
+    // Set the WiFi manager reporting connection statistics
+    void setWiFiManager(WiFiManager* wifiManager);
+    
+    // Set the control plane that applies device changes
+    void setControlPlane(ControlPlane* controlPlane);
+    
+    // Add system status fields (shared with the "status" event)
+    void addStatus(JsonObject statusObj);
 };
 
 #endif // REST_API_H
@@ -27,6 +27,12 @@ public:
     // Get username from session
     String getUsernameFromSession(const String& sessionId);
     
+    // Get session ID from the request cookie (empty if none)
+    String getSessionId(AsyncWebServerRequest *request);
+    
+    // Validate the request's session and return its username (empty if not authenticated)
+    String getSessionUsername(AsyncWebServerRequest *request);
+    
     // Delete a session
     bool deleteSession(const String& sessionId);
     
@@ -0,0 +1,120 @@
+#ifndef TASK_PROFILER_H
+#define TASK_PROFILER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+// Number of tasks tracked and samples kept per task
+#define TASK_PROFILER_MAX_TASKS 24
+#define TASK_PROFILER_WINDOW 10
+
+// Cores whose load is measured when per-task run time is not available
+#if !configGENERATE_RUN_TIME_STATS
+#define TASK_PROFILER_CORES portNUM_PROCESSORS
+#endif
+
+// Rolling statistics of one task
+struct TaskProfile {
+    TaskHandle_t handle;                            // Null when the slot is free
+    char name[configMAX_TASK_NAME_LEN];
+    UBaseType_t priority;
+    uint32_t stackFree;                             // Stack high-water mark in bytes
+    uint32_t lastRunTime;                           // Run-time counter at the last sample
+    uint16_t cpu[TASK_PROFILER_WINDOW];             // Share of one core per sample, in 0.1 %
+    uint8_t next;                                   // Next sample slot
+    uint8_t samples;                                // Valid samples (up to the window)
+    bool seen;                                      // Present in the latest sample
+};
+
+// Stack high-water mark of one task
+struct TaskStackFree {
+    char name[configMAX_TASK_NAME_LEN];
+    uint32_t stackFree;                             // In bytes
+};
+
+// FreeRTOS runtime profiler.
+// A low-priority task samples the run-time counter and stack high-water mark
+// of every task once per period and keeps a rolling window of CPU shares
+// (percent of one core, so a busy pinned task reads 100). Reported by
+// GET /api/tasks and by typing "tasks" on the serial console.
+// CPU shares need configGENERATE_RUN_TIME_STATS, which the stock
+// Arduino-ESP32 build leaves off. Without it, the load of each core is
+// measured instead: idle hooks count the iterations of the idle loop, which
+// then keeps spinning rather than waiting for the next interrupt, and the
+// count is compared with the rate of an idle core. That rate is calibrated
+// in begin(), before Wi-Fi starts, and raised whenever a sample idles faster.
+class TaskProfiler {
+public:
+    static const uint32_t SAMPLE_PERIOD_MS = 1000;
+    static const uint32_t CALIBRATION_MS = 100;
+
+private:
+    TaskProfile profiles[TASK_PROFILER_MAX_TASKS];
+    SemaphoreHandle_t mutex;
+    TaskHandle_t taskHandle;
+    uint32_t lastTotalRunTime;
+    String serialLine;
+
+#if !configGENERATE_RUN_TIME_STATS
+    // Per-core load per sample, in 0.1 %
+    uint16_t coreLoad[TASK_PROFILER_CORES][TASK_PROFILER_WINDOW];
+    uint32_t lastIdleCount[TASK_PROFILER_CORES];
+    uint32_t idleRate[TASK_PROFILER_CORES];         // Idle loop iterations per 1000 ticks of an idle core
+    TickType_t lastCoreSampleTick;
+    uint8_t coreNext;
+    uint8_t coreSamples;
+    
+    // Measure the idle loop rate of each core while nothing else runs
+    void calibrateCores();
+    
+    // Take one sample of the core loads
+    void sampleCores();
+#endif
+
+    // Profiler task
+    static void task(void* parameter);
+    
+    // Take one sample of all tasks
+    void sample();
+    
+    // Read serial console commands
+    void readSerial();
+    
+    // Find the profile of a task, claiming a free one if it is new
+    TaskProfile* findProfile(TaskHandle_t handle, bool& created);
+    
+    // Average and maximum of a window of shares, in 0.1 %
+    static void summarize(const uint16_t* values, uint8_t samples, uint16_t& average, uint16_t& maximum);
+
+public:
+    TaskProfiler();
+    
+    // Start sampling (waits CALIBRATION_MS to calibrate the core loads)
+    bool begin();
+    
+    // Whether CPU shares are available in this build
+    static bool hasCpuStats();
+    
+    // Whether per-core load is measured in this build (when CPU shares are not)
+    static bool hasCoreStats();
+    
+    // Add one entry per task to a JSON array
+    void addTasks(JsonArray tasks);
+    
+    // Add one entry per core to a JSON array (nothing without core stats)
+    void addCores(JsonArray cores);
+    
+    // Copy the stack high-water marks of all tasks, returns how many were copied
+    size_t getStacks(TaskStackFree* out, size_t max);
+    
+    // Print a table of all tasks
+    void printReport(Print& out);
+};
+
+// Global profiler instance
+extern TaskProfiler taskProfiler;
+
+#endif // TASK_PROFILER_H
@@ -0,0 +1,18 @@
+#ifndef WEB_ASSETS_H
+#define WEB_ASSETS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Web UI asset compiled into flash (see scripts/pre_build.py, custom_web_assets = flash)
+struct WebAsset {
+    const char* path;           // URL path, e.g. "/css/style.1a2b3c4d.css"
+    const char* contentType;
+    const uint8_t* data;        // Stored bytes (gzipped when compressed is set)
+    size_t length;
+    const char* etag;           // Quoted content hash
+    bool compressed;            // Send with Content-Encoding: gzip
+    bool immutable;             // Name carries a content hash, cache forever
+};
+
+#endif // WEB_ASSETS_H
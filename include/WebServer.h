@@ -3,12 +3,24 @@
 
 #include <Arduino.h>
 #include <ESPAsyncWebServer.h>
-#include <ElegantOTA.h>
+#include <vector>
 #include "WiFiManager.h"
 #include "UserManager.h"
 #include "DeviceManager.h"
 #include "SessionManager.h"
 #include "RestApi.h"
+#include "AdmissionControl.h"
+#include "EventStream.h"
+
+class AlexaManager;
+
+// ETag of a page on LittleFS, recomputed when the file's size or write time changes
+struct PageEtag {
+    String path;
+    size_t size;
+    time_t lastWrite;
+    String etag;
+};
 
 class WebServer {
 private:
@@ -18,7 +30,11 @@ private:
     DeviceManager* deviceManager;
     SessionManager* sessionManager;
     RestApi* restApi;
-    AsyncEventSource* events;
+    EventStream* eventStream;
+    AdmissionControl* admissionControl;
+    
+    // Content hashes of the pages served from LittleFS
+    std::vector<PageEtag> pageEtags;
     
     // Setup web routes
     void setupRoutes();
@@ -26,6 +42,17 @@ private:
     // Serve static files from LittleFS
     void serveStatic();
     
+    // Send an HTML page (stored gzipped, always revalidated against its ETag)
+    void sendPage(AsyncWebServerRequest *request, const char* path);
+    
+    // Quoted content hash of a stored page, empty if it can't be read
+    String getPageEtag(const String& storedPath);
+
+#ifdef WEB_ASSETS_IN_FLASH
+    // Send an asset compiled into flash, returns false if there is none for the path
+    bool sendAsset(AsyncWebServerRequest *request, const String& path);
+#endif
+
 public:
     WebServer(WiFiManager* wifiManager, UserManager* userManager, DeviceManager* deviceManager);
     
@@ -34,6 +61,21 @@ public:
     
     // Send device state update event
     void sendDeviceStateEvent(int channel, bool state);
+    
+    // Get the underlying server instance
+    AsyncWebServer* getServer();
+    
+    // Get the session manager
+    SessionManager* getSessionManager();
+    
+    // Get the admission control layer
+    AdmissionControl* getAdmissionControl();
+    
+    // Set the Alexa manager notified of device configuration changes
+    void setAlexaManager(AlexaManager* alexaManager);
+    
+    // Set the control plane that applies device changes
+    void setControlPlane(ControlPlane* controlPlane);
 };
 
 #endif // WEB_SERVER_H
@@ -2,13 +2,52 @@
 #define WIFI_MANAGER_H
 
 #include <Arduino.h>
+#include <atomic>
 #include <WiFi.h>
 #include <ESPmDNS.h>
+#include <Preferences.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
 #include "credentials.h"
 
+// Last good connection, kept in NVS so it survives power loss
+struct WiFiConnectionCache {
+    bool valid;
+    uint8_t bssid[6];
+    uint8_t channel;
+};
+
+// Station connection state, driven by WiFi events
+enum class WiFiState {
+    IDLE,
+    CONNECTING,
+    CONNECTED,
+    BACKOFF         // Waiting before the next reconnect attempt
+};
+
+// When the radio may use modem sleep
+enum class WiFiPowerPolicy {
+    AUTO,           // Radio always on while requests or event streams are active, modem sleep when idle
+    PERFORMANCE,    // Radio always on (WIFI_PS_NONE)
+    POWER_SAVE      // Modem sleep always
+};
+
+// Distinct disconnect reasons kept (enough for getDisconnectReasons)
+static const size_t WIFI_MAX_DISCONNECT_REASONS = 12;
+
+// How often a disconnect reason was seen since boot
+struct WiFiDisconnectCount {
+    uint8_t reason;         // wifi_err_reason_t
+    uint32_t count;
+};
+
+// Connection supervisor: one task reacts to disconnect events and reconnects
+// with jittered exponential backoff; nothing else reconnects and nothing
+// polls the connection.
+// The same task applies the power-save policy: web activity switches modem
+// sleep off at once, and it is switched back on after an idle period.
+// Request latency in each mode is recorded in the metrics.
 class WiFiManager {
 private:
     // FreeRTOS event group to signal WiFi events
@@ -17,6 +56,7 @@ private:
     // Event bits for WiFi events
     static const int WIFI_CONNECTED_BIT = BIT0;
     static const int WIFI_FAIL_BIT = BIT1;
+    static const int WIFI_ACTIVITY_BIT = BIT2;     // Power-save state needs a look
     
     // WiFi credentials
     const char* ssid;
@@ -43,24 +83,97 @@ private:
     // Task handle for WiFi monitoring task
     TaskHandle_t wifiMonitorTaskHandle;
     
-    // WiFi monitoring task
+    // WiFi supervisor task (initial connect, then reconnects on disconnect)
     static void wifiMonitorTask(void* parameter);
     
+    // Reconnect settings
+    static const uint32_t BACKOFF_BASE_MS = 1000;
+    static const uint32_t BACKOFF_MAX_MS = 60000;
+    static const uint32_t CONNECT_TIMEOUT_MS = 10000;
+    
+    // Supervisor state and counters
+    std::atomic<WiFiState> state;
+    std::atomic<uint32_t> disconnectCount;
+    std::atomic<uint32_t> reconnectAttempts;
+    
+    // Disconnect reasons seen since boot, guarded by reasonLock
+    portMUX_TYPE reasonLock = portMUX_INITIALIZER_UNLOCKED;
+    WiFiDisconnectCount disconnectReasons[WIFI_MAX_DISCONNECT_REASONS];
+    size_t disconnectReasonCount;
+    
+    // Count a disconnect and its reason (called from the WiFi event handler)
+    void recordDisconnect(uint8_t reason);
+    
+    // Backoff before a reconnect attempt: exponential, capped, with jitter
+    static uint32_t backoffDelay(uint32_t attempt);
+    
+    // Reconnect until connected, backing off between attempts
+    void reconnectWithBackoff();
+    
+    // Power-save policy
+    static const uint32_t POWER_SAVE_IDLE_MS = 60000;      // Quiet time before modem sleep (auto)
+    static const uint32_t POWER_SAVE_CHECK_MS = 10000;
+    std::atomic<WiFiPowerPolicy> powerPolicy;
+    std::atomic<bool> powerSaveActive;
+    std::atomic<uint32_t> lastActivityMillis;
+    
+    // Switch modem sleep on or off
+    void applyPowerSave(bool enable);
+    
+    // Apply the policy to the current activity (force: set the mode even if it looks unchanged)
+    void updatePowerSave(bool force = false);
+    
+    // How long the supervisor may sleep before the next power-save check
+    TickType_t powerCheckTicks();
+    
     // Flag to indicate if static IP is configured
     bool useStaticIp;
     
     // Flag to indicate if Soft AP is enabled
     bool softApEnabled;
     
-    // Flag to indicate if WiFi is connected
-    bool isConnected;
+    // Flag to indicate if WiFi is connected (set from WiFi events)
+    std::atomic<bool> isConnected;
+    
+    // Flag to indicate if the static IP was applied in begin()
+    bool staticIpActive;
     
+    // Cached connection used for a directed connect on boot
+    WiFiConnectionCache cache;
+    static const uint32_t FAST_CONNECT_TIMEOUT_MS = 5000;     // Association and DHCP
+    static const uint32_t PINNED_RECONNECT_ATTEMPTS = 3;      // Reconnects to the cached BSSID before scanning again
+    
+    // The station config still names the cached BSSID and channel
+    bool bssidPinned;
+    
+    // How the boot connection went
+    bool fastConnectUsed;
+    unsigned long connectedAtMillis;
+    
+    // Load the cached connection from NVS
+    bool loadConnectionCache();
+    
+    // Save the current connection to NVS if it changed
+    void saveConnectionCache();
+    
+    // Forget the cached connection
+    void clearConnectionCache();
+    
+    // Connect directly to the cached BSSID and channel
+    bool connectFast();
+    
+    // Connect to the access point, waiting until connected or failed
+    void connect();
+
 public:
     WiFiManager();
     
-    // Initialize WiFi
+    // Initialize WiFi and start connecting in the background (returns immediately)
     void begin(const char* ssid, const char* password, const char* hostname = "esp32");
     
+    // Start the mDNS responder (once connected)
+    void startMdns();
+    
     // Configure static IP
     void configureStaticIp(IPAddress localIp, IPAddress gateway, IPAddress subnet, 
                           IPAddress primaryDns = IPAddress(8, 8, 8, 8), 
@@ -93,6 +206,36 @@ public:
     
     // Get hostname
     String getHostname();
+    
+    // Milliseconds from boot until the first connection, 0 if not connected yet
+    unsigned long getConnectTime();
+    
+    // Whether the boot connection used the cached BSSID and channel
+    bool usedFastConnect();
+    
+    // Get the supervisor state
+    WiFiState getState();
+    
+    // Get the number of disconnects since boot
+    uint32_t getDisconnectCount();
+    
+    // Get the number of reconnect attempts since boot
+    uint32_t getReconnectAttempts();
+    
+    // Copy the disconnect reason counters, returns how many were copied
+    size_t getDisconnectReasons(WiFiDisconnectCount* out, size_t max);
+    
+    // Note web activity (keeps the radio awake under the auto policy)
+    void noteActivity();
+    
+    // Set and persist the power-save policy
+    void setPowerPolicy(WiFiPowerPolicy policy);
+    
+    // Get the power-save policy
+    WiFiPowerPolicy getPowerPolicy();
+    
+    // Whether modem sleep is currently enabled
+    bool isPowerSaveActive();
 };
 
 #endif // WIFI_MANAGER_H
@@ -0,0 +1,202 @@
+#include "Arduino.h"
+#include "NativeArduino.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+
+// Offset added by advanceMillis()
+static std::atomic<unsigned long long> clockOffsetMicros(0);
+
+// Simulated GPIO state
+static std::atomic<uint8_t> pinModes[NATIVE_GPIO_COUNT];
+static std::atomic<uint8_t> pinLevels[NATIVE_GPIO_COUNT];
+
+// Serial input queued by feedSerial()
+static std::mutex serialLock;
+static std::deque<char> serialInput;
+
+static std::mt19937 randomEngine(0);
+static std::mutex randomLock;
+
+HardwareSerial Serial;
+EspClass ESP;
+
+// Microseconds since start, including the simulated offset (the clock
+// starts on first use, so it is valid during static initialization)
+static unsigned long long elapsedMicros() {
+    static const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::steady_clock::now() - startTime;
+    return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() + clockOffsetMicros.load();
+}
+
+unsigned long millis() {
+    return elapsedMicros() / 1000;
+}
+
+unsigned long micros() {
+    return elapsedMicros();
+}
+
+void delay(uint32_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(uint32_t us) {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void yield() {
+    std::this_thread::yield();
+}
+
+// Configure a pin; pull-ups read high until driven
+void pinMode(uint8_t pin, uint8_t mode) {
+    if (pin >= NATIVE_GPIO_COUNT) {
+        return;
+    }
+    
+    pinModes[pin] = mode;
+    if (mode == INPUT_PULLUP) {
+        pinLevels[pin] = HIGH;
+    } else if (mode == INPUT_PULLDOWN) {
+        pinLevels[pin] = LOW;
+    }
+}
+
+void digitalWrite(uint8_t pin, uint8_t level) {
+    if (pin < NATIVE_GPIO_COUNT) {
+        pinLevels[pin] = level ? HIGH : LOW;
+    }
+}
+
+int digitalRead(uint8_t pin) {
+    return pin < NATIVE_GPIO_COUNT ? pinLevels[pin].load() : LOW;
+}
+
+#ifdef NATIVE_NEEDS_STRLCPY
+size_t strlcpy(char* dst, const char* src, size_t size) {
+    size_t length = strlen(src);
+    if (size > 0) {
+        size_t copied = length < size - 1 ? length : size - 1;
+        memcpy(dst, src, copied);
+        dst[copied] = '\0';
+    }
+    return length;
+}
+#endif
+
+long random(long max) {
+    return random(0, max);
+}
+
+long random(long min, long max) {
+    if (min >= max) {
+        return min;
+    }
+    
+    std::lock_guard<std::mutex> guard(randomLock);
+    return std::uniform_int_distribution<long>(min, max - 1)(randomEngine);
+}
+
+void randomSeed(unsigned long seed) {
+    std::lock_guard<std::mutex> guard(randomLock);
+    randomEngine.seed(seed);
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+    return fwrite(buffer, 1, size, stdout);
+}
+
+int HardwareSerial::available() {
+    std::lock_guard<std::mutex> guard(serialLock);
+    return serialInput.size();
+}
+
+int HardwareSerial::read() {
+    std::lock_guard<std::mutex> guard(serialLock);
+    if (serialInput.empty()) {
+        return -1;
+    }
+    
+    char c = serialInput.front();
+    serialInput.pop_front();
+    return (uint8_t)c;
+}
+
+int HardwareSerial::peek() {
+    std::lock_guard<std::mutex> guard(serialLock);
+    return serialInput.empty() ? -1 : (uint8_t)serialInput.front();
+}
+
+void HardwareSerial::flush() {
+    fflush(stdout);
+}
+
+// Heap figures of a 4 MB ESP32 with nothing allocated (the host heap is not tracked)
+uint32_t EspClass::getHeapSize() {
+    return 327680;
+}
+
+uint32_t EspClass::getFreeHeap() {
+    return 327680;
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+    return 327680;
+}
+
+uint32_t EspClass::getMaxAllocHeap() {
+    return 114688;
+}
+
+const char* EspClass::getChipModel() {
+    return "native";
+}
+
+uint64_t EspClass::getEfuseMac() {
+    return 0x0000AABBCCDDEEFFULL;
+}
+
+// There is nothing to restart into, so the process ends
+void EspClass::restart() {
+    fflush(stdout);
+    _exit(0);
+}
+
+namespace NativeArduino {
+
+void advanceMillis(unsigned long ms) {
+    clockOffsetMicros += (unsigned long long)ms * 1000;
+}
+
+void setPinLevel(uint8_t pin, int level) {
+    if (pin < NATIVE_GPIO_COUNT) {
+        pinLevels[pin] = level ? HIGH : LOW;
+    }
+}
+
+int getPinLevel(uint8_t pin) {
+    return pin < NATIVE_GPIO_COUNT ? pinLevels[pin].load() : LOW;
+}
+
+uint8_t getPinMode(uint8_t pin) {
+    return pin < NATIVE_GPIO_COUNT ? pinModes[pin].load() : 0;
+}
+
+void feedSerial(const char* text) {
+    std::lock_guard<std::mutex> guard(serialLock);
+    while (*text != '\0') {
+        serialInput.push_back(*text++);
+    }
+}
+
+}
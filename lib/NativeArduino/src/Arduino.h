@@ -0,0 +1,109 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+// Host stand-in for the ESP32 Arduino core: time, GPIO, Serial and ESP,
+// enough for the firmware's managers to build and run on Linux.
+// Test hooks (clock, pin levels, serial input) are in NativeArduino.h.
+
+#include <ctype.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include "WString.h"
+#include "Print.h"
+#include "Stream.h"
+
+#define IRAM_ATTR
+#define F(text) (text)
+
+#ifndef BIT
+#define BIT(n) (1UL << (n))
+#endif
+#define BIT0 BIT(0)
+#define BIT1 BIT(1)
+#define BIT2 BIT(2)
+#define BIT3 BIT(3)
+#define BIT4 BIT(4)
+#define BIT5 BIT(5)
+#define BIT6 BIT(6)
+#define BIT7 BIT(7)
+
+// Pin levels and modes (ESP32 values)
+#define LOW 0x0
+#define HIGH 0x1
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define PULLUP 0x04
+#define INPUT_PULLUP 0x05
+#define PULLDOWN 0x08
+#define INPUT_PULLDOWN 0x09
+#define OUTPUT_OPEN_DRAIN 0x13
+
+// Number of GPIOs simulated
+#define NATIVE_GPIO_COUNT 40
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+using std::max;
+using std::min;
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+// Time since start (milliseconds and microseconds), shifted by NativeArduino::advanceMillis()
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+// GPIO (pins keep the level last written, or set by NativeArduino::setPinLevel())
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);
+int digitalRead(uint8_t pin);
+
+// BSD string copy from newlib, missing from glibc before 2.38
+#if defined(__GLIBC__) && (__GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38))
+#define NATIVE_NEEDS_STRLCPY
+size_t strlcpy(char* dst, const char* src, size_t size);
+#endif
+
+// Random numbers
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+// Serial port on stdout; input is fed by NativeArduino::feedSerial()
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long baud) {}
+    void end() {}
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+    int available() override;
+    int read() override;
+    int peek() override;
+    void flush() override;
+    operator bool() const { return true; }
+};
+
+// Chip information
+class EspClass {
+public:
+    uint32_t getHeapSize();
+    uint32_t getFreeHeap();
+    uint32_t getMinFreeHeap();
+    uint32_t getMaxAllocHeap();
+    const char* getChipModel();
+    uint64_t getEfuseMac();
+    void restart();
+};
+
+extern HardwareSerial Serial;
+extern EspClass ESP;
+
+#endif // ARDUINO_H
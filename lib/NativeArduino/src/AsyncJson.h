@@ -0,0 +1,80 @@
+#ifndef ASYNC_JSON_H
+#define ASYNC_JSON_H
+
+// Host stand-in for ESPAsyncWebServer's JSON request handler (ArduinoJson 6)
+
+#include <ArduinoJson.h>
+#include "ESPAsyncWebServer.h"
+
+#ifndef DYNAMIC_JSON_DOCUMENT_SIZE
+#define DYNAMIC_JSON_DOCUMENT_SIZE 1024
+#endif
+
+typedef std::function<void(AsyncWebServerRequest* request, JsonVariant& json)> ArJsonRequestHandlerFunction;
+
+// Collects a JSON body, parses it and passes it to the callback; answers
+// 400 for a body that doesn't parse and 413 for one that is too long
+class AsyncCallbackJsonWebHandler : public AsyncWebHandler {
+public:
+    AsyncCallbackJsonWebHandler(const String& uri, ArJsonRequestHandlerFunction onRequest = nullptr, size_t maxJsonBufferSize = DYNAMIC_JSON_DOCUMENT_SIZE)
+        : _uri(uri), _onRequest(onRequest), _maxJsonBufferSize(maxJsonBufferSize) {}
+    
+    void setMethod(WebRequestMethodComposite method) { _method = method; }
+    void setMaxContentLength(int maxContentLength) { _maxContentLength = maxContentLength; }
+    void onRequest(ArJsonRequestHandlerFunction fn) { _onRequest = fn; }
+    
+    bool canHandle(AsyncWebServerRequest* request) override {
+        if (!_onRequest || !(_method & request->method())) {
+            return false;
+        }
+        if (!AsyncCallbackWebHandler::uriMatches(_uri, request->url())) {
+            return false;
+        }
+        return request->method() == HTTP_GET || request->contentType().equalsIgnoreCase("application/json");
+    }
+    
+    void handleRequest(AsyncWebServerRequest* request) override {
+        if (!_onRequest) {
+            request->send(500);
+            return;
+        }
+        if (request->method() == HTTP_GET) {
+            JsonVariant json;
+            _onRequest(request, json);
+            return;
+        }
+        if (request->_tempObject != nullptr) {
+            DynamicJsonDocument doc(_maxJsonBufferSize);
+            DeserializationError error = deserializeJson(doc, static_cast<const char*>(request->_tempObject));
+            if (!error) {
+                JsonVariant json = doc.as<JsonVariant>();
+                _onRequest(request, json);
+                return;
+            }
+        }
+        request->send(_contentLength > _maxContentLength ? 413 : 400);
+    }
+    
+    void handleBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) override {
+        if (!_onRequest) {
+            return;
+        }
+        _contentLength = total;
+        if (index == 0 && total > 0 && request->_tempObject == nullptr && total < _maxContentLength) {
+            request->_tempObject = calloc(total + 1, 1);
+        }
+        if (request->_tempObject != nullptr) {
+            memcpy(static_cast<uint8_t*>(request->_tempObject) + index, data, len);
+        }
+    }
+
+private:
+    String _uri;
+    WebRequestMethodComposite _method = HTTP_GET | HTTP_POST | HTTP_PUT | HTTP_PATCH;
+    ArJsonRequestHandlerFunction _onRequest;
+    size_t _maxJsonBufferSize;
+    size_t _contentLength = 0;
+    size_t _maxContentLength = 16384;
+};
+
+#endif // ASYNC_JSON_H
@@ -0,0 +1,258 @@
+#include "ESPAsyncWebServer.h"
+#include <algorithm>
+
+// Constructor
+AsyncWebServerResponse::AsyncWebServerResponse(int code, const String& contentType, const String& content) {
+    this->_code = code;
+    this->_contentType = contentType;
+    this->_content = content;
+}
+
+// Add a response header
+void AsyncWebServerResponse::addHeader(const String& name, const String& value) {
+    _headers.push_back(AsyncWebHeader(name, value));
+}
+
+// Find a response header by name
+const AsyncWebHeader* AsyncWebServerResponse::getHeader(const String& name) const {
+    for (const AsyncWebHeader& header : _headers) {
+        if (header.name().equalsIgnoreCase(name)) {
+            return &header;
+        }
+    }
+    return nullptr;
+}
+
+// Append a byte to the body
+size_t AsyncResponseStream::write(uint8_t c) {
+    _content.concat((char)c);
+    return 1;
+}
+
+// Append bytes to the body
+size_t AsyncResponseStream::write(const uint8_t* data, size_t len) {
+    _content.concat((const char*)data, len);
+    return len;
+}
+
+// Constructor
+AsyncWebServerRequest::AsyncWebServerRequest(WebRequestMethodComposite method, const String& url) {
+    this->_tempObject = nullptr;
+    this->_method = method;
+    this->_url = url;
+    this->_response = nullptr;
+}
+
+// Destructor (the connection is released)
+AsyncWebServerRequest::~AsyncWebServerRequest() {
+    if (_onDisconnect) {
+        _onDisconnect();
+    }
+    free(_tempObject);
+    delete _response;
+}
+
+// Find a request header by name
+const AsyncWebHeader* AsyncWebServerRequest::getHeader(const String& name) const {
+    for (const AsyncWebHeader& header : _headers) {
+        if (header.name().equalsIgnoreCase(name)) {
+            return &header;
+        }
+    }
+    return nullptr;
+}
+
+// Declared body length (the Content-Length header), or the body's own length
+size_t AsyncWebServerRequest::contentLength() const {
+    const AsyncWebHeader* header = getHeader("Content-Length");
+    return header != nullptr ? header->value().toInt() : _body.length();
+}
+
+// Find a parameter by name
+const AsyncWebParameter* AsyncWebServerRequest::getParam(const String& name) const {
+    for (const AsyncWebParameter& param : _params) {
+        if (param.name() == name) {
+            return &param;
+        }
+    }
+    return nullptr;
+}
+
+// Send a response with an in-memory body
+void AsyncWebServerRequest::send(int code, const String& contentType, const String& content) {
+    send(beginResponse(code, contentType, content));
+}
+
+// Send a prepared response, taking ownership of it
+void AsyncWebServerRequest::send(AsyncWebServerResponse* response) {
+    if (_response != nullptr) {
+        delete response;
+        return;
+    }
+    _response = response;
+}
+
+// Create a response to be sent with send()
+AsyncWebServerResponse* AsyncWebServerRequest::beginResponse(int code, const String& contentType, const String& content) {
+    return new AsyncWebServerResponse(code, contentType, content);
+}
+
+// Create a response written through Print
+AsyncResponseStream* AsyncWebServerRequest::beginResponseStream(const String& contentType, size_t bufferSize) {
+    return new AsyncResponseStream(contentType);
+}
+
+// Add or replace a request header
+void AsyncWebServerRequest::setHeader(const String& name, const String& value) {
+    for (AsyncWebHeader& header : _headers) {
+        if (header.name().equalsIgnoreCase(name)) {
+            header = AsyncWebHeader(name, value);
+            return;
+        }
+    }
+    _headers.push_back(AsyncWebHeader(name, value));
+}
+
+// Add a parameter
+void AsyncWebServerRequest::setParam(const String& name, const String& value) {
+    _params.push_back(AsyncWebParameter(name, value));
+}
+
+// Set a text body and its content type
+void AsyncWebServerRequest::setBody(const String& body, const String& contentType) {
+    setBody((const uint8_t*)body.c_str(), body.length(), contentType);
+}
+
+// Set a binary body and its content type
+void AsyncWebServerRequest::setBody(const uint8_t* data, size_t len, const String& contentType) {
+    _body = String();
+    _body.concat((const char*)data, len);
+    _contentType = contentType;
+    setHeader("Content-Type", contentType);
+    setHeader("Content-Length", String((unsigned long)len));
+}
+
+// Check whether a path is served by a handler uri
+bool AsyncCallbackWebHandler::uriMatches(const String& uri, const String& url) {
+    if (uri.length() == 0 || uri == url) {
+        return true;
+    }
+    if (uri.endsWith("*")) {
+        return url.startsWith(uri.substring(0, uri.length() - 1));
+    }
+    return url.startsWith(uri + "/");
+}
+
+// Check the method and uri
+bool AsyncCallbackWebHandler::canHandle(AsyncWebServerRequest* request) {
+    if (!_onRequest || !(_method & request->method())) {
+        return false;
+    }
+    return uriMatches(_uri, request->url());
+}
+
+// Run the request callback
+void AsyncCallbackWebHandler::handleRequest(AsyncWebServerRequest* request) {
+    if (_onRequest) {
+        _onRequest(request);
+    } else {
+        request->send(500);
+    }
+}
+
+// Run the body callback
+void AsyncCallbackWebHandler::handleBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) {
+    if (_onBody) {
+        _onBody(request, data, len, index, total);
+    }
+}
+
+// Destructor
+AsyncWebServer::~AsyncWebServer() {
+    reset();
+}
+
+// Add a handler, owned by the server
+AsyncWebHandler& AsyncWebServer::addHandler(AsyncWebHandler* handler) {
+    _handlers.push_back(handler);
+    return *handler;
+}
+
+// Remove a handler (the caller takes it back)
+bool AsyncWebServer::removeHandler(AsyncWebHandler* handler) {
+    auto it = std::find(_handlers.begin(), _handlers.end(), handler);
+    if (it == _handlers.end()) {
+        return false;
+    }
+    _handlers.erase(it);
+    return true;
+}
+
+// Register a callback for any method
+AsyncCallbackWebHandler& AsyncWebServer::on(const char* uri, ArRequestHandlerFunction onRequest) {
+    return on(uri, HTTP_ANY, onRequest);
+}
+
+// Register callbacks for a uri and methods
+AsyncCallbackWebHandler& AsyncWebServer::on(const char* uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest,
+                                            ArUploadHandlerFunction onUpload, ArBodyHandlerFunction onBody) {
+    AsyncCallbackWebHandler* handler = new AsyncCallbackWebHandler();
+    handler->setUri(uri);
+    handler->setMethod(method);
+    handler->onRequest(onRequest);
+    handler->onUpload(onUpload);
+    handler->onBody(onBody);
+    addHandler(handler);
+    return *handler;
+}
+
+// Remove and free every handler
+void AsyncWebServer::reset() {
+    for (AsyncWebHandler* handler : _handlers) {
+        delete handler;
+    }
+    _handlers.clear();
+    _notFound = nullptr;
+}
+
+// Run the middlewares from index on, then the final step
+void AsyncWebServer::runChain(AsyncWebServerRequest* request, size_t index, ArMiddlewareNext last) {
+    if (index == _middlewares.size()) {
+        last();
+        return;
+    }
+    _middlewares[index](request, [this, request, index, last]() {
+        runChain(request, index + 1, last);
+    });
+}
+
+// Route a request to its handler
+void AsyncWebServer::dispatch(AsyncWebServerRequest* request) {
+    for (AsyncWebHandler* handler : _handlers) {
+        if (handler->filter(request) && handler->canHandle(request)) {
+            size_t total = request->contentLength();
+            String body = request->body();
+            if (body.length() > 0) {
+                handler->handleBody(request, (uint8_t*)body.c_str(), body.length(), 0, total);
+            }
+            
+            // The rest of the body never arrives
+            if (body.length() < total) {
+                return;
+            }
+            
+            runChain(request, 0, [handler, request]() {
+                handler->handleRequest(request);
+            });
+            return;
+        }
+    }
+    
+    runChain(request, 0, [this, request]() {
+        if (_notFound) {
+            _notFound(request);
+        } else {
+            request->send(404);
+        }
+    });
+}
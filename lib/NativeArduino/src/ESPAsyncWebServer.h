@@ -0,0 +1,224 @@
+#ifndef ESPASYNCWEBSERVER_H
+#define ESPASYNCWEBSERVER_H
+
+// Host stand-in for ESPAsyncWebServer without sockets: tests build requests
+// and pass them to AsyncWebServer::dispatch(), which matches handlers, feeds
+// the body and keeps the response the way the library does.
+
+#include <Arduino.h>
+#include <functional>
+#include <vector>
+
+typedef enum {
+    HTTP_GET = 0b00000001,
+    HTTP_POST = 0b00000010,
+    HTTP_DELETE = 0b00000100,
+    HTTP_PUT = 0b00001000,
+    HTTP_PATCH = 0b00010000,
+    HTTP_HEAD = 0b00100000,
+    HTTP_OPTIONS = 0b01000000,
+    HTTP_ANY = 0b01111111,
+} WebRequestMethod;
+
+typedef uint8_t WebRequestMethodComposite;
+
+class AsyncWebServerRequest;
+class AsyncWebServerResponse;
+
+typedef std::function<void(AsyncWebServerRequest* request)> ArRequestHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest* request, const String& filename, size_t index, uint8_t* data, size_t len, bool final)> ArUploadHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total)> ArBodyHandlerFunction;
+typedef std::function<bool(AsyncWebServerRequest* request)> ArRequestFilterFunction;
+typedef std::function<void(void)> ArDisconnectHandler;
+typedef std::function<void(void)> ArMiddlewareNext;
+typedef std::function<void(AsyncWebServerRequest* request, ArMiddlewareNext next)> ArMiddlewareCallback;
+
+// Request or response header
+class AsyncWebHeader {
+public:
+    AsyncWebHeader(const String& name, const String& value) : _name(name), _value(value) {}
+    const String& name() const { return _name; }
+    const String& value() const { return _value; }
+    String toString() const { return _name + ": " + _value + "\r\n"; }
+
+private:
+    String _name;
+    String _value;
+};
+
+// Query or form parameter
+class AsyncWebParameter {
+public:
+    AsyncWebParameter(const String& name, const String& value) : _name(name), _value(value) {}
+    const String& name() const { return _name; }
+    const String& value() const { return _value; }
+
+private:
+    String _name;
+    String _value;
+};
+
+// Response with its body held in memory
+class AsyncWebServerResponse {
+public:
+    AsyncWebServerResponse(int code, const String& contentType, const String& content = String());
+    virtual ~AsyncWebServerResponse() {}
+    
+    void setCode(int code) { _code = code; }
+    int code() const { return _code; }
+    void setContentType(const String& type) { _contentType = type; }
+    const String& contentType() const { return _contentType; }
+    void addHeader(const String& name, const String& value);
+    const AsyncWebHeader* getHeader(const String& name) const;
+    const std::vector<AsyncWebHeader>& headers() const { return _headers; }
+    
+    // Host-only: the body that would be sent
+    const String& body() const { return _content; }
+
+protected:
+    int _code;
+    String _contentType;
+    String _content;
+    std::vector<AsyncWebHeader> _headers;
+};
+
+// Response written through Print
+class AsyncResponseStream : public AsyncWebServerResponse, public Print {
+public:
+    explicit AsyncResponseStream(const String& contentType) : AsyncWebServerResponse(200, contentType) {}
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* data, size_t len) override;
+    using Print::write;
+};
+
+class AsyncWebServerRequest {
+public:
+    // Host-only: a request as the parser would hand it to the handlers
+    AsyncWebServerRequest(WebRequestMethodComposite method, const String& url);
+    ~AsyncWebServerRequest();
+    AsyncWebServerRequest(const AsyncWebServerRequest&) = delete;
+    AsyncWebServerRequest& operator=(const AsyncWebServerRequest&) = delete;
+    
+    WebRequestMethodComposite method() const { return _method; }
+    const String& url() const { return _url; }
+    const String& contentType() const { return _contentType; }
+    size_t contentLength() const;
+    
+    // Headers (names are case-insensitive)
+    bool hasHeader(const String& name) const { return getHeader(name) != nullptr; }
+    const AsyncWebHeader* getHeader(const String& name) const;
+    size_t headers() const { return _headers.size(); }
+    const AsyncWebHeader* getHeader(size_t num) const { return num < _headers.size() ? &_headers[num] : nullptr; }
+    
+    // Parameters
+    bool hasParam(const String& name) const { return getParam(name) != nullptr; }
+    const AsyncWebParameter* getParam(const String& name) const;
+    
+    // Called when the connection is released (only one handler is kept, as in the library)
+    void onDisconnect(ArDisconnectHandler fn) { _onDisconnect = fn; }
+    
+    // Responses (only the first one sent is kept, as on the wire)
+    void send(int code, const String& contentType = String(), const String& content = String());
+    void send(int code, const String& contentType, const char* content) { send(code, contentType, String(content)); }
+    void send(AsyncWebServerResponse* response);
+    AsyncWebServerResponse* beginResponse(int code, const String& contentType = String(), const String& content = String());
+    AsyncResponseStream* beginResponseStream(const String& contentType, size_t bufferSize = 1460);
+    
+    // Host-only: build the request (deleting it releases the connection)
+    void setHeader(const String& name, const String& value);
+    void setParam(const String& name, const String& value);
+    void setBody(const String& body, const String& contentType);
+    void setBody(const uint8_t* data, size_t len, const String& contentType);
+    const String& body() const { return _body; }
+    
+    // Host-only: the response sent, or null
+    const AsyncWebServerResponse* response() const { return _response; }
+    int responseCode() const { return _response != nullptr ? _response->code() : 0; }
+    String responseBody() const { return _response != nullptr ? _response->body() : String(); }
+    const AsyncWebHeader* responseHeader(const String& name) const { return _response != nullptr ? _response->getHeader(name) : nullptr; }
+    
+    // Handler scratch space, freed with the request
+    void* _tempObject;
+
+private:
+    WebRequestMethodComposite _method;
+    String _url;
+    String _contentType;
+    String _body;
+    std::vector<AsyncWebHeader> _headers;
+    std::vector<AsyncWebParameter> _params;
+    AsyncWebServerResponse* _response;
+    ArDisconnectHandler _onDisconnect;
+};
+
+class AsyncWebHandler {
+public:
+    virtual ~AsyncWebHandler() {}
+    AsyncWebHandler& setFilter(ArRequestFilterFunction fn) { _filter = fn; return *this; }
+    bool filter(AsyncWebServerRequest* request) { return !_filter || _filter(request); }
+    virtual bool canHandle(AsyncWebServerRequest* request) { return false; }
+    virtual void handleRequest(AsyncWebServerRequest* request) {}
+    virtual void handleBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) {}
+
+protected:
+    ArRequestFilterFunction _filter;
+};
+
+// Handler registered with AsyncWebServer::on()
+class AsyncCallbackWebHandler : public AsyncWebHandler {
+public:
+    void setUri(const String& uri) { _uri = uri; }
+    void setMethod(WebRequestMethodComposite method) { _method = method; }
+    void onRequest(ArRequestHandlerFunction fn) { _onRequest = fn; }
+    void onUpload(ArUploadHandlerFunction fn) { _onUpload = fn; }
+    void onBody(ArBodyHandlerFunction fn) { _onBody = fn; }
+    
+    bool canHandle(AsyncWebServerRequest* request) override;
+    void handleRequest(AsyncWebServerRequest* request) override;
+    void handleBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) override;
+    
+    // Exact match, "uri/..." below it, or a prefix when the uri ends in '*'
+    static bool uriMatches(const String& uri, const String& url);
+
+private:
+    String _uri;
+    WebRequestMethodComposite _method = HTTP_ANY;
+    ArRequestHandlerFunction _onRequest;
+    ArUploadHandlerFunction _onUpload;
+    ArBodyHandlerFunction _onBody;
+};
+
+class AsyncWebServer {
+public:
+    explicit AsyncWebServer(uint16_t port) : _port(port) {}
+    ~AsyncWebServer();
+    
+    void begin() {}
+    void end() {}
+    
+    AsyncWebHandler& addHandler(AsyncWebHandler* handler);
+    bool removeHandler(AsyncWebHandler* handler);
+    AsyncCallbackWebHandler& on(const char* uri, ArRequestHandlerFunction onRequest);
+    AsyncCallbackWebHandler& on(const char* uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest,
+                                ArUploadHandlerFunction onUpload = nullptr, ArBodyHandlerFunction onBody = nullptr);
+    void onNotFound(ArRequestHandlerFunction fn) { _notFound = fn; }
+    void addMiddleware(ArMiddlewareCallback fn) { _middlewares.push_back(fn); }
+    void reset();
+    
+    // Host-only: run a request through the first matching handler, or the
+    // not-found handler / a 404. As in the library, the body (in one chunk)
+    // reaches the handler before the middleware chain runs; a body shorter
+    // than its Content-Length header is a connection still uploading
+    void dispatch(AsyncWebServerRequest* request);
+
+private:
+    uint16_t _port;
+    std::vector<AsyncWebHandler*> _handlers;
+    std::vector<ArMiddlewareCallback> _middlewares;
+    ArRequestHandlerFunction _notFound;
+    
+    // Run the middlewares from index on, then the final step
+    void runChain(AsyncWebServerRequest* request, size_t index, ArMiddlewareNext last);
+};
+
+#endif // ESPASYNCWEBSERVER_H
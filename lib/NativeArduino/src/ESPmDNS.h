@@ -0,0 +1,19 @@
+#ifndef NATIVE_ESPMDNS_H
+#define NATIVE_ESPMDNS_H
+
+// Host stand-in for mDNS: names and services are accepted and ignored
+
+#include <Arduino.h>
+
+class MDNSResponder {
+public:
+    bool begin(const char* hostName) { return true; }
+    void end() {}
+    bool addService(const char* service, const char* proto, uint16_t port) { return true; }
+    bool addService(const String& service, const String& proto, uint16_t port) { return true; }
+    void setInstanceName(const char* name) {}
+};
+
+extern MDNSResponder MDNS;
+
+#endif // NATIVE_ESPMDNS_H
@@ -0,0 +1,15 @@
+#ifndef NATIVE_ESPALEXA_H
+#define NATIVE_ESPALEXA_H
+
+// Host stand-in for Espalexa: the native build doesn't run the Hue bridge
+// emulation, so only the type is provided for headers that hold a pointer
+
+#include <Arduino.h>
+
+class Espalexa {
+public:
+    bool begin() { return true; }
+    void loop() {}
+};
+
+#endif // NATIVE_ESPALEXA_H
@@ -0,0 +1,243 @@
+#include "FS.h"
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+#include <vector>
+
+namespace fs {
+
+// An open host file, or a directory listing
+class FileImpl {
+public:
+    FILE* file = nullptr;
+    std::string hostPath;
+    std::string path;
+    bool directory = false;
+    std::vector<std::string> entries;       // Directory entries (file system paths)
+    size_t nextEntry = 0;
+    
+    ~FileImpl() {
+        if (file != nullptr) {
+            fclose(file);
+        }
+    }
+};
+
+// Host path of a file system path
+std::string FS::hostPath(const char* path) const {
+    if (root.empty() || path == nullptr || path[0] != '/') {
+        return "";
+    }
+    return root + path;
+}
+
+// Open a file ("r", "w", "a" and their "+" forms) or a directory
+File FS::open(const char* path, const char* mode, const bool create) {
+    std::string host = hostPath(path);
+    if (host.empty()) {
+        return File();
+    }
+    
+    auto impl = std::make_shared<FileImpl>();
+    impl->hostPath = host;
+    impl->path = path;
+    
+    std::error_code error;
+    if (std::filesystem::is_directory(host, error)) {
+        impl->directory = true;
+        for (const auto& entry : std::filesystem::directory_iterator(host, error)) {
+            std::string name = entry.path().filename().string();
+            impl->entries.push_back(impl->path == "/" ? "/" + name : impl->path + "/" + name);
+        }
+        std::sort(impl->entries.begin(), impl->entries.end());
+        return File(impl);
+    }
+    
+    // Writing creates missing parent directories
+    std::string hostMode = mode;
+    if (hostMode[0] == 'w' || hostMode[0] == 'a') {
+        std::filesystem::create_directories(std::filesystem::path(host).parent_path(), error);
+    }
+    
+    hostMode += 'b';
+    impl->file = fopen(host.c_str(), hostMode.c_str());
+    if (impl->file == nullptr) {
+        return File();
+    }
+    return File(impl);
+}
+
+bool FS::exists(const char* path) {
+    std::string host = hostPath(path);
+    std::error_code error;
+    return !host.empty() && std::filesystem::exists(host, error);
+}
+
+bool FS::remove(const char* path) {
+    std::string host = hostPath(path);
+    std::error_code error;
+    return !host.empty() && std::filesystem::is_regular_file(host, error) && std::filesystem::remove(host, error);
+}
+
+bool FS::rename(const char* pathFrom, const char* pathTo) {
+    std::string from = hostPath(pathFrom);
+    std::string to = hostPath(pathTo);
+    if (from.empty() || to.empty()) {
+        return false;
+    }
+    
+    std::error_code error;
+    std::filesystem::rename(from, to, error);
+    return !error;
+}
+
+bool FS::mkdir(const char* path) {
+    std::string host = hostPath(path);
+    std::error_code error;
+    if (host.empty()) {
+        return false;
+    }
+    std::filesystem::create_directories(host, error);
+    return std::filesystem::is_directory(host, error);
+}
+
+bool FS::rmdir(const char* path) {
+    std::string host = hostPath(path);
+    std::error_code error;
+    return !host.empty() && std::filesystem::is_directory(host, error) && std::filesystem::remove(host, error);
+}
+
+size_t File::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t File::write(const uint8_t* buffer, size_t size) {
+    if (!impl || impl->file == nullptr) {
+        return 0;
+    }
+    return fwrite(buffer, 1, size, impl->file);
+}
+
+int File::available() {
+    if (!impl || impl->file == nullptr) {
+        return 0;
+    }
+    return size() - position();
+}
+
+int File::read() {
+    if (!impl || impl->file == nullptr) {
+        return -1;
+    }
+    int c = fgetc(impl->file);
+    return c == EOF ? -1 : c;
+}
+
+int File::peek() {
+    if (!impl || impl->file == nullptr) {
+        return -1;
+    }
+    int c = fgetc(impl->file);
+    if (c == EOF) {
+        return -1;
+    }
+    ungetc(c, impl->file);
+    return c;
+}
+
+size_t File::readBytes(char* buffer, size_t length) {
+    return read((uint8_t*)buffer, length);
+}
+
+size_t File::read(uint8_t* buffer, size_t size) {
+    if (!impl || impl->file == nullptr) {
+        return 0;
+    }
+    return fread(buffer, 1, size, impl->file);
+}
+
+void File::flush() {
+    if (impl && impl->file != nullptr) {
+        fflush(impl->file);
+    }
+}
+
+bool File::seek(uint32_t position, SeekMode mode) {
+    if (!impl || impl->file == nullptr) {
+        return false;
+    }
+    return fseek(impl->file, position, mode == SeekSet ? SEEK_SET : (mode == SeekCur ? SEEK_CUR : SEEK_END)) == 0;
+}
+
+size_t File::position() const {
+    if (!impl || impl->file == nullptr) {
+        return 0;
+    }
+    long position = ftell(impl->file);
+    return position < 0 ? 0 : position;
+}
+
+size_t File::size() const {
+    if (!impl || impl->file == nullptr) {
+        return 0;
+    }
+    fflush(impl->file);
+    std::error_code error;
+    uintmax_t size = std::filesystem::file_size(impl->hostPath, error);
+    return error ? 0 : size;
+}
+
+// Close the file (other copies of this File are closed too, as on the device)
+void File::close() {
+    if (impl && impl->file != nullptr) {
+        fclose(impl->file);
+        impl->file = nullptr;
+    }
+    impl.reset();
+}
+
+File::operator bool() const {
+    return impl && (impl->file != nullptr || impl->directory);
+}
+
+bool File::isDirectory() const {
+    return impl && impl->directory;
+}
+
+const char* File::path() const {
+    return impl ? impl->path.c_str() : nullptr;
+}
+
+const char* File::name() const {
+    if (!impl) {
+        return nullptr;
+    }
+    size_t slash = impl->path.rfind('/');
+    return impl->path.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+}
+
+// Next entry of an open directory (invalid File when done)
+File File::openNextFile(const char* mode) {
+    if (!impl || !impl->directory || impl->nextEntry >= impl->entries.size()) {
+        return File();
+    }
+    
+    const std::string& entryPath = impl->entries[impl->nextEntry++];
+    std::string root = impl->hostPath.substr(0, impl->hostPath.length() - (impl->path == "/" ? 1 : impl->path.length()));
+    
+    auto entry = std::make_shared<FileImpl>();
+    entry->path = entryPath;
+    entry->hostPath = root + entryPath;
+    
+    std::error_code error;
+    if (std::filesystem::is_directory(entry->hostPath, error)) {
+        entry->directory = true;
+        return File(entry);
+    }
+    
+    std::string hostMode = std::string(mode) + "b";
+    entry->file = fopen(entry->hostPath.c_str(), hostMode.c_str());
+    return entry->file != nullptr ? File(entry) : File();
+}
+
+}
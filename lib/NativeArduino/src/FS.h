@@ -0,0 +1,89 @@
+#ifndef FS_H
+#define FS_H
+
+#include <stdio.h>
+#include <memory>
+#include <string>
+#include "Arduino.h"
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+enum SeekMode {
+    SeekSet = 0,
+    SeekCur = 1,
+    SeekEnd = 2
+};
+
+// An open file or directory of a host-backed file system
+class FileImpl;
+
+class File : public Stream {
+private:
+    std::shared_ptr<FileImpl> impl;
+
+public:
+    File() {}
+    File(std::shared_ptr<FileImpl> impl) : impl(impl) {}
+    
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t readBytes(char* buffer, size_t length) override;
+    using Stream::readBytes;
+    size_t read(uint8_t* buffer, size_t size);
+    void flush() override;
+    bool seek(uint32_t position, SeekMode mode = SeekSet);
+    size_t position() const;
+    size_t size() const;
+    void close();
+    operator bool() const;
+    bool isDirectory() const;
+    
+    // Full path and file name (without the directory)
+    const char* path() const;
+    const char* name() const;
+    
+    // Next entry of an open directory (invalid File when done)
+    File openNextFile(const char* mode = FILE_READ);
+};
+
+// File system rooted in a host directory
+class FS {
+protected:
+    std::string root;           // Host directory, empty until mounted
+    
+    // Host path of a file system path
+    std::string hostPath(const char* path) const;
+
+public:
+    File open(const char* path, const char* mode = FILE_READ, const bool create = false);
+    File open(const String& path, const char* mode = FILE_READ, const bool create = false) { return open(path.c_str(), mode, create); }
+    bool exists(const char* path);
+    bool exists(const String& path) { return exists(path.c_str()); }
+    bool remove(const char* path);
+    bool remove(const String& path) { return remove(path.c_str()); }
+    bool rename(const char* pathFrom, const char* pathTo);
+    bool rename(const String& pathFrom, const String& pathTo) { return rename(pathFrom.c_str(), pathTo.c_str()); }
+    bool mkdir(const char* path);
+    bool mkdir(const String& path) { return mkdir(path.c_str()); }
+    bool rmdir(const char* path);
+    bool rmdir(const String& path) { return rmdir(path.c_str()); }
+};
+
+}
+
+using fs::File;
+using fs::FS;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
+
+#endif // FS_H
@@ -0,0 +1,86 @@
+#include "LittleFS.h"
+#include "NativeArduino.h"
+#include <stdlib.h>
+#include <filesystem>
+#include <system_error>
+
+LittleFSFS LittleFS;
+
+// Size of the firmware's LittleFS partition (min_spiffs.csv)
+static const size_t PARTITION_BYTES = 128 * 1024;
+
+// Remove the temporary directory at exit
+static std::string temporaryDirectory;
+
+static void removeTemporaryDirectory() {
+    std::error_code error;
+    std::filesystem::remove_all(temporaryDirectory, error);
+}
+
+// Mount, creating the backing directory the first time
+bool LittleFSFS::begin(bool formatOnFail, const char* basePath, uint8_t maxOpenFiles, const char* partitionLabel) {
+    if (directory.empty()) {
+        const char* configured = getenv("NATIVE_LITTLEFS_DIR");
+        if (configured != nullptr && configured[0] != '\0') {
+            std::error_code error;
+            std::filesystem::create_directories(configured, error);
+            directory = configured;
+        } else {
+            char pattern[] = "/tmp/littlefs-XXXXXX";
+            if (mkdtemp(pattern) == nullptr) {
+                return false;
+            }
+            directory = pattern;
+            temporaryDirectory = directory;
+            atexit(removeTemporaryDirectory);
+        }
+    }
+    
+    root = directory;
+    return true;
+}
+
+// Unmount (files stay for the next begin())
+void LittleFSFS::end() {
+    root.clear();
+}
+
+// Remove every file
+bool LittleFSFS::format() {
+    if (directory.empty()) {
+        return false;
+    }
+    
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        std::filesystem::remove_all(entry.path(), error);
+    }
+    return !error;
+}
+
+size_t LittleFSFS::totalBytes() {
+    return PARTITION_BYTES;
+}
+
+size_t LittleFSFS::usedBytes() {
+    if (root.empty()) {
+        return 0;
+    }
+    
+    size_t used = 0;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(root, error)) {
+        if (entry.is_regular_file(error)) {
+            used += entry.file_size(error);
+        }
+    }
+    return used;
+}
+
+namespace NativeArduino {
+
+String littleFsRoot() {
+    return String(LittleFS.hostDirectory().c_str());
+}
+
+}
@@ -0,0 +1,28 @@
+#ifndef LITTLEFS_H
+#define LITTLEFS_H
+
+#include "FS.h"
+
+// LittleFS on a host directory: NATIVE_LITTLEFS_DIR if set, otherwise a
+// temporary directory created on the first begin() and removed at exit
+class LittleFSFS : public fs::FS {
+private:
+    std::string directory;
+
+public:
+    bool begin(bool formatOnFail = false, const char* basePath = "/littlefs", uint8_t maxOpenFiles = 10, const char* partitionLabel = "spiffs");
+    void end();
+    
+    // Remove every file
+    bool format();
+    
+    size_t totalBytes();
+    size_t usedBytes();
+    
+    // Host directory backing the file system (empty before the first begin())
+    const std::string& hostDirectory() const { return directory; }
+};
+
+extern LittleFSFS LittleFS;
+
+#endif // LITTLEFS_H
@@ -0,0 +1,32 @@
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+#include <Arduino.h>
+
+// Test hooks of the host stand-ins (not available on the device)
+namespace NativeArduino {
+
+// Move millis(), micros() and the FreeRTOS tick count forward (sleeps stay real)
+void advanceMillis(unsigned long ms);
+
+// Drive an input pin, as a button or sensor would
+void setPinLevel(uint8_t pin, int level);
+
+// Level last written to or set on a pin
+int getPinLevel(uint8_t pin);
+
+// Mode last set with pinMode(), 0 if never configured
+uint8_t getPinMode(uint8_t pin);
+
+// Queue text to be read from Serial
+void feedSerial(const char* text);
+
+// Directory backing LittleFS (created on the first LittleFS.begin())
+String littleFsRoot();
+
+// Forget every Preferences namespace
+void clearPreferences();
+
+}
+
+#endif // NATIVE_ARDUINO_H
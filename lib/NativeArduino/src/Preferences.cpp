@@ -0,0 +1,139 @@
+#include "Preferences.h"
+#include "NativeArduino.h"
+#include <map>
+#include <mutex>
+
+// Namespace -> key -> value; NVS keys and namespaces are at most 15 characters
+static const size_t MAX_KEY_LENGTH = 15;
+static std::mutex storeLock;
+
+static std::map<std::string, std::map<std::string, std::vector<uint8_t>>>& store() {
+    static auto* namespaces = new std::map<std::string, std::map<std::string, std::vector<uint8_t>>>();
+    return *namespaces;
+}
+
+// Open a namespace (created on first write unless read-only)
+bool Preferences::begin(const char* name, bool readOnly, const char* partitionLabel) {
+    if (!this->name.empty() || name == nullptr || name[0] == '\0' || strlen(name) > MAX_KEY_LENGTH) {
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> guard(storeLock);
+    if (readOnly && store().find(name) == store().end()) {
+        // Like NVS, a namespace that was never written can't be opened read-only
+        return false;
+    }
+    
+    this->name = name;
+    this->readOnly = readOnly;
+    return true;
+}
+
+void Preferences::end() {
+    name.clear();
+}
+
+bool Preferences::clear() {
+    if (name.empty() || readOnly) {
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> guard(storeLock);
+    store()[name].clear();
+    return true;
+}
+
+bool Preferences::remove(const char* key) {
+    if (name.empty() || readOnly) {
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> guard(storeLock);
+    return store()[name].erase(key) > 0;
+}
+
+bool Preferences::isKey(const char* key) {
+    return getValue(key) != nullptr;
+}
+
+// Store a raw value, returns the bytes written (0 on failure)
+size_t Preferences::putValue(const char* key, const void* value, size_t length) {
+    if (name.empty() || readOnly || key == nullptr || strlen(key) > MAX_KEY_LENGTH) {
+        return 0;
+    }
+    
+    std::lock_guard<std::mutex> guard(storeLock);
+    const uint8_t* bytes = static_cast<const uint8_t*>(value);
+    store()[name][key].assign(bytes, bytes + length);
+    return length;
+}
+
+// Fetch a raw value, null if the key doesn't exist
+const std::vector<uint8_t>* Preferences::getValue(const char* key) const {
+    if (name.empty() || key == nullptr) {
+        return nullptr;
+    }
+    
+    std::lock_guard<std::mutex> guard(storeLock);
+    auto space = store().find(name);
+    if (space == store().end()) {
+        return nullptr;
+    }
+    
+    auto value = space->second.find(key);
+    return value == space->second.end() ? nullptr : &value->second;
+}
+
+// Strings are stored with their terminator, as NVS does
+size_t Preferences::putString(const char* key, const char* value) {
+    return putValue(key, value, strlen(value) + 1) > 0 ? strlen(value) : 0;
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t length) {
+    return putValue(key, value, length);
+}
+
+String Preferences::getString(const char* key, const String defaultValue) {
+    const std::vector<uint8_t>* value = getValue(key);
+    if (value == nullptr || value->empty()) {
+        return defaultValue;
+    }
+    return String(reinterpret_cast<const char*>(value->data()));
+}
+
+size_t Preferences::getString(const char* key, char* value, size_t maxLength) {
+    const std::vector<uint8_t>* stored = getValue(key);
+    if (stored == nullptr || stored->size() > maxLength) {
+        return 0;
+    }
+    memcpy(value, stored->data(), stored->size());
+    return stored->size();
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+    const std::vector<uint8_t>* value = getValue(key);
+    return value == nullptr ? 0 : value->size();
+}
+
+size_t Preferences::getBytes(const char* key, void* buffer, size_t maxLength) {
+    const std::vector<uint8_t>* value = getValue(key);
+    if (value == nullptr || value->size() > maxLength) {
+        return 0;
+    }
+    memcpy(buffer, value->data(), value->size());
+    return value->size();
+}
+
+// Entries left in the partition (not tracked on the host)
+size_t Preferences::freeEntries() {
+    return 630;
+}
+
+namespace NativeArduino {
+
+void clearPreferences() {
+    std::lock_guard<std::mutex> guard(storeLock);
+    store().clear();
+}
+
+}
@@ -0,0 +1,81 @@
+#ifndef PREFERENCES_H
+#define PREFERENCES_H
+
+#include <string>
+#include <vector>
+#include "Arduino.h"
+
+// NVS key-value storage, kept in memory for the life of the process
+class Preferences {
+private:
+    std::string name;           // Open namespace, empty if none
+    bool readOnly = false;
+    
+    // Store and fetch raw values
+    size_t putValue(const char* key, const void* value, size_t length);
+    const std::vector<uint8_t>* getValue(const char* key) const;
+    
+    template <typename T>
+    size_t put(const char* key, T value) {
+        return putValue(key, &value, sizeof(value));
+    }
+    
+    template <typename T>
+    T get(const char* key, T defaultValue) const {
+        const std::vector<uint8_t>* value = getValue(key);
+        if (value == nullptr || value->size() != sizeof(T)) {
+            return defaultValue;
+        }
+        T result;
+        memcpy(&result, value->data(), sizeof(T));
+        return result;
+    }
+
+public:
+    ~Preferences() { end(); }
+    
+    bool begin(const char* name, bool readOnly = false, const char* partitionLabel = nullptr);
+    void end();
+    
+    bool clear();
+    bool remove(const char* key);
+    bool isKey(const char* key);
+    
+    size_t putChar(const char* key, int8_t value) { return put(key, value); }
+    size_t putUChar(const char* key, uint8_t value) { return put(key, value); }
+    size_t putShort(const char* key, int16_t value) { return put(key, value); }
+    size_t putUShort(const char* key, uint16_t value) { return put(key, value); }
+    size_t putInt(const char* key, int32_t value) { return put(key, value); }
+    size_t putUInt(const char* key, uint32_t value) { return put(key, value); }
+    size_t putLong(const char* key, int32_t value) { return put(key, value); }
+    size_t putULong(const char* key, uint32_t value) { return put(key, value); }
+    size_t putLong64(const char* key, int64_t value) { return put(key, value); }
+    size_t putULong64(const char* key, uint64_t value) { return put(key, value); }
+    size_t putFloat(const char* key, float value) { return put(key, value); }
+    size_t putDouble(const char* key, double value) { return put(key, value); }
+    size_t putBool(const char* key, bool value) { return put<uint8_t>(key, value ? 1 : 0); }
+    size_t putString(const char* key, const char* value);
+    size_t putString(const char* key, const String& value) { return putString(key, value.c_str()); }
+    size_t putBytes(const char* key, const void* value, size_t length);
+    
+    int8_t getChar(const char* key, int8_t defaultValue = 0) { return get(key, defaultValue); }
+    uint8_t getUChar(const char* key, uint8_t defaultValue = 0) { return get(key, defaultValue); }
+    int16_t getShort(const char* key, int16_t defaultValue = 0) { return get(key, defaultValue); }
+    uint16_t getUShort(const char* key, uint16_t defaultValue = 0) { return get(key, defaultValue); }
+    int32_t getInt(const char* key, int32_t defaultValue = 0) { return get(key, defaultValue); }
+    uint32_t getUInt(const char* key, uint32_t defaultValue = 0) { return get(key, defaultValue); }
+    int32_t getLong(const char* key, int32_t defaultValue = 0) { return get(key, defaultValue); }
+    uint32_t getULong(const char* key, uint32_t defaultValue = 0) { return get(key, defaultValue); }
+    int64_t getLong64(const char* key, int64_t defaultValue = 0) { return get(key, defaultValue); }
+    uint64_t getULong64(const char* key, uint64_t defaultValue = 0) { return get(key, defaultValue); }
+    float getFloat(const char* key, float defaultValue = NAN) { return get(key, defaultValue); }
+    double getDouble(const char* key, double defaultValue = NAN) { return get(key, defaultValue); }
+    bool getBool(const char* key, bool defaultValue = false) { return get<uint8_t>(key, defaultValue ? 1 : 0) != 0; }
+    String getString(const char* key, const String defaultValue = String());
+    size_t getString(const char* key, char* value, size_t maxLength);
+    size_t getBytesLength(const char* key);
+    size_t getBytes(const char* key, void* buffer, size_t maxLength);
+    size_t freeEntries();
+};
+
+#endif // PREFERENCES_H
@@ -0,0 +1,84 @@
+#include "Print.h"
+#include <stdio.h>
+#include <vector>
+
+// Write a buffer (byte by byte unless overridden)
+size_t Print::write(const uint8_t* buffer, size_t size) {
+    size_t written = 0;
+    while (written < size && write(buffer[written]) == 1) {
+        written++;
+    }
+    return written;
+}
+
+// Formatted output
+size_t Print::printf(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    va_list copy;
+    va_copy(copy, args);
+    int length = vsnprintf(nullptr, 0, format, copy);
+    va_end(copy);
+    
+    if (length < 0) {
+        va_end(args);
+        return 0;
+    }
+    
+    std::vector<char> text(length + 1);
+    vsnprintf(text.data(), text.size(), format, args);
+    va_end(args);
+    return write((const uint8_t*)text.data(), length);
+}
+
+size_t Print::print(const String& str) {
+    return write((const uint8_t*)str.c_str(), str.length());
+}
+
+size_t Print::print(const char* str) {
+    return write(str);
+}
+
+size_t Print::print(char c) {
+    return write((uint8_t)c);
+}
+
+size_t Print::print(unsigned char value, int base) {
+    return print(String(value, base));
+}
+
+size_t Print::print(int value, int base) {
+    return print(String(value, base));
+}
+
+size_t Print::print(unsigned int value, int base) {
+    return print(String(value, base));
+}
+
+size_t Print::print(long value, int base) {
+    return print(String(value, base));
+}
+
+size_t Print::print(unsigned long value, int base) {
+    return print(String(value, base));
+}
+
+size_t Print::print(long long value, int base) {
+    return print(String(value, base));
+}
+
+size_t Print::print(unsigned long long value, int base) {
+    return print(String(value, base));
+}
+
+size_t Print::print(double value, int decimals) {
+    return print(String(value, decimals));
+}
+
+size_t Print::print(const Printable& value) {
+    return value.printTo(*this);
+}
+
+size_t Print::println() {
+    return write("\r\n");
+}
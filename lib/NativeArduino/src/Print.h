@@ -0,0 +1,62 @@
+#ifndef PRINT_H
+#define PRINT_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "WString.h"
+
+class Print;
+
+// Object that can print itself
+class Printable {
+public:
+    virtual ~Printable() {}
+    virtual size_t printTo(Print& out) const = 0;
+};
+
+// Byte sink with Arduino's print helpers
+class Print {
+public:
+    virtual ~Print() {}
+    
+    // Write one byte, returns the number of bytes written
+    virtual size_t write(uint8_t c) = 0;
+    
+    // Write a buffer (byte by byte unless overridden)
+    virtual size_t write(const uint8_t* buffer, size_t size);
+    
+    size_t write(const char* str) { return str != nullptr ? write((const uint8_t*)str, strlen(str)) : 0; }
+    size_t write(const char* buffer, size_t size) { return write((const uint8_t*)buffer, size); }
+    
+    virtual void flush() {}
+    
+    // Formatted output
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+    
+    size_t print(const String& str);
+    size_t print(const char* str);
+    size_t print(char c);
+    size_t print(unsigned char value, int base = 10);
+    size_t print(int value, int base = 10);
+    size_t print(unsigned int value, int base = 10);
+    size_t print(long value, int base = 10);
+    size_t print(unsigned long value, int base = 10);
+    size_t print(long long value, int base = 10);
+    size_t print(unsigned long long value, int base = 10);
+    size_t print(double value, int decimals = 2);
+    size_t print(const Printable& value);
+    
+    size_t println();
+    template <typename T>
+    size_t println(const T& value) {
+        return print(value) + println();
+    }
+    template <typename T>
+    size_t println(const T& value, int format) {
+        return print(value, format) + println();
+    }
+};
+
+#endif // PRINT_H
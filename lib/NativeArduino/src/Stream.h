@@ -0,0 +1,49 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include "Print.h"
+
+// Readable byte stream
+class Stream : public Print {
+protected:
+    unsigned long timeout = 1000;
+
+public:
+    // Bytes that can be read without blocking
+    virtual int available() = 0;
+    
+    // Read one byte, -1 if none
+    virtual int read() = 0;
+    
+    // Next byte without consuming it, -1 if none
+    virtual int peek() = 0;
+    
+    // Read up to length bytes, returns the number read
+    virtual size_t readBytes(char* buffer, size_t length) {
+        size_t count = 0;
+        while (count < length) {
+            int c = read();
+            if (c < 0) {
+                break;
+            }
+            buffer[count++] = (char)c;
+        }
+        return count;
+    }
+    
+    size_t readBytes(uint8_t* buffer, size_t length) { return readBytes((char*)buffer, length); }
+    
+    // Read everything available into a String
+    String readString() {
+        String result;
+        int c;
+        while ((c = read()) >= 0) {
+            result += (char)c;
+        }
+        return result;
+    }
+    
+    void setTimeout(unsigned long timeout) { this->timeout = timeout; }
+};
+
+#endif // STREAM_H
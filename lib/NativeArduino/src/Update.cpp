@@ -0,0 +1,69 @@
+#include "Update.h"
+
+// First byte of an ESP32 application image
+static const uint8_t ESP_IMAGE_MAGIC = 0xE9;
+
+// Global update instance
+UpdateClass Update;
+
+// Start an update of a known or unknown size
+bool UpdateClass::begin(size_t size, int command, int ledPin, uint8_t ledOn, const char* label) {
+    if (running) {
+        error = "Already Running";
+        return false;
+    }
+    if (command != U_FLASH) {
+        error = "Bad Argument";
+        return false;
+    }
+    
+    this->size = size;
+    this->error = nullptr;
+    this->buffer.clear();
+    this->running = true;
+    return true;
+}
+
+// Append image bytes
+size_t UpdateClass::write(uint8_t* data, size_t len) {
+    if (!running || error != nullptr) {
+        return 0;
+    }
+    if (size != UPDATE_SIZE_UNKNOWN && buffer.size() + len > size) {
+        error = "Not Enough Space";
+        return 0;
+    }
+    
+    buffer.insert(buffer.end(), data, data + len);
+    return len;
+}
+
+// Check the image and activate it
+bool UpdateClass::end(bool evenIfRemaining) {
+    if (!running || error != nullptr) {
+        return false;
+    }
+    running = false;
+    
+    if (!evenIfRemaining && size != UPDATE_SIZE_UNKNOWN && buffer.size() != size) {
+        error = "Bad Size Given";
+        return false;
+    }
+    if (buffer.empty() || buffer[0] != ESP_IMAGE_MAGIC) {
+        error = "Magic Failed";
+        return false;
+    }
+    
+    activated = buffer;
+    buffer.clear();
+    return true;
+}
+
+// Drop the update
+void UpdateClass::abort() {
+    if (running) {
+        error = "Aborted";
+    }
+    running = false;
+    buffer.clear();
+}
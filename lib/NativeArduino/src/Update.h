@@ -0,0 +1,38 @@
+#ifndef NATIVE_UPDATE_H
+#define NATIVE_UPDATE_H
+
+// Firmware update writer: the image is kept in memory instead of an OTA
+// partition, and end() checks it the way the core does (size, image magic)
+
+#include "Arduino.h"
+#include <vector>
+
+#define UPDATE_SIZE_UNKNOWN 0xFFFFFFFF
+
+#define U_FLASH 0
+#define U_SPIFFS 100
+
+class UpdateClass {
+private:
+    bool running = false;
+    size_t size = 0;                // Expected image size, UPDATE_SIZE_UNKNOWN if not known
+    const char* error = nullptr;
+    std::vector<uint8_t> buffer;    // Image of the update being written
+    std::vector<uint8_t> activated; // Image of the last update that ended
+
+public:
+    bool begin(size_t size = UPDATE_SIZE_UNKNOWN, int command = U_FLASH, int ledPin = -1, uint8_t ledOn = LOW, const char* label = NULL);
+    size_t write(uint8_t* data, size_t len);
+    bool end(bool evenIfRemaining = false);
+    void abort();
+    bool isRunning() { return running; }
+    bool hasError() { return error != nullptr; }
+    const char* errorString() { return error != nullptr ? error : "No Error"; }
+    
+    // Host-only: the image activated by the last successful end(), empty if none
+    const std::vector<uint8_t>& activatedImage() const { return activated; }
+};
+
+extern UpdateClass Update;
+
+#endif // NATIVE_UPDATE_H
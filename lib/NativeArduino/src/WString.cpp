@@ -0,0 +1,349 @@
+#include "WString.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <algorithm>
+
+// Format an integer in the given base (2-36)
+static std::string formatInteger(unsigned long long value, bool negative, unsigned char base) {
+    if (base < 2 || base > 36) {
+        base = 10;
+    }
+    
+    std::string digits;
+    do {
+        int digit = value % base;
+        digits += (char)(digit < 10 ? '0' + digit : 'a' + digit - 10);
+        value /= base;
+    } while (value > 0);
+    
+    if (negative) {
+        digits += '-';
+    }
+    std::reverse(digits.begin(), digits.end());
+    return digits;
+}
+
+// Format a floating point number with a fixed number of decimals
+static std::string formatDecimal(double value, unsigned int decimals) {
+    char text[64];
+    snprintf(text, sizeof(text), "%.*f", decimals, value);
+    return text;
+}
+
+// Constructors
+String::String(const char* str) : buffer(str != nullptr ? str : "") {}
+String::String(char c) : buffer(1, c) {}
+String::String(unsigned char value, unsigned char base) : buffer(formatInteger(value, false, base)) {}
+String::String(unsigned int value, unsigned char base) : buffer(formatInteger(value, false, base)) {}
+String::String(unsigned long value, unsigned char base) : buffer(formatInteger(value, false, base)) {}
+String::String(unsigned long long value, unsigned char base) : buffer(formatInteger(value, false, base)) {}
+String::String(float value, unsigned int decimals) : buffer(formatDecimal(value, decimals)) {}
+String::String(double value, unsigned int decimals) : buffer(formatDecimal(value, decimals)) {}
+
+// Negative numbers are only written with a sign in base 10 (as on Arduino)
+String::String(int value, unsigned char base)
+    : buffer(base == 10 ? formatInteger(value < 0 ? -(long long)value : value, value < 0, 10) : formatInteger((unsigned int)value, false, base)) {}
+String::String(long value, unsigned char base)
+    : buffer(base == 10 ? formatInteger(value < 0 ? -(long long)value : value, value < 0, 10) : formatInteger((unsigned long)value, false, base)) {}
+String::String(long long value, unsigned char base)
+    : buffer(base == 10 ? formatInteger(value < 0 ? -(unsigned long long)value : value, value < 0, 10) : formatInteger((unsigned long long)value, false, base)) {}
+
+// Assign a C string
+String& String::operator=(const char* str) {
+    buffer = str != nullptr ? str : "";
+    return *this;
+}
+
+// Character at an index, 0 if out of range
+char String::charAt(unsigned int index) const {
+    return index < buffer.length() ? buffer[index] : 0;
+}
+
+// Replace the character at an index (ignored if out of range)
+void String::setCharAt(unsigned int index, char c) {
+    if (index < buffer.length()) {
+        buffer[index] = c;
+    }
+}
+
+// Character at an index, 0 if out of range
+char String::operator[](unsigned int index) const {
+    return charAt(index);
+}
+
+// Writable character at an index
+char& String::operator[](unsigned int index) {
+    static char dummy;
+    if (index >= buffer.length()) {
+        dummy = 0;
+        return dummy;
+    }
+    return buffer[index];
+}
+
+// Reserve capacity
+bool String::reserve(unsigned int size) {
+    buffer.reserve(size);
+    return true;
+}
+
+// Append a string
+bool String::concat(const String& str) {
+    buffer += str.buffer;
+    return true;
+}
+
+// Append a C string
+bool String::concat(const char* str) {
+    if (str == nullptr) {
+        return false;
+    }
+    buffer += str;
+    return true;
+}
+
+// Append the first characters of a C string
+bool String::concat(const char* str, unsigned int length) {
+    if (str == nullptr) {
+        return false;
+    }
+    buffer.append(str, length);
+    return true;
+}
+
+// Append a character
+bool String::concat(char c) {
+    buffer += c;
+    return true;
+}
+
+// Append a number
+bool String::concat(int value) {
+    return concat(String(value));
+}
+
+bool String::concat(unsigned int value) {
+    return concat(String(value));
+}
+
+bool String::concat(long value) {
+    return concat(String(value));
+}
+
+bool String::concat(unsigned long value) {
+    return concat(String(value));
+}
+
+bool String::concat(double value) {
+    return concat(String(value));
+}
+
+// Compare (like strcmp)
+int String::compareTo(const String& str) const {
+    return buffer.compare(str.buffer);
+}
+
+// Check for equality
+bool String::equals(const String& str) const {
+    return buffer == str.buffer;
+}
+
+bool String::equals(const char* str) const {
+    return buffer == (str != nullptr ? str : "");
+}
+
+// Check for equality ignoring case
+bool String::equalsIgnoreCase(const String& str) const {
+    return buffer.length() == str.buffer.length() && strcasecmp(buffer.c_str(), str.buffer.c_str()) == 0;
+}
+
+// Check the start of the string
+bool String::startsWith(const String& prefix) const {
+    return startsWith(prefix, 0);
+}
+
+bool String::startsWith(const String& prefix, unsigned int offset) const {
+    return offset <= buffer.length() && buffer.compare(offset, prefix.buffer.length(), prefix.buffer) == 0;
+}
+
+// Check the end of the string
+bool String::endsWith(const String& suffix) const {
+    return suffix.buffer.length() <= buffer.length() &&
+           buffer.compare(buffer.length() - suffix.buffer.length(), suffix.buffer.length(), suffix.buffer) == 0;
+}
+
+// Position of a character, -1 if not found
+int String::indexOf(char c, unsigned int from) const {
+    size_t position = buffer.find(c, from);
+    return position == std::string::npos ? -1 : (int)position;
+}
+
+// Position of a substring, -1 if not found
+int String::indexOf(const String& str, unsigned int from) const {
+    size_t position = buffer.find(str.buffer, from);
+    return position == std::string::npos ? -1 : (int)position;
+}
+
+// Last position of a character, -1 if not found
+int String::lastIndexOf(char c) const {
+    size_t position = buffer.rfind(c);
+    return position == std::string::npos ? -1 : (int)position;
+}
+
+// Last position of a substring, -1 if not found
+int String::lastIndexOf(const String& str) const {
+    size_t position = buffer.rfind(str.buffer);
+    return position == std::string::npos ? -1 : (int)position;
+}
+
+// Characters from an index to the end
+String String::substring(unsigned int from) const {
+    return substring(from, buffer.length());
+}
+
+// Characters between two indexes (swapped if reversed, as on Arduino)
+String String::substring(unsigned int from, unsigned int to) const {
+    if (from > to) {
+        std::swap(from, to);
+    }
+    if (from >= buffer.length()) {
+        return String();
+    }
+    to = std::min<unsigned int>(to, buffer.length());
+    return String(buffer.substr(from, to - from).c_str());
+}
+
+// Replace every occurrence of a character
+void String::replace(char find, char replace) {
+    std::replace(buffer.begin(), buffer.end(), find, replace);
+}
+
+// Replace every occurrence of a substring
+void String::replace(const String& find, const String& replace) {
+    if (find.buffer.empty()) {
+        return;
+    }
+    
+    size_t position = 0;
+    while ((position = buffer.find(find.buffer, position)) != std::string::npos) {
+        buffer.replace(position, find.buffer.length(), replace.buffer);
+        position += replace.buffer.length();
+    }
+}
+
+// Remove everything from an index
+void String::remove(unsigned int index) {
+    if (index < buffer.length()) {
+        buffer.erase(index);
+    }
+}
+
+// Remove a number of characters from an index
+void String::remove(unsigned int index, unsigned int count) {
+    if (index < buffer.length()) {
+        buffer.erase(index, count);
+    }
+}
+
+// Convert to lower case
+void String::toLowerCase() {
+    for (char& c : buffer) {
+        c = tolower((unsigned char)c);
+    }
+}
+
+// Convert to upper case
+void String::toUpperCase() {
+    for (char& c : buffer) {
+        c = toupper((unsigned char)c);
+    }
+}
+
+// Remove leading and trailing whitespace
+void String::trim() {
+    size_t start = 0;
+    while (start < buffer.length() && isspace((unsigned char)buffer[start])) {
+        start++;
+    }
+    
+    size_t end = buffer.length();
+    while (end > start && isspace((unsigned char)buffer[end - 1])) {
+        end--;
+    }
+    
+    buffer = buffer.substr(start, end - start);
+}
+
+// Parse a leading integer, 0 if none
+long String::toInt() const {
+    return strtol(buffer.c_str(), nullptr, 10);
+}
+
+// Parse a leading number, 0 if none
+float String::toFloat() const {
+    return strtof(buffer.c_str(), nullptr);
+}
+
+double String::toDouble() const {
+    return strtod(buffer.c_str(), nullptr);
+}
+
+// Concatenation
+StringSumHelper operator+(const String& lhs, const String& rhs) {
+    StringSumHelper sum(lhs);
+    sum.concat(rhs);
+    return sum;
+}
+
+StringSumHelper operator+(const String& lhs, const char* rhs) {
+    StringSumHelper sum(lhs);
+    sum.concat(rhs);
+    return sum;
+}
+
+StringSumHelper operator+(const char* lhs, const String& rhs) {
+    StringSumHelper sum(lhs);
+    sum.concat(rhs);
+    return sum;
+}
+
+StringSumHelper operator+(const String& lhs, char rhs) {
+    StringSumHelper sum(lhs);
+    sum.concat(rhs);
+    return sum;
+}
+
+StringSumHelper operator+(const String& lhs, int rhs) {
+    StringSumHelper sum(lhs);
+    sum.concat(rhs);
+    return sum;
+}
+
+StringSumHelper operator+(const String& lhs, unsigned int rhs) {
+    StringSumHelper sum(lhs);
+    sum.concat(rhs);
+    return sum;
+}
+
+StringSumHelper operator+(const String& lhs, long rhs) {
+    StringSumHelper sum(lhs);
+    sum.concat(rhs);
+    return sum;
+}
+
+StringSumHelper operator+(const String& lhs, unsigned long rhs) {
+    StringSumHelper sum(lhs);
+    sum.concat(rhs);
+    return sum;
+}
+
+// Compare a C string with a String
+bool operator==(const char* lhs, const String& rhs) {
+    return rhs.equals(lhs);
+}
+
+bool operator!=(const char* lhs, const String& rhs) {
+    return !rhs.equals(lhs);
+}
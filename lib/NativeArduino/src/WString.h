@@ -0,0 +1,118 @@
+#ifndef WSTRING_H
+#define WSTRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+class StringSumHelper;
+
+// Arduino String on top of std::string
+class String {
+protected:
+    std::string buffer;
+
+public:
+    String(const char* str = "");
+    String(const String& str) = default;
+    String(String&& str) = default;
+    explicit String(char c);
+    explicit String(unsigned char value, unsigned char base = 10);
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    explicit String(long long value, unsigned char base = 10);
+    explicit String(unsigned long long value, unsigned char base = 10);
+    explicit String(float value, unsigned int decimals = 2);
+    explicit String(double value, unsigned int decimals = 2);
+    
+    String& operator=(const String& str) = default;
+    String& operator=(String&& str) = default;
+    String& operator=(const char* str);
+    
+    // Size and access
+    unsigned int length() const { return buffer.length(); }
+    bool isEmpty() const { return buffer.empty(); }
+    const char* c_str() const { return buffer.c_str(); }
+    char charAt(unsigned int index) const;
+    void setCharAt(unsigned int index, char c);
+    char operator[](unsigned int index) const;
+    char& operator[](unsigned int index);
+    bool reserve(unsigned int size);
+    
+    // Appending
+    bool concat(const String& str);
+    bool concat(const char* str);
+    bool concat(const char* str, unsigned int length);
+    bool concat(char c);
+    bool concat(int value);
+    bool concat(unsigned int value);
+    bool concat(long value);
+    bool concat(unsigned long value);
+    bool concat(double value);
+    template <typename T>
+    String& operator+=(const T& value) {
+        concat(value);
+        return *this;
+    }
+    
+    // Comparison
+    int compareTo(const String& str) const;
+    bool equals(const String& str) const;
+    bool equals(const char* str) const;
+    bool equalsIgnoreCase(const String& str) const;
+    bool startsWith(const String& prefix) const;
+    bool startsWith(const String& prefix, unsigned int offset) const;
+    bool endsWith(const String& suffix) const;
+    bool operator==(const String& str) const { return equals(str); }
+    bool operator==(const char* str) const { return equals(str); }
+    bool operator!=(const String& str) const { return !equals(str); }
+    bool operator!=(const char* str) const { return !equals(str); }
+    bool operator<(const String& str) const { return compareTo(str) < 0; }
+    bool operator>(const String& str) const { return compareTo(str) > 0; }
+    bool operator<=(const String& str) const { return compareTo(str) <= 0; }
+    bool operator>=(const String& str) const { return compareTo(str) >= 0; }
+    
+    // Searching
+    int indexOf(char c, unsigned int from = 0) const;
+    int indexOf(const String& str, unsigned int from = 0) const;
+    int lastIndexOf(char c) const;
+    int lastIndexOf(const String& str) const;
+    String substring(unsigned int from) const;
+    String substring(unsigned int from, unsigned int to) const;
+    
+    // Modification
+    void replace(char find, char replace);
+    void replace(const String& find, const String& replace);
+    void remove(unsigned int index);
+    void remove(unsigned int index, unsigned int count);
+    void toLowerCase();
+    void toUpperCase();
+    void trim();
+    
+    // Conversion
+    long toInt() const;
+    float toFloat() const;
+    double toDouble() const;
+};
+
+// Result of String concatenation with operator+
+class StringSumHelper : public String {
+public:
+    StringSumHelper(const String& str) : String(str) {}
+    StringSumHelper(const char* str) : String(str) {}
+};
+
+StringSumHelper operator+(const String& lhs, const String& rhs);
+StringSumHelper operator+(const String& lhs, const char* rhs);
+StringSumHelper operator+(const char* lhs, const String& rhs);
+StringSumHelper operator+(const String& lhs, char rhs);
+StringSumHelper operator+(const String& lhs, int rhs);
+StringSumHelper operator+(const String& lhs, unsigned int rhs);
+StringSumHelper operator+(const String& lhs, long rhs);
+StringSumHelper operator+(const String& lhs, unsigned long rhs);
+bool operator==(const char* lhs, const String& rhs);
+bool operator!=(const char* lhs, const String& rhs);
+
+#endif // WSTRING_H
@@ -0,0 +1,29 @@
+#include "WiFi.h"
+#include "ESPmDNS.h"
+#include <stdio.h>
+
+WiFiClass WiFi;
+MDNSResponder MDNS;
+
+String IPAddress::toString() const {
+    char text[16];
+    snprintf(text, sizeof(text), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+    return String(text);
+}
+
+bool IPAddress::fromString(const char* text) {
+    unsigned int a, b, c, d;
+    char extra;
+    if (sscanf(text, "%u.%u.%u.%u%c", &a, &b, &c, &d, &extra) != 4 || a > 255 || b > 255 || c > 255 || d > 255) {
+        return false;
+    }
+    *this = IPAddress(a, b, c, d);
+    return true;
+}
+
+void WiFiClass::setConnected(bool connected, const String& ssid, IPAddress ip, int8_t rssi) {
+    this->connected = connected;
+    this->ssid = ssid;
+    this->ip = ip;
+    this->rssi = rssi;
+}
@@ -0,0 +1,65 @@
+#ifndef NATIVE_WIFI_H
+#define NATIVE_WIFI_H
+
+// Host stand-in for the WiFi library: the station reports as disconnected
+// until a test calls WiFi.setConnected()
+
+#include <Arduino.h>
+
+typedef const char* esp_event_base_t;
+
+typedef enum {
+    WL_NO_SHIELD = 255,
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_SCAN_COMPLETED = 2,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_CONNECTION_LOST = 5,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+class IPAddress : public Printable {
+public:
+    IPAddress() : address(0) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : address(a | (b << 8) | (c << 16) | ((uint32_t)d << 24)) {}
+    IPAddress(uint32_t address) : address(address) {}
+    
+    operator uint32_t() const { return address; }
+    uint8_t operator[](int index) const { return (address >> (index * 8)) & 0xFF; }
+    bool operator==(const IPAddress& other) const { return address == other.address; }
+    bool operator!=(const IPAddress& other) const { return address != other.address; }
+    
+    String toString() const;
+    bool fromString(const char* text);
+    size_t printTo(Print& out) const override { return out.print(toString()); }
+
+private:
+    uint32_t address;       // Network byte order, as on the ESP32
+};
+
+class WiFiClass {
+public:
+    wl_status_t status() const { return connected ? WL_CONNECTED : WL_DISCONNECTED; }
+    bool isConnected() const { return connected; }
+    String SSID() const { return connected ? ssid : String(); }
+    int8_t RSSI() const { return connected ? rssi : 0; }
+    IPAddress localIP() const { return connected ? ip : IPAddress(); }
+    String macAddress() const { return "AA:BB:CC:DD:EE:FF"; }
+    const char* getHostname() const { return hostname.c_str(); }
+    bool setHostname(const char* name) { hostname = name; return true; }
+    
+    // Host-only: simulate a station connection (or its loss)
+    void setConnected(bool connected, const String& ssid = "native", IPAddress ip = IPAddress(127, 0, 0, 1), int8_t rssi = -50);
+
+private:
+    bool connected = false;
+    String ssid;
+    String hostname = "esp32";
+    IPAddress ip;
+    int8_t rssi = 0;
+};
+
+extern WiFiClass WiFi;
+
+#endif // NATIVE_WIFI_H
@@ -0,0 +1,97 @@
+#include "ledc.h"
+#include <mutex>
+
+// Channel state for both speed modes
+struct LedcChannelState {
+    bool configured = false;
+    int gpio = -1;
+    uint32_t duty = 0;          // Duty on the output
+    uint32_t pendingDuty = 0;   // Set, waiting for ledc_update_duty() or ledc_fade_start()
+};
+
+static std::mutex ledcLock;
+static LedcChannelState ledcChannels[LEDC_SPEED_MODE_MAX][LEDC_CHANNEL_MAX];
+
+// Check a mode and channel pair
+static bool validChannel(ledc_mode_t speedMode, ledc_channel_t channel) {
+    return speedMode >= 0 && speedMode < LEDC_SPEED_MODE_MAX && channel >= 0 && channel < LEDC_CHANNEL_MAX;
+}
+
+esp_err_t ledc_timer_config(const ledc_timer_config_t* config) {
+    if (config == nullptr || config->timer_num >= LEDC_TIMER_MAX || config->freq_hz == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+esp_err_t ledc_channel_config(const ledc_channel_config_t* config) {
+    if (config == nullptr || !validChannel(config->speed_mode, config->channel)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    std::lock_guard<std::mutex> guard(ledcLock);
+    LedcChannelState& state = ledcChannels[config->speed_mode][config->channel];
+    state.configured = true;
+    state.gpio = config->gpio_num;
+    state.duty = config->duty;
+    state.pendingDuty = config->duty;
+    return ESP_OK;
+}
+
+esp_err_t ledc_fade_func_install(int intrAllocFlags) {
+    return ESP_OK;
+}
+
+void ledc_fade_func_uninstall() {
+}
+
+esp_err_t ledc_set_duty(ledc_mode_t speedMode, ledc_channel_t channel, uint32_t duty) {
+    if (!validChannel(speedMode, channel)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    std::lock_guard<std::mutex> guard(ledcLock);
+    ledcChannels[speedMode][channel].pendingDuty = duty;
+    return ESP_OK;
+}
+
+esp_err_t ledc_update_duty(ledc_mode_t speedMode, ledc_channel_t channel) {
+    if (!validChannel(speedMode, channel)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    std::lock_guard<std::mutex> guard(ledcLock);
+    LedcChannelState& state = ledcChannels[speedMode][channel];
+    state.duty = state.pendingDuty;
+    return ESP_OK;
+}
+
+uint32_t ledc_get_duty(ledc_mode_t speedMode, ledc_channel_t channel) {
+    if (!validChannel(speedMode, channel)) {
+        return 0;
+    }
+    
+    std::lock_guard<std::mutex> guard(ledcLock);
+    return ledcChannels[speedMode][channel].duty;
+}
+
+esp_err_t ledc_set_fade_with_time(ledc_mode_t speedMode, ledc_channel_t channel, uint32_t targetDuty, int maxFadeTimeMs) {
+    return ledc_set_duty(speedMode, channel, targetDuty);
+}
+
+esp_err_t ledc_fade_start(ledc_mode_t speedMode, ledc_channel_t channel, ledc_fade_mode_t fadeMode) {
+    return ledc_update_duty(speedMode, channel);
+}
+
+esp_err_t ledc_stop(ledc_mode_t speedMode, ledc_channel_t channel, uint32_t idleLevel) {
+    if (!validChannel(speedMode, channel)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    std::lock_guard<std::mutex> guard(ledcLock);
+    LedcChannelState& state = ledcChannels[speedMode][channel];
+    state.configured = false;
+    state.duty = 0;
+    state.pendingDuty = 0;
+    return ESP_OK;
+}
@@ -0,0 +1,42 @@
+#ifndef NATIVE_ESP32_ROM_MINIZ_H
+#define NATIVE_ESP32_ROM_MINIZ_H
+
+// The ROM inflater's interface. The host has no ROM, so tinfl_decompress()
+// rejects every stream: compressed uploads fail cleanly, raw ones are unaffected
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TINFL_LZ_DICT_SIZE 32768
+
+enum {
+    TINFL_FLAG_PARSE_ZLIB_HEADER = 1,
+    TINFL_FLAG_HAS_MORE_INPUT = 2,
+    TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF = 4,
+    TINFL_FLAG_COMPUTE_ADLER32 = 8
+};
+
+typedef enum {
+    TINFL_STATUS_BAD_PARAM = -3,
+    TINFL_STATUS_ADLER32_MISMATCH = -2,
+    TINFL_STATUS_FAILED = -1,
+    TINFL_STATUS_DONE = 0,
+    TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+    TINFL_STATUS_HAS_MORE_OUTPUT = 2
+} tinfl_status;
+
+typedef struct {
+    uint32_t m_state;
+} tinfl_decompressor;
+
+#define tinfl_init(r) do { (r)->m_state = 0; } while (0)
+
+inline tinfl_status tinfl_decompress(tinfl_decompressor* r, const uint8_t* pIn_buf_next, size_t* pIn_buf_size,
+                                     uint8_t* pOut_buf_start, uint8_t* pOut_buf_next, size_t* pOut_buf_size,
+                                     const uint32_t decomp_flags) {
+    *pIn_buf_size = 0;
+    *pOut_buf_size = 0;
+    return TINFL_STATUS_FAILED;
+}
+
+#endif // NATIVE_ESP32_ROM_MINIZ_H
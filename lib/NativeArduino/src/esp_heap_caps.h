@@ -0,0 +1,25 @@
+#ifndef NATIVE_ESP_HEAP_CAPS_H
+#define NATIVE_ESP_HEAP_CAPS_H
+
+// Heap capability queries, reporting the same fixed figures as ESP
+// (the host heap is not tracked)
+
+#include <Arduino.h>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_DEFAULT (1 << 12)
+
+inline size_t heap_caps_get_free_size(uint32_t caps) {
+    return ESP.getFreeHeap();
+}
+
+inline size_t heap_caps_get_minimum_free_size(uint32_t caps) {
+    return ESP.getMinFreeHeap();
+}
+
+inline size_t heap_caps_get_largest_free_block(uint32_t caps) {
+    return ESP.getMaxAllocHeap();
+}
+
+#endif // NATIVE_ESP_HEAP_CAPS_H
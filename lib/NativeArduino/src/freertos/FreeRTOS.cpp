@@ -0,0 +1,636 @@
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "event_groups.h"
+#include "timers.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+unsigned long millis();
+
+typedef std::chrono::steady_clock Clock;
+
+// A task: one host thread with its notification count
+struct NativeTask {
+    std::string name;
+    UBaseType_t priority = 1;
+    uint32_t stackDepth = 8192;
+    UBaseType_t number = 0;
+    pthread_t thread;
+    bool created = false;                   // Created by xTaskCreate (not a foreign thread)
+    std::mutex lock;
+    std::condition_variable wake;
+    uint32_t notifications = 0;
+    std::atomic<bool> blocked{false};
+    std::atomic<bool> deleted{false};
+};
+
+struct NativeSemaphore {
+    std::mutex lock;
+    std::condition_variable available;
+    UBaseType_t count = 0;
+    UBaseType_t maxCount = 1;
+    bool isMutex = false;
+    NativeTask* holder = nullptr;
+    UBaseType_t depth = 0;                  // Recursive mutex nesting
+};
+
+struct NativeEventGroup {
+    std::mutex lock;
+    std::condition_variable changed;
+    EventBits_t bits = 0;
+};
+
+struct NativeTimer {
+    std::string name;
+    TickType_t period;
+    bool autoReload;
+    void* id;
+    TimerCallbackFunction_t callback;
+    bool active = false;
+    Clock::time_point deadline;
+};
+
+// Thrown into a deleted task to unwind its thread
+struct NativeTaskDeleted {};
+
+// Registry of live tasks (never destroyed, so exiting can't race the threads)
+static std::mutex& registryLock() {
+    static std::mutex* lock = new std::mutex();
+    return *lock;
+}
+
+static std::vector<NativeTask*>& registry() {
+    static std::vector<NativeTask*>* tasks = new std::vector<NativeTask*>();
+    return *tasks;
+}
+
+static thread_local NativeTask* currentTask = nullptr;
+static std::atomic<UBaseType_t> nextTaskNumber(1);
+static std::atomic<bool> shuttingDown(false);
+static const Clock::time_point runTimeOrigin = Clock::now();
+
+// Add a task to the registry
+static void registerTask(NativeTask* task) {
+    task->number = nextTaskNumber++;
+    std::lock_guard<std::mutex> guard(registryLock());
+    registry().push_back(task);
+}
+
+// Remove a task from the registry
+static void unregisterTask(NativeTask* task) {
+    std::lock_guard<std::mutex> guard(registryLock());
+    auto& tasks = registry();
+    tasks.erase(std::remove(tasks.begin(), tasks.end(), task), tasks.end());
+}
+
+// The calling task, registering threads that weren't created as tasks
+static NativeTask* self() {
+    if (currentTask == nullptr) {
+        NativeTask* task = new NativeTask();
+        {
+            std::lock_guard<std::mutex> guard(registryLock());
+            task->name = registry().empty() ? "loopTask" : "thread" + std::to_string(nextTaskNumber.load());
+        }
+        task->thread = pthread_self();
+        registerTask(task);
+        currentTask = task;
+    }
+    return currentTask;
+}
+
+// At exit, let running tasks reach a blocking call and keep them there,
+// so they don't touch globals while static destructors run
+static void stopTasks() {
+    shuttingDown = true;
+    
+    Clock::time_point giveUp = Clock::now() + std::chrono::seconds(1);
+    while (Clock::now() < giveUp) {
+        bool allBlocked = true;
+        {
+            std::lock_guard<std::mutex> guard(registryLock());
+            for (NativeTask* task : registry()) {
+                if (task->created && task != currentTask && !task->blocked) {
+                    allBlocked = false;
+                }
+            }
+        }
+        if (allBlocked) {
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+// Deadline for a wait in ticks (milliseconds)
+static Clock::time_point deadlineAfter(TickType_t ticks) {
+    return ticks == portMAX_DELAY ? Clock::time_point::max() : Clock::now() + std::chrono::milliseconds(ticks);
+}
+
+// Block the calling task until ready() or the deadline; returns ready().
+// Deleted tasks unwind from here, and after exit starts tasks stay blocked.
+template <typename Predicate>
+static bool blockUntil(std::unique_lock<std::mutex>& guard, std::condition_variable& condition, Clock::time_point deadline, Predicate ready) {
+    NativeTask* task = self();
+    task->blocked = true;
+    
+    bool result;
+    for (;;) {
+        if (shuttingDown && task->created) {
+            condition.wait(guard);
+            continue;
+        }
+        if (task->deleted) {
+            task->blocked = false;
+            guard.unlock();
+            throw NativeTaskDeleted();
+        }
+        if (ready()) {
+            result = true;
+            break;
+        }
+        if (deadline == Clock::time_point::max()) {
+            condition.wait_for(guard, std::chrono::milliseconds(100));
+        } else if (condition.wait_until(guard, std::min(deadline, Clock::now() + std::chrono::milliseconds(100))) == std::cv_status::timeout &&
+                   Clock::now() >= deadline) {
+            result = ready();
+            break;
+        }
+    }
+    
+    // Exit may have started while this task was waking up
+    task->blocked = false;
+    if (shuttingDown && task->created) {
+        task->blocked = true;
+        for (;;) {
+            condition.wait(guard);
+        }
+    }
+    return result;
+}
+
+// One lock for every critical section, as tasks may nest them
+static std::recursive_mutex& criticalLock() {
+    static std::recursive_mutex* lock = new std::recursive_mutex();
+    return *lock;
+}
+
+void vNativeEnterCritical(portMUX_TYPE* mux) {
+    criticalLock().lock();
+    mux->count++;
+}
+
+void vNativeExitCritical(portMUX_TYPE* mux) {
+    mux->count--;
+    criticalLock().unlock();
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stackDepth, void* parameter,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t coreId) {
+    static std::once_flag exitHook;
+    std::call_once(exitHook, []() { atexit(stopTasks); });
+    
+    NativeTask* task = new NativeTask();
+    task->name = std::string(name != nullptr ? name : "").substr(0, configMAX_TASK_NAME_LEN - 1);
+    task->priority = priority;
+    task->stackDepth = stackDepth;
+    task->created = true;
+    task->number = nextTaskNumber++;
+    
+    // Registered under the lock the thread needs to unregister, so the
+    // handle is set before anyone can read it or the thread can end
+    {
+        std::lock_guard<std::mutex> guard(registryLock());
+        std::thread thread([task, function, parameter]() {
+            currentTask = task;
+            try {
+                function(parameter);
+            } catch (const NativeTaskDeleted&) {
+            }
+            unregisterTask(task);
+        });
+        task->thread = thread.native_handle();
+        thread.detach();
+        registry().push_back(task);
+    }
+    
+    if (handle != nullptr) {
+        *handle = task;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stackDepth, void* parameter,
+                       UBaseType_t priority, TaskHandle_t* handle) {
+    return xTaskCreatePinnedToCore(function, name, stackDepth, parameter, priority, handle, tskNO_AFFINITY);
+}
+
+// Delete a task (null = the calling task); another task stops at its next blocking call
+void vTaskDelete(TaskHandle_t task) {
+    NativeTask* target = task != nullptr ? task : self();
+    unregisterTask(target);
+    target->deleted = true;
+    target->wake.notify_all();
+    
+    if (target == currentTask) {
+        if (!target->created) {
+            // A foreign thread can't be unwound, so it stays here
+            std::unique_lock<std::mutex> guard(target->lock);
+            for (;;) {
+                target->wake.wait(guard);
+            }
+        }
+        throw NativeTaskDeleted();
+    }
+}
+
+void vTaskDelay(TickType_t ticks) {
+    NativeTask* task = self();
+    std::unique_lock<std::mutex> guard(task->lock);
+    blockUntil(guard, task->wake, deadlineAfter(ticks), []() { return false; });
+}
+
+void vTaskDelayUntil(TickType_t* previousWakeTime, TickType_t increment) {
+    *previousWakeTime += increment;
+    TickType_t remaining = *previousWakeTime - xTaskGetTickCount();
+    if ((int32_t)remaining > 0) {
+        vTaskDelay(remaining);
+    }
+}
+
+TickType_t xTaskGetTickCount() {
+    return (TickType_t)(millis() * configTICK_RATE_HZ / 1000);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    return self();
+}
+
+TaskHandle_t xTaskGetHandle(const char* name) {
+    std::lock_guard<std::mutex> guard(registryLock());
+    for (NativeTask* task : registry()) {
+        if (task->name == name) {
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+char* pcTaskGetName(TaskHandle_t task) {
+    NativeTask* target = task != nullptr ? task : self();
+    return const_cast<char*>(target->name.c_str());
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task) {
+    return (task != nullptr ? task : self())->priority;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    return (task != nullptr ? task : self())->stackDepth;
+}
+
+UBaseType_t uxTaskGetNumberOfTasks() {
+    std::lock_guard<std::mutex> guard(registryLock());
+    return registry().size();
+}
+
+// CPU time of a task's thread in microseconds
+static uint32_t taskRunTime(NativeTask* task) {
+    clockid_t clock;
+    struct timespec time;
+    if (pthread_getcpuclockid(task->thread, &clock) != 0 || clock_gettime(clock, &time) != 0) {
+        return 0;
+    }
+    return (uint32_t)((uint64_t)time.tv_sec * 1000000 + time.tv_nsec / 1000);
+}
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t* statusArray, UBaseType_t arraySize, uint32_t* totalRunTime) {
+    std::lock_guard<std::mutex> guard(registryLock());
+    if (registry().size() > arraySize) {
+        return 0;
+    }
+    
+    UBaseType_t count = 0;
+    for (NativeTask* task : registry()) {
+        TaskStatus_t& status = statusArray[count++];
+        status.xHandle = task;
+        status.pcTaskName = task->name.c_str();
+        status.xTaskNumber = task->number;
+        status.eCurrentState = task == currentTask ? eRunning : (task->blocked ? eBlocked : eReady);
+        status.uxCurrentPriority = task->priority;
+        status.uxBasePriority = task->priority;
+        status.ulRunTimeCounter = taskRunTime(task);
+        status.pxStackBase = nullptr;
+        status.usStackHighWaterMark = task->stackDepth;
+        status.xCoreID = tskNO_AFFINITY;
+    }
+    
+    if (totalRunTime != nullptr) {
+        *totalRunTime = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - runTimeOrigin).count();
+    }
+    return count;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    {
+        std::lock_guard<std::mutex> guard(task->lock);
+        task->notifications++;
+    }
+    task->wake.notify_all();
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higherPriorityTaskWoken) {
+    xTaskNotifyGive(task);
+    if (higherPriorityTaskWoken != nullptr) {
+        *higherPriorityTaskWoken = pdFALSE;
+    }
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait) {
+    NativeTask* task = self();
+    std::unique_lock<std::mutex> guard(task->lock);
+    blockUntil(guard, task->wake, deadlineAfter(ticksToWait), [task]() { return task->notifications > 0; });
+    
+    uint32_t value = task->notifications;
+    if (value > 0) {
+        task->notifications = clearCountOnExit ? 0 : value - 1;
+    }
+    return value;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+    return xSemaphoreCreateCounting(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount) {
+    NativeSemaphore* semaphore = new NativeSemaphore();
+    semaphore->maxCount = maxCount;
+    semaphore->count = initialCount;
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    NativeSemaphore* semaphore = xSemaphoreCreateCounting(1, 1);
+    semaphore->isMutex = true;
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() {
+    return xSemaphoreCreateMutex();
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+    delete semaphore;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait) {
+    std::unique_lock<std::mutex> guard(semaphore->lock);
+    if (!blockUntil(guard, semaphore->available, deadlineAfter(ticksToWait), [semaphore]() { return semaphore->count > 0; })) {
+        return pdFALSE;
+    }
+    
+    semaphore->count--;
+    if (semaphore->isMutex) {
+        semaphore->holder = self();
+        semaphore->depth = 1;
+    }
+    return pdTRUE;
+}
+
+// Waiters are notified under the lock, as a woken taker may delete the semaphore
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    std::lock_guard<std::mutex> guard(semaphore->lock);
+    if (semaphore->isMutex) {
+        // Only the holder can release a mutex
+        if (semaphore->holder != self()) {
+            return pdFALSE;
+        }
+        semaphore->holder = nullptr;
+        semaphore->depth = 0;
+    }
+    if (semaphore->count >= semaphore->maxCount) {
+        return pdFALSE;
+    }
+    semaphore->count++;
+    semaphore->available.notify_one();
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t* higherPriorityTaskWoken) {
+    if (higherPriorityTaskWoken != nullptr) {
+        *higherPriorityTaskWoken = pdFALSE;
+    }
+    return xSemaphoreGive(semaphore);
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t semaphore, TickType_t ticksToWait) {
+    {
+        std::lock_guard<std::mutex> guard(semaphore->lock);
+        if (semaphore->holder == self()) {
+            semaphore->depth++;
+            return pdTRUE;
+        }
+    }
+    return xSemaphoreTake(semaphore, ticksToWait);
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t semaphore) {
+    std::lock_guard<std::mutex> guard(semaphore->lock);
+    if (semaphore->holder != self()) {
+        return pdFALSE;
+    }
+    if (--semaphore->depth > 0) {
+        return pdTRUE;
+    }
+    semaphore->holder = nullptr;
+    semaphore->count = 1;
+    semaphore->available.notify_one();
+    return pdTRUE;
+}
+
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t semaphore) {
+    std::lock_guard<std::mutex> guard(semaphore->lock);
+    return semaphore->count;
+}
+
+EventGroupHandle_t xEventGroupCreate() {
+    return new NativeEventGroup();
+}
+
+void vEventGroupDelete(EventGroupHandle_t group) {
+    delete group;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+    std::lock_guard<std::mutex> guard(group->lock);
+    group->bits |= bits;
+    group->changed.notify_all();
+    return group->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+    std::lock_guard<std::mutex> guard(group->lock);
+    EventBits_t previous = group->bits;
+    group->bits &= ~bits;
+    return previous;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group) {
+    std::lock_guard<std::mutex> guard(group->lock);
+    return group->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clearOnExit,
+                                BaseType_t waitForAllBits, TickType_t ticksToWait) {
+    std::unique_lock<std::mutex> guard(group->lock);
+    auto satisfied = [group, bits, waitForAllBits]() {
+        return waitForAllBits ? (group->bits & bits) == bits : (group->bits & bits) != 0;
+    };
+    
+    bool met = blockUntil(guard, group->changed, deadlineAfter(ticksToWait), satisfied);
+    EventBits_t result = group->bits;
+    if (met && clearOnExit) {
+        group->bits &= ~bits;
+    }
+    return result;
+}
+
+// Timer service state (never destroyed, the service task outlives exit())
+static std::mutex& timerLock() {
+    static std::mutex* lock = new std::mutex();
+    return *lock;
+}
+
+static std::condition_variable& timerChanged() {
+    static std::condition_variable* changed = new std::condition_variable();
+    return *changed;
+}
+
+static std::vector<NativeTimer*>& timers() {
+    static std::vector<NativeTimer*>* list = new std::vector<NativeTimer*>();
+    return *list;
+}
+
+// Bumped on every change so the service task picks up new deadlines
+static uint32_t timerGeneration = 0;
+
+// Wake the service task (call with timerLock() held)
+static void notifyTimerService() {
+    timerGeneration++;
+    timerChanged().notify_all();
+}
+
+// Timer service task: runs callbacks when their deadlines pass
+static void timerServiceTask(void* parameter) {
+    std::unique_lock<std::mutex> guard(timerLock());
+    for (;;) {
+        Clock::time_point next = Clock::time_point::max();
+        for (NativeTimer* timer : timers()) {
+            if (timer->active) {
+                next = std::min(next, timer->deadline);
+            }
+        }
+        
+        uint32_t generation = timerGeneration;
+        blockUntil(guard, timerChanged(), next, [next, generation]() {
+            return timerGeneration != generation || Clock::now() >= next;
+        });
+        
+        // Callbacks run without the lock, so they may use the timer API
+        std::vector<NativeTimer*> expired;
+        Clock::time_point now = Clock::now();
+        for (NativeTimer* timer : timers()) {
+            if (timer->active && timer->deadline <= now) {
+                if (timer->autoReload) {
+                    timer->deadline += std::chrono::milliseconds(timer->period);
+                } else {
+                    timer->active = false;
+                }
+                expired.push_back(timer);
+            }
+        }
+        
+        guard.unlock();
+        for (NativeTimer* timer : expired) {
+            timer->callback(timer);
+        }
+        guard.lock();
+    }
+}
+
+TimerHandle_t xTimerCreate(const char* name, TickType_t period, UBaseType_t autoReload, void* timerId,
+                           TimerCallbackFunction_t callback) {
+    static std::once_flag service;
+    std::call_once(service, []() {
+        xTaskCreate(timerServiceTask, "Tmr Svc", 2048, nullptr, 1, nullptr);
+    });
+    
+    NativeTimer* timer = new NativeTimer();
+    timer->name = name != nullptr ? name : "";
+    timer->period = period;
+    timer->autoReload = autoReload != pdFALSE;
+    timer->id = timerId;
+    timer->callback = callback;
+    
+    std::lock_guard<std::mutex> guard(timerLock());
+    timers().push_back(timer);
+    return timer;
+}
+
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t ticksToWait) {
+    return xTimerReset(timer, ticksToWait);
+}
+
+BaseType_t xTimerReset(TimerHandle_t timer, TickType_t ticksToWait) {
+    std::lock_guard<std::mutex> guard(timerLock());
+    timer->active = true;
+    timer->deadline = Clock::now() + std::chrono::milliseconds(timer->period);
+    notifyTimerService();
+    return pdPASS;
+}
+
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t ticksToWait) {
+    std::lock_guard<std::mutex> guard(timerLock());
+    timer->active = false;
+    notifyTimerService();
+    return pdPASS;
+}
+
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t ticksToWait) {
+    std::lock_guard<std::mutex> guard(timerLock());
+    timer->period = period;
+    timer->active = true;
+    timer->deadline = Clock::now() + std::chrono::milliseconds(period);
+    notifyTimerService();
+    return pdPASS;
+}
+
+// The timer is unlinked but not freed, as the service task may be running its callback
+BaseType_t xTimerDelete(TimerHandle_t timer, TickType_t ticksToWait) {
+    std::lock_guard<std::mutex> guard(timerLock());
+    timer->active = false;
+    auto& list = timers();
+    list.erase(std::remove(list.begin(), list.end(), timer), list.end());
+    notifyTimerService();
+    return pdPASS;
+}
+
+BaseType_t xTimerIsTimerActive(TimerHandle_t timer) {
+    std::lock_guard<std::mutex> guard(timerLock());
+    return timer->active ? pdTRUE : pdFALSE;
+}
+
+void* pvTimerGetTimerID(TimerHandle_t timer) {
+    return timer->id;
+}
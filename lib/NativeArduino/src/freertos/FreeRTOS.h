@@ -0,0 +1,50 @@
+#ifndef NATIVE_FREERTOS_H
+#define NATIVE_FREERTOS_H
+
+// FreeRTOS on host threads: every task is a std::thread, ticks are
+// milliseconds and priorities are recorded but not enforced.
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint32_t StackType_t;
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define pdFAIL pdFALSE
+#define pdPASS pdTRUE
+
+#define configTICK_RATE_HZ 1000
+#define configMAX_PRIORITIES 25
+#define configMAX_TASK_NAME_LEN 16
+#define configGENERATE_RUN_TIME_STATS 1         // Run time is the thread's CPU time in microseconds
+#define configUSE_TRACE_FACILITY 1
+
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+#define tskNO_AFFINITY 0x7FFFFFFF
+
+// Critical sections share one recursive lock
+typedef struct {
+    uint32_t owner;
+    uint32_t count;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {0, 0}
+
+void vNativeEnterCritical(portMUX_TYPE* mux);
+void vNativeExitCritical(portMUX_TYPE* mux);
+
+#define portENTER_CRITICAL(mux) vNativeEnterCritical(mux)
+#define portEXIT_CRITICAL(mux) vNativeExitCritical(mux)
+#define portENTER_CRITICAL_ISR(mux) vNativeEnterCritical(mux)
+#define portEXIT_CRITICAL_ISR(mux) vNativeExitCritical(mux)
+#define taskENTER_CRITICAL(mux) vNativeEnterCritical(mux)
+#define taskEXIT_CRITICAL(mux) vNativeExitCritical(mux)
+#define portYIELD_FROM_ISR(...)
+
+#endif // NATIVE_FREERTOS_H
@@ -0,0 +1,18 @@
+#ifndef NATIVE_FREERTOS_EVENT_GROUPS_H
+#define NATIVE_FREERTOS_EVENT_GROUPS_H
+
+#include "FreeRTOS.h"
+
+struct NativeEventGroup;
+typedef NativeEventGroup* EventGroupHandle_t;
+typedef uint32_t EventBits_t;
+
+EventGroupHandle_t xEventGroupCreate();
+void vEventGroupDelete(EventGroupHandle_t group);
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group);
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clearOnExit,
+                                BaseType_t waitForAllBits, TickType_t ticksToWait);
+
+#endif // NATIVE_FREERTOS_EVENT_GROUPS_H
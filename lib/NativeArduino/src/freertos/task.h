@@ -0,0 +1,63 @@
+#ifndef NATIVE_FREERTOS_TASK_H
+#define NATIVE_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+struct NativeTask;
+typedef NativeTask* TaskHandle_t;
+typedef void (*TaskFunction_t)(void* parameter);
+
+typedef enum {
+    eRunning = 0,
+    eReady,
+    eBlocked,
+    eSuspended,
+    eDeleted,
+    eInvalid
+} eTaskState;
+
+// Task snapshot from uxTaskGetSystemState() (ESP-IDF layout)
+typedef struct {
+    TaskHandle_t xHandle;
+    const char* pcTaskName;
+    UBaseType_t xTaskNumber;
+    eTaskState eCurrentState;
+    UBaseType_t uxCurrentPriority;
+    UBaseType_t uxBasePriority;
+    uint32_t ulRunTimeCounter;
+    StackType_t* pxStackBase;
+    uint32_t usStackHighWaterMark;
+    BaseType_t xCoreID;
+} TaskStatus_t;
+
+// Create a task on its own thread (the core is ignored)
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stackDepth, void* parameter,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t coreId);
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stackDepth, void* parameter,
+                       UBaseType_t priority, TaskHandle_t* handle);
+
+// Delete a task (null = the calling task); another task stops at its next blocking call
+void vTaskDelete(TaskHandle_t task);
+
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t* previousWakeTime, TickType_t increment);
+TickType_t xTaskGetTickCount();
+
+// The calling task (threads not created here are registered on first use)
+TaskHandle_t xTaskGetCurrentTaskHandle();
+TaskHandle_t xTaskGetHandle(const char* name);
+char* pcTaskGetName(TaskHandle_t task);
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task);
+
+// Stack depth given at creation (stack use is not measured on the host)
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+
+UBaseType_t uxTaskGetNumberOfTasks();
+UBaseType_t uxTaskGetSystemState(TaskStatus_t* statusArray, UBaseType_t arraySize, uint32_t* totalRunTime);
+
+// Direct-to-task notifications
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higherPriorityTaskWoken);
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait);
+
+#endif // NATIVE_FREERTOS_TASK_H
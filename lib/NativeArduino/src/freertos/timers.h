@@ -0,0 +1,21 @@
+#ifndef NATIVE_FREERTOS_TIMERS_H
+#define NATIVE_FREERTOS_TIMERS_H
+
+#include "FreeRTOS.h"
+
+struct NativeTimer;
+typedef NativeTimer* TimerHandle_t;
+typedef void (*TimerCallbackFunction_t)(TimerHandle_t timer);
+
+// Software timers, run by a "Tmr Svc" task as on the device
+TimerHandle_t xTimerCreate(const char* name, TickType_t period, UBaseType_t autoReload, void* timerId,
+                           TimerCallbackFunction_t callback);
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t ticksToWait);
+BaseType_t xTimerReset(TimerHandle_t timer, TickType_t ticksToWait);
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t ticksToWait);
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t ticksToWait);
+BaseType_t xTimerDelete(TimerHandle_t timer, TickType_t ticksToWait);
+BaseType_t xTimerIsTimerActive(TimerHandle_t timer);
+void* pvTimerGetTimerID(TimerHandle_t timer);
+
+#endif // NATIVE_FREERTOS_TIMERS_H
@@ -0,0 +1,21 @@
+#ifndef NATIVE_MBEDTLS_SHA256_H
+#define NATIVE_MBEDTLS_SHA256_H
+
+// SHA-256 with the mbedTLS interface (software only, SHA-224 not supported)
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    uint64_t total;             // Bytes hashed so far
+    uint32_t state[8];
+    unsigned char buffer[64];   // Partial block
+} mbedtls_sha256_context;
+
+void mbedtls_sha256_init(mbedtls_sha256_context* ctx);
+void mbedtls_sha256_free(mbedtls_sha256_context* ctx);
+int mbedtls_sha256_starts(mbedtls_sha256_context* ctx, int is224);
+int mbedtls_sha256_update(mbedtls_sha256_context* ctx, const unsigned char* input, size_t ilen);
+int mbedtls_sha256_finish(mbedtls_sha256_context* ctx, unsigned char output[32]);
+
+#endif // NATIVE_MBEDTLS_SHA256_H
@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+"""Push changed web UI files to a device without reflashing LittleFS.
+
+Usage: fs_delta_upload.py <device url> <admin user> <password> [data dir]
+
+The data dir defaults to .pio/data, the output of scripts/pre_build.py.
+The device is sent a manifest (path and SHA-256 of every file), answers
+with the files that differ, and only those are uploaded; pages go last so
+they never reference an asset that isn't there yet. Finally, assets that
+are no longer in the manifest are removed. Configuration files
+(users.json, devices.json, alexa.json) are never touched.
+"""
+
+import hashlib
+import json
+import os
+import sys
+import urllib.error
+import urllib.parse
+import urllib.request
+
+
+def request(url, data, headers, session=None):
+    headers = dict(headers)
+    if session:
+        headers["Cookie"] = "session=" + session
+    req = urllib.request.Request(url, data=data, headers=headers, method="POST")
+    try:
+        with urllib.request.urlopen(req) as response:
+            return response.headers, json.loads(response.read().decode("utf-8"))
+    except urllib.error.HTTPError as error:
+        # Errors carry a JSON message as well
+        return error.headers, json.loads(error.read().decode("utf-8") or "{}")
+
+
+def post_json(url, body, session=None):
+    return request(url, json.dumps(body).encode("utf-8"), {"Content-Type": "application/json"}, session)
+
+
+def login(base, username, password):
+    headers, _ = post_json(base + "/api/login", {"username": username, "password": password})
+    for cookie in headers.get_all("Set-Cookie") or []:
+        if cookie.startswith("session="):
+            return cookie.split(";")[0][len("session="):]
+    raise SystemExit("Login failed")
+
+
+def build_manifest(data_dir):
+    files = {}
+    for root, _, names in os.walk(data_dir):
+        for name in sorted(names):
+            path = os.path.join(root, name)
+            url = "/" + os.path.relpath(path, data_dir).replace(os.sep, "/")
+            with open(path, "rb") as f:
+                files[url] = f.read()
+    return files
+
+
+def main():
+    if len(sys.argv) < 4:
+        raise SystemExit(__doc__)
+
+    base = sys.argv[1].rstrip("/")
+    data_dir = sys.argv[4] if len(sys.argv) > 4 else os.path.join(".pio", "data")
+
+    files = build_manifest(data_dir)
+    manifest = [{"path": url, "sha256": hashlib.sha256(data).hexdigest()} for url, data in files.items()]
+    session = login(base, sys.argv[2], sys.argv[3])
+
+    _, result = post_json(base + "/ota/fs/manifest", {"files": manifest}, session)
+    if not result.get("success", False):
+        raise SystemExit("Manifest rejected: %s" % result.get("message"))
+
+    # Assets first, pages last
+    needed = sorted(result["needed"], key=lambda url: url.endswith(".html.gz"))
+    total = 0
+    for url in needed:
+        data = files[url]
+        headers = {
+            "Content-Type": "application/octet-stream",
+            "X-File-SHA256": hashlib.sha256(data).hexdigest(),
+        }
+        _, reply = request(base + "/ota/fs/file?path=" + urllib.parse.quote(url), data, headers, session)
+        if not reply.get("success", False):
+            raise SystemExit("%s: %s" % (url, reply.get("message")))
+        total += len(data)
+        print("Updated %s (%d bytes)" % (url, len(data)))
+
+    _, result = post_json(base + "/ota/fs/manifest", {"files": manifest, "prune": True}, session)
+    for url in result.get("removed", []):
+        print("Removed %s" % url)
+
+    print("%d of %d files sent, %d bytes" % (len(needed), len(files), total))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,35 @@
+import gzip
+import hashlib
+
+Import("env")
+
+# This script packages the firmware for OTA updates: next to firmware.bin it
+# writes firmware.bin.gz and firmware.bin.sha256 (digest of the uncompressed
+# image, which is what the device checks). Upload with:
+#
+#   curl -b "session=<id>" -H "Content-Type: application/octet-stream" \
+#        -H "X-Firmware-SHA256: $(cat firmware.bin.sha256)" \
+#        --data-binary @firmware.bin.gz http://<device>/ota/firmware
+#
+# The Content-Type matters: without it curl sends form data, which the
+# device refuses with 415.
+
+
+def package_firmware(source, target, env):
+    path = str(target[0])
+    with open(path, "rb") as f:
+        image = f.read()
+
+    digest = hashlib.sha256(image).hexdigest()
+    # mtime=0 keeps the output reproducible between builds
+    compressed = gzip.compress(image, compresslevel=9, mtime=0)
+
+    with open(path + ".gz", "wb") as f:
+        f.write(compressed)
+    with open(path + ".sha256", "w") as f:
+        f.write(digest)
+
+    print("OTA image: %d -> %d bytes, sha256 %s" % (len(image), len(compressed), digest))
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.bin", package_firmware)
@@ -1,33 +1,213 @@
+import gzip
+import hashlib
 import os
+import re
 import shutil
-from pathlib import Path
-
-# This script copies the data directory to the build directory
-# so that it can be uploaded to the ESP32's filesystem
-
-def copy_data_dir(source, destination):
-    if not os.path.exists(destination):
-        os.makedirs(destination)
-    
-    for item in os.listdir(source):
-        s = os.path.join(source, item)
-        d = os.path.join(destination, item)
-        
-        if os.path.isdir(s):
-            copy_data_dir(s, d)
-        else:
-            shutil.copy2(s, d)
-
-# Get the project directory
-project_dir = Path("__file__").parent.parent
-data_dir = os.path.join(project_dir, "data")
-dest_dir = os.path.join(project_dir, ".pio", "build", "esp32devV3x", "data")
-
-# Copy data directory to build directory
-if os.path.exists(data_dir):
-    if not os.path.exists(dest_dir):
-        os.makedirs(dest_dir)
-    copy_data_dir(data_dir, dest_dir)
-    print("Data directory copied to build directory")
+
+Import("env")
+
+# This script prepares the web UI for the ESP32's filesystem:
+# - CSS and JavaScript are minified, renamed with a content hash
+#   (style.css -> style.1a2b3c4d.css) and stored gzipped only
+# - HTML pages are rewritten to point at the hashed names, minified
+#   and stored gzipped under their original name
+# - anything else is copied as-is
+# Sources live in data/, the result goes to the project data_dir
+# (see platformio.ini), which is what buildfs/uploadfs pack.
+#
+# With `custom_web_assets = flash` in the environment, the same assets are
+# instead compiled into the firmware as constexpr arrays (WebAssetsData.h in
+# the build directory) and WEB_ASSETS_IN_FLASH is defined.
+
+# Content types by extension
+CONTENT_TYPES = {
+    ".html": "text/html",
+    ".css": "text/css",
+    ".js": "application/javascript",
+    ".json": "application/json",
+    ".svg": "image/svg+xml",
+    ".png": "image/png",
+    ".jpg": "image/jpeg",
+    ".ico": "image/x-icon",
+}
+
+# Files that get a content hash in their name
+HASHED_EXTENSIONS = (".css", ".js")
+
+# Files that are gzipped
+COMPRESSED_EXTENSIONS = (".html", ".css", ".js", ".svg", ".json")
+
+
+def minify_css(text):
+    text = re.sub(r"/\*.*?\*/", "", text, flags=re.S)
+    text = re.sub(r"\s+", " ", text)
+    text = re.sub(r"\s*([{}:;,>])\s*", r"\1", text)
+    return text.replace(";}", "}").strip()
+
+
+def minify_js(text):
+    # Conservative: drop full-line comments, indentation and blank lines
+    lines = []
+    for line in text.splitlines():
+        stripped = line.strip()
+        if not stripped or stripped.startswith("//"):
+            continue
+        lines.append(stripped)
+    return "\n".join(lines)
+
+
+def minify_html(text):
+    text = re.sub(r"<!--.*?-->", "", text, flags=re.S)
+    lines = [line.strip() for line in text.splitlines()]
+    return "\n".join(line for line in lines if line)
+
+
+def minify(name, text):
+    if name.endswith(".css"):
+        return minify_css(text)
+    if name.endswith(".js"):
+        return minify_js(text)
+    if name.endswith(".html"):
+        return minify_html(text)
+    return text
+
+
+def content_hash(data):
+    return hashlib.sha256(data).hexdigest()[:8]
+
+
+def hashed_name(name, digest):
+    stem, ext = os.path.splitext(name)
+    return "%s.%s%s" % (stem, digest, ext)
+
+
+def gzip_bytes(data):
+    # mtime=0 keeps the output reproducible between builds
+    return gzip.compress(data, compresslevel=9, mtime=0)
+
+
+def build_assets(source):
+    """Return a list of (url path, stored bytes, gzipped) for the web UI."""
+    assets = []
+    renames = {}
+    pages = []
+
+    for root, _, files in os.walk(source):
+        for item in sorted(files):
+            path = os.path.join(root, item)
+            url = "/" + os.path.relpath(path, source).replace(os.sep, "/")
+
+            if item.endswith(".html"):
+                pages.append((url, path))
+                continue
+
+            with open(path, "rb") as f:
+                data = f.read()
+
+            if item.endswith(HASHED_EXTENSIONS):
+                data = minify(item, data.decode("utf-8")).encode("utf-8")
+                new_url = hashed_name(url, content_hash(data))
+                renames[url] = new_url
+                url = new_url
+
+            compressed = item.endswith(COMPRESSED_EXTENSIONS)
+            assets.append((url, gzip_bytes(data) if compressed else data, compressed))
+
+    # Pages last, so they can reference the hashed names
+    for url, path in pages:
+        with open(path, "r", encoding="utf-8") as f:
+            text = f.read()
+        for old, new in renames.items():
+            text = text.replace('"%s"' % old, '"%s"' % new)
+        data = minify_html(text).encode("utf-8")
+        assets.append((url, gzip_bytes(data), True))
+
+    return assets
+
+
+def write_assets(assets, destination):
+    if os.path.exists(destination):
+        shutil.rmtree(destination)
+    os.makedirs(destination)
+
+    total = 0
+    for url, data, compressed in assets:
+        target = os.path.join(destination, url.lstrip("/") + (".gz" if compressed else ""))
+        os.makedirs(os.path.dirname(target), exist_ok=True)
+        with open(target, "wb") as f:
+            f.write(data)
+        total += len(data)
+
+    return total
+
+
+def c_identifier(url):
+    return "asset_" + re.sub(r"[^A-Za-z0-9]", "_", url.lstrip("/"))
+
+
+def write_header(assets, path):
+    lines = [
+        "// Generated by scripts/pre_build.py, do not edit",
+        "#ifndef WEB_ASSETS_DATA_H",
+        "#define WEB_ASSETS_DATA_H",
+        "",
+        '#include "WebAssets.h"',
+        "",
+    ]
+
+    entries = []
+    for url, data, compressed in assets:
+        name = c_identifier(url)
+        ext = os.path.splitext(url)[1]
+        content_type = CONTENT_TYPES.get(ext, "application/octet-stream")
+        etag = '\\"%s\\"' % content_hash(data)
+        immutable = "true" if url.endswith(HASHED_EXTENSIONS) else "false"
+
+        lines.append("static constexpr uint8_t %s[] = {" % name)
+        for i in range(0, len(data), 16):
+            lines.append("    " + ", ".join("0x%02x" % b for b in data[i:i + 16]) + ",")
+        lines.append("};")
+        lines.append("")
+        entries.append('    {"%s", "%s", %s, sizeof(%s), "%s", %s, %s},' % (
+            url, content_type, name, name, etag, "true" if compressed else "false", immutable))
+
+    lines.append("static constexpr WebAsset WEB_ASSETS[] = {")
+    lines.extend(entries)
+    lines.append("};")
+    lines.append("")
+    lines.append("static constexpr size_t WEB_ASSET_COUNT = sizeof(WEB_ASSETS) / sizeof(WEB_ASSETS[0]);")
+    lines.append("")
+    lines.append("#endif // WEB_ASSETS_DATA_H")
+    lines.append("")
+
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    content = "\n".join(lines)
+
+    # Only touch the header when it changes, to avoid needless rebuilds
+    if os.path.exists(path):
+        with open(path, "r") as f:
+            if f.read() == content:
+                return
+    with open(path, "w") as f:
+        f.write(content)
+
+
+project_dir = env.subst("$PROJECT_DIR")
+source_dir = os.path.join(project_dir, "data")
+dest_dir = env.subst("$PROJECT_DATA_DIR")
+assets_in_flash = env.GetProjectOption("custom_web_assets", "littlefs") == "flash"
+
+if os.path.exists(source_dir):
+    assets = build_assets(source_dir)
+    if assets_in_flash:
+        generated_dir = os.path.join(env.subst("$BUILD_DIR"), "generated")
+        write_header(assets, os.path.join(generated_dir, "WebAssetsData.h"))
+        env.Append(CPPPATH=[generated_dir], CPPDEFINES=["WEB_ASSETS_IN_FLASH"])
+        # The filesystem image only needs the configuration files now
+        write_assets([], dest_dir)
+        print("Web assets compiled into firmware: %d files, %d bytes" % (len(assets), sum(len(a[1]) for a in assets)))
+    else:
+        size = write_assets(assets, dest_dir)
+        print("Web assets built: %d files, %d bytes" % (len(assets), size))
 else:
     print("Data directory not found")
@@ -0,0 +1,197 @@
+#include "../include/AdmissionControl.h"
+#include <esp_heap_caps.h>
+#include "../include/Metrics.h"
+
+// Constructor
+AdmissionControl::AdmissionControl() :
+    inFlight(0),
+    peakInFlight(0),
+    minLargestBlock(UINT32_MAX),
+    admittedCount(0),
+    shedCount(0)
+{
+}
+
+// Install the admission middleware on a server (must run before routes are added)
+void AdmissionControl::attach(AsyncWebServer* server) {
+    server->addMiddleware([this](AsyncWebServerRequest *request, ArMiddlewareNext next) {
+        if (!this->admit(this->classify(request))) {
+            this->reject(request);
+            return;
+        }
+        
+        this->admittedCount++;
+        
+        // The mode the request arrived in, before the listener wakes the radio
+        bool powerSave = metrics.wifiPowerSave;
+        if (this->activityListener) {
+            this->activityListener();
+        }
+        
+        // Event streams hand their connection over to the event source and are
+        // long-lived, so only regular requests count towards concurrency
+        if (request->url() == "/events") {
+            next();
+            return;
+        }
+        
+        // Track the request until its connection is released
+        int current = ++this->inFlight;
+        int peak = this->peakInFlight.load();
+        while (current > peak && !this->peakInFlight.compare_exchange_weak(peak, current)) {
+        }
+        
+        uint32_t start = micros();
+        this->onRelease(request, [this, request, start, powerSave]() {
+            this->inFlight--;
+            metrics.recordRequest(request->url(), micros() - start, powerSave);
+        });
+        
+        next();
+    });
+}
+
+// Set the listener called for every admitted request
+void AdmissionControl::onActivity(ActivityListener listener) {
+    activityListener = listener;
+}
+
+// Run a handler once the request's connection is released; routes use this
+// instead of request->onDisconnect(), which would replace the tracking
+void AdmissionControl::onRelease(AsyncWebServerRequest *request, ArDisconnectHandler handler) {
+    // Body handlers run before the middleware, so whichever comes first installs it
+    std::vector<ArDisconnectHandler>& handlers = releaseHandlers[request];
+    if (handlers.empty()) {
+        request->onDisconnect([this, request]() {
+            this->release(request);
+        });
+    }
+    handlers.push_back(handler);
+}
+
+// Run and forget the release handlers of a request
+void AdmissionControl::release(AsyncWebServerRequest *request) {
+    auto it = releaseHandlers.find(request);
+    if (it == releaseHandlers.end()) {
+        return;
+    }
+    
+    // The address may be reused by the next request
+    std::vector<ArDisconnectHandler> handlers = std::move(it->second);
+    releaseHandlers.erase(it);
+    for (ArDisconnectHandler& handler : handlers) {
+        handler();
+    }
+}
+
+// Configure thresholds
+void AdmissionControl::setThresholds(uint32_t elevatedMinBlock, uint32_t criticalMinBlock, int elevatedMaxInFlight, int criticalMaxInFlight) {
+    this->elevatedMinBlock = elevatedMinBlock;
+    this->criticalMinBlock = criticalMinBlock;
+    this->elevatedMaxInFlight = elevatedMaxInFlight;
+    this->criticalMaxInFlight = criticalMaxInFlight;
+}
+
+// Classify a request by URL
+RequestPriority AdmissionControl::classify(AsyncWebServerRequest *request) {
+    const String& url = request->url();
+    
+    // Device control always gets through
+    if (url == "/api/devices/toggle" || url == "/api/devices/level") {
+        return RequestPriority::CONTROL;
+    }
+    
+    // Alexa switching a light: PUT /api/<user>/lights/<id>/state
+    if (request->method() == HTTP_PUT && url.startsWith("/api/") && url.indexOf("/lights/") > 0 && url.endsWith("/state")) {
+        return RequestPriority::CONTROL;
+    }
+    
+    // Admin API and OTA
+    if (url.startsWith("/api/users") || url.startsWith("/api/wifi") || url == "/api/devices/add" || url == "/api/devices/update" ||
+        url == "/api/devices/delete" || url.startsWith("/update") || url.startsWith("/ota")) {
+        return RequestPriority::BULK;
+    }
+    
+    // Remaining API calls and the event stream
+    if (url.startsWith("/api/") || url == "/events") {
+        return RequestPriority::NORMAL;
+    }
+    
+    // Pages and static files
+    return RequestPriority::BULK;
+}
+
+// Current pressure level
+PressureLevel AdmissionControl::getPressureLevel() {
+    uint32_t largestBlock = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    
+    // Track the low watermark
+    uint32_t lowest = minLargestBlock.load();
+    while (largestBlock < lowest && !minLargestBlock.compare_exchange_weak(lowest, largestBlock)) {
+    }
+    
+    int current = inFlight.load();
+    if (largestBlock < criticalMinBlock || current >= criticalMaxInFlight) {
+        return PressureLevel::CRITICAL;
+    }
+    
+    if (largestBlock < elevatedMinBlock || current >= elevatedMaxInFlight) {
+        return PressureLevel::ELEVATED;
+    }
+    
+    return PressureLevel::NONE;
+}
+
+// Check whether a request of the given priority would be admitted now
+bool AdmissionControl::admit(RequestPriority priority) {
+    if (priority == RequestPriority::CONTROL) {
+        return true;
+    }
+    
+    PressureLevel level = getPressureLevel();
+    if (level == PressureLevel::CRITICAL) {
+        return false;
+    }
+    
+    if (level == PressureLevel::ELEVATED && priority == RequestPriority::BULK) {
+        return false;
+    }
+    
+    return true;
+}
+
+// Reject a request with 503 and Retry-After
+void AdmissionControl::reject(AsyncWebServerRequest *request) {
+    shedCount++;
+    metrics.requestsShed++;
+    
+    AsyncWebServerResponse *response;
+    if (request->url().startsWith("/api/")) {
+        response = request->beginResponse(503, "application/json", "{\"success\":false,\"message\":\"Server busy\"}");
+    } else {
+        response = request->beginResponse(503, "text/plain", "Server busy");
+    }
+    response->addHeader("Retry-After", String(retryAfterSeconds));
+    request->send(response);
+}
+
+// Statistics
+int AdmissionControl::getInFlight() {
+    return inFlight.load();
+}
+
+int AdmissionControl::getPeakInFlight() {
+    return peakInFlight.load();
+}
+
+uint32_t AdmissionControl::getMinLargestBlock() {
+    return minLargestBlock.load();
+}
+
+uint32_t AdmissionControl::getAdmittedCount() {
+    return admittedCount.load();
+}
+
+uint32_t AdmissionControl::getShedCount() {
+    return shedCount.load();
+}
@@ -1,26 +1,85 @@
 #include "../include/AlexaManager.h"
+#include "../include/Metrics.h"
+#include "../include/LoopMonitor.h"
+#include <LittleFS.h>
+#include <WiFi.h>
+
+// Espalexa light keys hold the device index + 1 in 7 bits
+static_assert(ALEXA_MAX_SLOTS < 128, "too many slots for the light key encoding");
 
 // Constructor
 AlexaManager::AlexaManager(DeviceManager* deviceManager) {
     this->deviceManager = deviceManager;
     this->alexa = new Espalexa();
     this->initialized = false;
+    this->mutex = xSemaphoreCreateRecursiveMutex();
+    this->lightKeyPrefix = 0;
+    
+    // Follow state changes from buttons, the web UI and Alexa itself; this is
+    // registered here, before the control plane starts, and applied by handle(),
+    // which runs as soon as the loop is woken
+    deviceManager->onStateChange([this](int channel, bool state) {
+        xSemaphoreTakeRecursive(this->mutex, portMAX_DELAY);
+        this->pendingStates[channel] = state;
+        xSemaphoreGiveRecursive(this->mutex);
+        loopMonitor.wake();
+    });
+    
+    for (int i = 0; i < ALEXA_MAX_SLOTS; i++) {
+        slots[i].channel = -1;
+        slots[i].active = false;
+        slots[i].dimmable = false;
+        slots[i].state = false;
+        slots[i].brightness = 254;
+    }
 }
 
 // Destructor
 AlexaManager::~AlexaManager() {
     delete alexa;
+    vSemaphoreDelete(mutex);
 }
 
-// Initialize Alexa integration
-bool AlexaManager::begin() {
+// Initialize Alexa integration on the given server
+bool AlexaManager::begin(AsyncWebServer* server) {
     if (initialized) {
         return true;
     }
     
-    // Add all enabled devices to Alexa
+    // Light keys and unique ids use Espalexa's encoding (encodeLightKey and
+    // encodeLightId), so lights paired before the slot registry keep their ids
+    // and several bridges on the same network don't collide
+    uint8_t mac[6];
+    WiFi.macAddress(mac);
+    lightKeyPrefix = (1UL << 31) | ((uint32_t)mac[3] << 23) | ((uint32_t)mac[4] << 15) | ((uint32_t)mac[5] << 7);
+    char uniqueId[32];
+    snprintf(uniqueId, sizeof(uniqueId), "%02X:%02X:%02X:%02X:%02X:%02X:00:11-",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    uniqueIdPrefix = uniqueId;
+    
+    // Restore slot assignments, then fill them from the device list
+    loadSlots();
     updateAllDevices();
     
+    // Hue lights API, registered before Espalexa so it takes precedence over
+    // Espalexa's own not-found handler
+    server->on("/api/*", HTTP_GET | HTTP_PUT, [this](AsyncWebServerRequest *request) {
+        this->handleHueRequest(request, static_cast<uint8_t*>(request->_tempObject), request->contentLength());
+    }, nullptr, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+        // Accumulate the body, freed together with the request
+        if (index == 0 && total <= 512) {
+            request->_tempObject = malloc(total);
+        }
+        if (request->_tempObject != nullptr) {
+            memcpy(static_cast<uint8_t*>(request->_tempObject) + index, data, len);
+        }
+    }).setFilter([](AsyncWebServerRequest *request) {
+        return request->url().indexOf("/lights") > 0;
+    });
+    
+    // Espalexa keeps answering SSDP, description.xml and pairing
+    alexa->begin(server);
+    
     initialized = true;
     Serial.println("Alexa integration initialized");
     return true;
@@ -29,107 +88,424 @@ bool AlexaManager::begin() {
 // Handle Alexa events (should be called in loop)
 void AlexaManager::handle() {
     if (initialized) {
+        applyPendingStates();
         alexa->loop();
     }
 }
 
-// Device callback (called when Alexa changes device state)
-void AlexaManager::deviceCallback(int channel, uint8_t brightness) {
+// Set the control plane that applies Alexa commands
+void AlexaManager::setControlPlane(ControlPlane* controlPlane) {
+    this->controlPlane = controlPlane;
+}
+
+// Apply pending device state changes to their slots
+void AlexaManager::applyPendingStates() {
+    xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
+    
+    // Everything that changed since the last iteration goes in one batch
+    for (const auto& pending : pendingStates) {
+        int slot = findSlot(pending.first);
+        if (slot < 0 || !slots[slot].active) {
+            continue;
+        }
+        
+        // Dimmers can change level without changing state
+        uint8_t brightness = slots[slot].brightness;
+        if (slots[slot].dimmable) {
+            Device device;
+            if (deviceManager->getDevice(pending.first, device)) {
+                brightness = max(1, device.level - 1);
+            }
+        }
+        
+        if (slots[slot].state != pending.second || slots[slot].brightness != brightness) {
+            slots[slot].state = pending.second;
+            slots[slot].brightness = brightness;
+            markChanged(slot);
+        }
+    }
+    pendingStates.clear();
+    
+    xSemaphoreGiveRecursive(mutex);
+}
+
+// Device callback (called when Alexa changes device state), returns
+// false if the command couldn't be queued
+bool AlexaManager::deviceCallback(int channel, uint8_t brightness) {
+    // Ignore slots whose device was removed or hidden from Alexa
+    Device device;
+    if (!deviceManager->getDevice(channel, device) || !device.alexaEnabled) {
+        return true;
+    }
+    
     // Convert brightness to boolean state (on/off)
     bool state = brightness > 0;
+    if (state) {
+        metrics.alexaCommandsOn++;
+    } else {
+        metrics.alexaCommandsOff++;
+    }
     
-    // Toggle device when Alexa changes state
-    deviceManager->toggleDevice(channel, state);
+    // Dimmers take the brightness as their level, relays only on/off
+    if (device.type == DeviceType::DIMMER) {
+        return controlPlane->setLevel(channel, brightness);
+    }
+    return controlPlane->setState(channel, state);
 }
 
 // Add or update device in Alexa
 bool AlexaManager::addOrUpdateDevice(int channel) {
     // Get device from DeviceManager
-    Device* device = deviceManager->getDeviceByChannel(channel);
-    if (!device || !device->alexaEnabled) {
+    Device device;
+    if (!deviceManager->getDevice(channel, device)) {
         return false;
     }
     
-    // Check if device already exists in Alexa by checking our map
-    bool deviceExists = deviceIds.find(channel) != deviceIds.end();
+    // Device hidden from Alexa, detach it
+    if (!device.alexaEnabled) {
+        return removeDevice(channel);
+    }
     
-    // Add or update device
-    if (deviceExists) {
-        // Update device state (0 = off, 255 = on)
-        alexa->setDeviceState(deviceIds[channel], device->outputState[0] ? 255 : 0);
-    } else {
-        // Add new device with callback
-        uint8_t deviceId = alexa->addDevice(device->alexaName.c_str(), 
-            [this, channel](uint8_t brightness) {
-                // Call our member function with the channel and brightness
-                this->deviceCallback(channel, brightness);
-            }, 
-            EspalexaDeviceType::onoff);
-        
-        // Store device ID in our map
-        deviceIds[channel] = deviceId;
-        
-        // Set initial state
-        alexa->setDeviceState(deviceId, device->outputState[0] ? 255 : 0);
+    xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
+    
+    int slot = assignSlot(channel);
+    if (slot < 0) {
+        xSemaphoreGiveRecursive(mutex);
+        Serial.println("No free Alexa slot for channel " + String(channel));
+        return false;
     }
     
+    // Only this slot changes, Espalexa and the other lights are untouched
+    AlexaSlot& entry = slots[slot];
+    entry.active = true;
+    entry.name = device.alexaName;
+    entry.state = device.outputState[0];
+    entry.dimmable = device.type == DeviceType::DIMMER;
+    if (entry.dimmable) {
+        entry.brightness = max(1, device.level - 1);
+    }
+    markChanged(slot);
+    
+    xSemaphoreGiveRecursive(mutex);
     return true;
 }
 
 // Remove device from Alexa
 bool AlexaManager::removeDevice(int channel) {
-    // Get device from DeviceManager
-    Device* device = deviceManager->getDeviceByChannel(channel);
-    if (!device) {
+    xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
+    
+    int slot = findSlot(channel);
+    if (slot < 0 || !slots[slot].active) {
+        xSemaphoreGiveRecursive(mutex);
         return false;
     }
     
-    // Check if device exists in our map
-    if (deviceIds.find(channel) != deviceIds.end()) {
-        // Remove device from Espalexa
-        // Note: Espalexa doesn't have a direct method to remove a single device
-        // We'll need to rebuild all devices
-        deviceIds.erase(channel);
-        updateAllDevices();
-    }
+    // Hide the light but keep the slot reserved for the channel, so the
+    // same light id comes back if the device is re-enabled or re-added
+    slots[slot].active = false;
+    slots[slot].state = false;
+    markChanged(slot);
     
+    xSemaphoreGiveRecursive(mutex);
     return true;
 }
 
 // Update all devices in Alexa
 void AlexaManager::updateAllDevices() {
-    // Clear device IDs map
-    deviceIds.clear();
+    xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
     
-    // Clear all devices from Espalexa
-    if (initialized) {
-        delete alexa;
-        alexa = new Espalexa();
-    }
-    
-    // Add all enabled devices
-    for (Device& device : deviceManager->getAllDevices()) {
-        if (device.alexaEnabled) {
-            int channel = device.channel;
-            
-            // Add device with callback
-            uint8_t deviceId = alexa->addDevice(device.alexaName.c_str(), 
-                [this, channel](uint8_t brightness) {
-                    // Call our member function with the channel and brightness
-                    this->deviceCallback(channel, brightness);
-                }, 
-                EspalexaDeviceType::onoff);
-            
-            // Store device ID in our map
-            deviceIds[channel] = deviceId;
-            
-            // Set initial state
-            alexa->setDeviceState(deviceId, device.outputState[0] ? 255 : 0);
+    // Hide slots whose device no longer exists
+    for (int i = 0; i < ALEXA_MAX_SLOTS; i++) {
+        if (slots[i].active && !deviceManager->hasDevice(slots[i].channel)) {
+            slots[i].active = false;
+            markChanged(i);
         }
     }
     
-    // Begin Espalexa if we're already initialized
-    if (initialized) {
-        alexa->begin();
+    // Sync every device into its slot in place
+    for (const Device& device : deviceManager->getAllDevices()) {
+        addOrUpdateDevice(device.channel);
+    }
+    
+    xSemaphoreGiveRecursive(mutex);
+}
+
+// Find the slot assigned to a channel, -1 if none
+int AlexaManager::findSlot(int channel) {
+    for (int i = 0; i < ALEXA_MAX_SLOTS; i++) {
+        if (slots[i].channel == channel) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Find or assign a slot for a channel, -1 if the registry is full
+int AlexaManager::assignSlot(int channel) {
+    int slot = findSlot(channel);
+    if (slot >= 0) {
+        return slot;
+    }
+    
+    // Prefer a slot that was never used, then reclaim one whose device is gone
+    for (int i = 0; i < ALEXA_MAX_SLOTS && slot < 0; i++) {
+        if (slots[i].channel == -1) {
+            slot = i;
+        }
+    }
+    for (int i = 0; i < ALEXA_MAX_SLOTS && slot < 0; i++) {
+        if (!slots[i].active && !deviceManager->hasDevice(slots[i].channel)) {
+            slot = i;
+        }
+    }
+    if (slot < 0) {
+        return -1;
+    }
+    
+    slots[slot].channel = channel;
+    slots[slot].active = false;
+    slots[slot].brightness = 254;
+    
+    // Assignments change rarely, persist them so light ids survive reboots
+    saveSlots();
+    return slot;
+}
+
+// Load slot assignments from file system
+bool AlexaManager::loadSlots() {
+    if (!LittleFS.exists(configFile)) {
+        return false;
+    }
+    
+    File file = LittleFS.open(configFile, "r");
+    if (!file) {
+        Serial.println("Failed to open Alexa config file for reading");
+        return false;
+    }
+    
+    DynamicJsonDocument doc(1024);
+    DeserializationError error = deserializeJson(doc, file);
+    file.close();
+    
+    if (error) {
+        Serial.println("Failed to parse Alexa config file");
+        return false;
+    }
+    
+    for (JsonObject slotObj : doc["slots"].as<JsonArray>()) {
+        int slot = slotObj["slot"] | 0;
+        if (slot >= 1 && slot <= ALEXA_MAX_SLOTS) {
+            slots[slot - 1].channel = slotObj["channel"] | -1;
+        }
     }
+    
+    return true;
+}
+
+// Save slot assignments to file system
+bool AlexaManager::saveSlots() {
+    DynamicJsonDocument doc(1024);
+    JsonArray slotsArray = doc.createNestedArray("slots");
+    
+    for (int i = 0; i < ALEXA_MAX_SLOTS; i++) {
+        if (slots[i].channel != -1) {
+            JsonObject slotObj = slotsArray.createNestedObject();
+            slotObj["slot"] = i + 1;
+            slotObj["channel"] = slots[i].channel;
+        }
+    }
+    
+    File file = LittleFS.open(configFile, "w");
+    if (!file) {
+        Serial.println("Failed to open Alexa config file for writing");
+        return false;
+    }
+    
+    bool ok = serializeJson(doc, file) > 0;
+    file.close();
+    
+    if (!ok) {
+        Serial.println("Failed to write Alexa config file");
+    }
+    return ok;
+}
+
+// Light key used by Alexa for a slot (the low 7 bits are the Espalexa device index + 1)
+uint32_t AlexaManager::lightKey(int slot) {
+    return lightKeyPrefix | (uint32_t)((slot + 1) & 0x7F);
+}
+
+// Slot for a light key, -1 if unknown
+int AlexaManager::slotFromKey(uint32_t key) {
+    if ((key & ~0x7FUL) != lightKeyPrefix) {
+        return -1;
+    }
+    int slot = (int)(key & 0x7F) - 1;
+    if (slot < 0 || slot >= ALEXA_MAX_SLOTS) {
+        return -1;
+    }
+    return slot;
+}
+
+// Fill in the Hue description of a slot
+void AlexaManager::fillLight(JsonObject lightObj, int slot) {
+    const AlexaSlot& entry = slots[slot];
+    
+    JsonObject stateObj = lightObj.createNestedObject("state");
+    stateObj["on"] = entry.state;
+    stateObj["bri"] = entry.brightness;
+    stateObj["alert"] = "none";
+    stateObj["mode"] = "homeautomation";
+    stateObj["reachable"] = true;
+    
+    lightObj["type"] = entry.dimmable ? "Dimmable light" : "On/Off light";
+    lightObj["name"] = entry.name;
+    lightObj["modelid"] = entry.dimmable ? "LWB010" : "Plug";
+    lightObj["manufacturername"] = "Philips";
+    lightObj["productname"] = entry.dimmable ? "E2" : "E1";
+    char index[3];
+    snprintf(index, sizeof(index), "%02X", slot + 1);
+    lightObj["uniqueid"] = uniqueIdPrefix + index;
+    lightObj["swversion"] = "espalexa-2.7.0";
+}
+
+// Drop the rendered JSON of a slot and the discovery document
+void AlexaManager::markChanged(int slot) {
+    slots[slot].rendered.reset();
+    discoveryDoc.reset();
+}
+
+// Rendered Hue JSON of a slot, rendered again only after a change
+std::shared_ptr<const String> AlexaManager::renderLight(int slot) {
+    if (!slots[slot].rendered) {
+        StaticJsonDocument<512> doc;
+        fillLight(doc.to<JsonObject>(), slot);
+        
+        String* json = new String();
+        json->reserve(measureJson(doc));
+        serializeJson(doc, *json);
+        slots[slot].rendered.reset(json);
+    }
+    return slots[slot].rendered;
+}
+
+// Discovery document, assembled again only after a change
+std::shared_ptr<const String> AlexaManager::renderDiscovery() {
+    if (!discoveryDoc) {
+        String* json = new String("{");
+        for (int i = 0; i < ALEXA_MAX_SLOTS; i++) {
+            if (slots[i].active) {
+                if (json->length() > 1) {
+                    *json += ',';
+                }
+                *json += '"';
+                *json += String(lightKey(i));
+                *json += "\":";
+                *json += *renderLight(i);
+            }
+        }
+        *json += '}';
+        discoveryDoc.reset(json);
+    }
+    return discoveryDoc;
+}
+
+// Send rendered JSON, keeping it alive until the response is done
+void AlexaManager::sendRendered(AsyncWebServerRequest *request, std::shared_ptr<const String> json) {
+    // The response holds a reference, so a change while it is being sent
+    // renders a new document instead of modifying this one
+    AsyncWebServerResponse *response = request->beginResponse("application/json", json->length(),
+        [json](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+            size_t len = std::min(maxLen, json->length() - index);
+            memcpy(buffer, json->c_str() + index, len);
+            return len;
+        });
+    request->send(response);
+}
+
+// Handle a Hue lights request (list, single light or state change)
+void AlexaManager::handleHueRequest(AsyncWebServerRequest *request, uint8_t* body, size_t len) {
+    // URL is /api/<user>/lights[/<key>[/state]], parsed in place
+    const char* rest = strstr(request->url().c_str(), "/lights") + 7;
+    
+    // Discovery: all active lights
+    if (*rest == '\0' || strcmp(rest, "/") == 0) {
+        xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
+        std::shared_ptr<const String> json = renderDiscovery();
+        xSemaphoreGiveRecursive(mutex);
+        
+        sendRendered(request, json);
+        return;
+    }
+    
+    // Single light, optionally with /state
+    char* end = nullptr;
+    uint32_t key = strtoul(rest + 1, &end, 10);
+    bool isState = strncmp(end, "/state", 6) == 0;
+    int slot = slotFromKey(key);
+    
+    xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
+    
+    if (slot < 0 || !slots[slot].active) {
+        xSemaphoreGiveRecursive(mutex);
+        sendHueError(request, "/lights/" + String(key));
+        return;
+    }
+    
+    if (!isState) {
+        std::shared_ptr<const String> json = renderLight(slot);
+        xSemaphoreGiveRecursive(mutex);
+        
+        sendRendered(request, json);
+        return;
+    }
+    
+    if (request->method() != HTTP_PUT || body == nullptr) {
+        xSemaphoreGiveRecursive(mutex);
+        sendHueError(request, "/lights/" + String(key) + "/state");
+        return;
+    }
+    
+    StaticJsonDocument<256> command;
+    if (deserializeJson(command, body, len)) {
+        xSemaphoreGiveRecursive(mutex);
+        sendHueError(request, "/lights/" + String(key) + "/state");
+        return;
+    }
+    
+    // Work out the new slot state from the command
+    AlexaSlot& entry = slots[slot];
+    bool state = entry.state;
+    uint8_t level = entry.brightness;
+    if (command.containsKey("bri")) {
+        level = constrain(command["bri"].as<int>(), 1, 254);
+        state = true;
+    }
+    if (command.containsKey("on")) {
+        state = command["on"].as<bool>();
+    }
+    
+    // Queue it for the control plane first (it doesn't block); the slot only
+    // takes the new state once the device will follow, so a full queue
+    // leaves what Alexa reads unchanged
+    if (!deviceCallback(entry.channel, state ? level + 1 : 0)) {
+        xSemaphoreGiveRecursive(mutex);
+        metrics.alexaCommandsDropped++;
+        sendHueError(request, "/lights/" + String(key) + "/state");
+        return;
+    }
+    entry.state = state;
+    entry.brightness = level;
+    markChanged(slot);
+    
+    xSemaphoreGiveRecursive(mutex);
+    
+    // Reply right away, the control plane does the switching and saving
+    request->send(200, "application/json", "[{\"success\":{\"/lights/" + String(key) + "/state/\":true}}]");
+}
+
+// Send a Hue "resource not available" error
+void AlexaManager::sendHueError(AsyncWebServerRequest *request, const String& address) {
+    request->send(200, "application/json",
+        "[{\"error\":{\"type\":3,\"address\":\"" + address + "\",\"description\":\"resource, " + address + ", not available\"}}]");
 }
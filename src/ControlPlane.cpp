@@ -0,0 +1,152 @@
+#include "../include/ControlPlane.h"
+#include "../include/Metrics.h"
+
+// Constructor
+ControlPlane::ControlPlane(DeviceManager* deviceManager) {
+    this->deviceManager = deviceManager;
+    this->taskHandle = nullptr;
+}
+
+// Start the control plane task
+bool ControlPlane::begin() {
+    if (taskHandle != nullptr) {
+        return true;
+    }
+    
+    // File writes go to a lower priority task (written inline if it can't start)
+    deviceManager->startWriter();
+    
+    BaseType_t created = xTaskCreatePinnedToCore(
+        task,
+        "ControlPlaneTask",
+        4096,
+        this,
+        TASK_PRIORITY,
+        &taskHandle,
+        TASK_CORE);
+    
+    if (created != pdPASS) {
+        Serial.println("Failed to create control plane task");
+        taskHandle = nullptr;
+        return false;
+    }
+    
+    return true;
+}
+
+// Control plane task
+void ControlPlane::task(void* parameter) {
+    ControlPlane* controlPlane = static_cast<ControlPlane*>(parameter);
+    const TickType_t scanPeriod = pdMS_TO_TICKS(INPUT_SCAN_MS);
+    TickType_t lastScan = xTaskGetTickCount();
+    
+    for (;;) {
+        // Woken by posted commands, otherwise when the next button scan is due
+        TickType_t elapsed = xTaskGetTickCount() - lastScan;
+        ulTaskNotifyTake(pdTRUE, elapsed < scanPeriod ? scanPeriod - elapsed : 0);
+        
+        // Button presses are queued behind commands that are already waiting
+        if (xTaskGetTickCount() - lastScan >= scanPeriod) {
+            lastScan = xTaskGetTickCount();
+            controlPlane->deviceManager->checkInputs([controlPlane](int channel) {
+                controlPlane->toggle(channel);
+            });
+        }
+        
+        DeviceCommand command;
+        while (controlPlane->queue.pop(command)) {
+            controlPlane->execute(command);
+        }
+        
+        // Write coalesced state changes
+        controlPlane->deviceManager->handle();
+    }
+}
+
+// Apply a command to the devices
+void ControlPlane::execute(const DeviceCommand& command) {
+    switch (command.type) {
+        case DeviceCommandType::TOGGLE:
+            deviceManager->toggleDevice(command.channel, !deviceManager->getDeviceState(command.channel));
+            break;
+        case DeviceCommandType::SET_STATE:
+            deviceManager->toggleDevice(command.channel, command.state);
+            break;
+        case DeviceCommandType::SET_LEVEL:
+            deviceManager->setDeviceLevel(command.channel, command.level, command.fadeMs);
+            break;
+        case DeviceCommandType::CALL:
+            command.call->result = command.call->function();
+            xSemaphoreGive(command.call->done);
+            break;
+    }
+    
+    metrics.recordControlCommand(micros() - command.postedMicros);
+}
+
+// Post a command, returns false if the queue is full
+bool ControlPlane::post(DeviceCommand command) {
+    command.postedMicros = micros();
+    if (!queue.push(command)) {
+        metrics.controlCommandsDropped++;
+        return false;
+    }
+    
+    if (taskHandle != nullptr) {
+        xTaskNotifyGive(taskHandle);
+    }
+    return true;
+}
+
+// Post a toggle
+bool ControlPlane::toggle(int channel) {
+    DeviceCommand command = {};
+    command.type = DeviceCommandType::TOGGLE;
+    command.channel = channel;
+    return post(command);
+}
+
+// Post an on/off command
+bool ControlPlane::setState(int channel, bool state) {
+    DeviceCommand command = {};
+    command.type = DeviceCommandType::SET_STATE;
+    command.channel = channel;
+    command.state = state;
+    return post(command);
+}
+
+// Post a dimmer level (0 = off)
+bool ControlPlane::setLevel(int channel, uint8_t level, uint16_t fadeMs) {
+    DeviceCommand command = {};
+    command.type = DeviceCommandType::SET_LEVEL;
+    command.channel = channel;
+    command.level = level;
+    command.fadeMs = fadeMs;
+    return post(command);
+}
+
+// Run a function on the control plane and wait for its result
+// (runs directly before the task is started or when called from it)
+bool ControlPlane::call(std::function<bool()> function) {
+    if (taskHandle == nullptr || xTaskGetCurrentTaskHandle() == taskHandle) {
+        return function();
+    }
+    
+    ControlPlaneCall pending;
+    pending.function = function;
+    pending.result = false;
+    pending.done = xSemaphoreCreateBinary();
+    if (pending.done == nullptr) {
+        return false;
+    }
+    
+    DeviceCommand command = {};
+    command.type = DeviceCommandType::CALL;
+    command.call = &pending;
+    if (post(command)) {
+        xSemaphoreTake(pending.done, portMAX_DELAY);
+    }
+    
+    vSemaphoreDelete(pending.done);
+    return pending.result;
+}
@@ -1,8 +1,15 @@
 #include "../include/DeviceManager.h"
+#include "../include/Metrics.h"
 
 // Constructor
 DeviceManager::DeviceManager() {
+    mutex = xSemaphoreCreateMutex();
+    writeMutex = xSemaphoreCreateMutex();
+    writerHandle = nullptr;
+    writePending = false;
     initialized = false;
+    savePending = false;
+    lastStateChange = 0;
 }
 
 // Initialize the device manager
@@ -32,21 +39,211 @@ bool DeviceManager::begin() {
 // Setup device pins
 void DeviceManager::setupPins() {
     for (auto& device : devices) {
-        // Setup input pins
-        for (int pin : device.inputPins) {
-            pinMode(pin, INPUT_PULLUP);
+        setupDevicePins(device);
+    }
+}
+
+// Configure the GPIOs used by a single device
+void DeviceManager::setupDevicePins(Device& device) {
+    // Setup input pins
+    for (int pin : device.inputPins) {
+        pinMode(pin, INPUT_PULLUP);
+    }
+    
+    // Dimmers are driven by a LEDC channel so fades run in hardware
+    if (device.type == DeviceType::DIMMER) {
+        device.ledcChannel = -1;
+        for (int i = 0; i < DIMMER_MAX_CHANNELS; i++) {
+            if (!(ledcChannelsUsed & (1 << i))) {
+                device.ledcChannel = i;
+                ledcChannelsUsed |= (1 << i);
+                break;
+            }
+        }
+        if (device.ledcChannel < 0) {
+            Serial.println("No free LEDC channel for dimmer on channel " + String(device.channel));
+            return;
         }
         
-        // Setup output pins
-        for (size_t i = 0; i < device.outputPins.size(); i++) {
-            pinMode(device.outputPins[i], OUTPUT);
-            digitalWrite(device.outputPins[i], device.outputState[i] ? LOW : HIGH);  // HIGH = OFF, LOW = ON
+        // All dimmers share one timer
+        if (!fadeInstalled) {
+            ledc_timer_config_t timerConfig = {};
+            timerConfig.speed_mode = LEDC_HIGH_SPEED_MODE;
+            timerConfig.duty_resolution = DIMMER_RESOLUTION;
+            timerConfig.timer_num = LEDC_TIMER_0;
+            timerConfig.freq_hz = DIMMER_PWM_FREQUENCY;
+            timerConfig.clk_cfg = LEDC_AUTO_CLK;
+            ledc_timer_config(&timerConfig);
+            ledc_fade_func_install(0);
+            fadeInstalled = true;
         }
+        
+        ledc_channel_config_t channelConfig = {};
+        channelConfig.gpio_num = device.outputPins[0];
+        channelConfig.speed_mode = LEDC_HIGH_SPEED_MODE;
+        channelConfig.channel = (ledc_channel_t)device.ledcChannel;
+        channelConfig.timer_sel = LEDC_TIMER_0;
+        channelConfig.duty = 0;
+        ledc_channel_config(&channelConfig);
+        
+        writeDimmer(device, 0);
+        return;
     }
+    
+    // Setup output pins
+    for (size_t i = 0; i < device.outputPins.size(); i++) {
+        pinMode(device.outputPins[i], OUTPUT);
+        digitalWrite(device.outputPins[i], device.outputState[i] ? LOW : HIGH);  // HIGH = OFF, LOW = ON
+    }
+}
+
+// Return the GPIOs used by a single device to a safe, unconfigured state
+// (pins still claimed by a device in the list are left alone)
+void DeviceManager::releaseDevicePins(const Device& device) {
+    // Stop the dimmer's LEDC channel (output low = off) and free it
+    if (device.type == DeviceType::DIMMER && device.ledcChannel >= 0) {
+        ledc_stop(LEDC_HIGH_SPEED_MODE, (ledc_channel_t)device.ledcChannel, 0);
+        ledcChannelsUsed &= ~(1 << device.ledcChannel);
+    }
+    
+    // Switch relays off before letting go of the pin
+    for (int pin : device.outputPins) {
+        if (isPinInUse(pin, -1)) {
+            continue;
+        }
+        digitalWrite(pin, device.type == DeviceType::DIMMER ? LOW : HIGH);  // Relays: HIGH = OFF
+        pinMode(pin, INPUT);
+    }
+    
+    for (int pin : device.inputPins) {
+        if (isPinInUse(pin, -1)) {
+            continue;
+        }
+        pinMode(pin, INPUT);
+    }
+}
+
+// Check if a pin is used by any device other than the given channel
+bool DeviceManager::isPinInUse(int pin, int ignoreChannel) {
+    for (const Device& device : devices) {
+        if (device.channel == ignoreChannel) {
+            continue;
+        }
+        
+        for (int inputPin : device.inputPins) {
+            if (inputPin == pin) {
+                return true;
+            }
+        }
+        
+        for (int outputPin : device.outputPins) {
+            if (outputPin == pin) {
+                return true;
+            }
+        }
+    }
+    
+    return false;
+}
+
+// Validate a device definition (pins, state vectors, conflicts with other channels)
+bool DeviceManager::validateDevice(const Device& device, int ignoreChannel, String& error) {
+    if (device.channel < 0) {
+        error = "Channel must be zero or greater";
+        return false;
+    }
+    
+    if (device.name.empty()) {
+        error = "Name is required";
+        return false;
+    }
+    
+    if (device.outputPins.empty()) {
+        error = "At least one output pin is required";
+        return false;
+    }
+    
+    if (device.outputState.size() != device.outputPins.size() || device.inputState.size() != device.inputPins.size()) {
+        error = "Pin and state lists do not match";
+        return false;
+    }
+    
+    if (device.type == DeviceType::DIMMER) {
+        if (device.outputPins.size() != 1) {
+            error = "A dimmer has exactly one output pin";
+            return false;
+        }
+        
+        // One LEDC channel per dimmer
+        int dimmers = 0;
+        for (const Device& other : devices) {
+            if (other.channel != ignoreChannel && other.type == DeviceType::DIMMER) {
+                dimmers++;
+            }
+        }
+        if (dimmers >= DIMMER_MAX_CHANNELS) {
+            error = "At most " + String(DIMMER_MAX_CHANNELS) + " dimmers are supported";
+            return false;
+        }
+    }
+    
+    std::vector<int> usedPins;
+    for (int pin : device.inputPins) {
+        // GPIO 6-11 are wired to the SPI flash
+        if (pin < 0 || pin > 39 || (pin >= 6 && pin <= 11)) {
+            error = "Invalid input pin " + String(pin);
+            return false;
+        }
+        usedPins.push_back(pin);
+    }
+    
+    for (int pin : device.outputPins) {
+        // GPIO 34-39 are input only
+        if (pin < 0 || pin > 33 || (pin >= 6 && pin <= 11)) {
+            error = "Invalid output pin " + String(pin);
+            return false;
+        }
+        usedPins.push_back(pin);
+    }
+    
+    for (size_t i = 0; i < usedPins.size(); i++) {
+        // Same pin listed twice within the device
+        for (size_t j = i + 1; j < usedPins.size(); j++) {
+            if (usedPins[i] == usedPins[j]) {
+                error = "Pin " + String(usedPins[i]) + " is used more than once";
+                return false;
+            }
+        }
+        
+        // Pin already owned by another device
+        if (isPinInUse(usedPins[i], ignoreChannel)) {
+            error = "Pin " + String(usedPins[i]) + " is already used by another device";
+            return false;
+        }
+    }
+    
+    return true;
 }
 
-// Save devices to file
+// Save devices to file, handing the write to the writer task once it runs
 bool DeviceManager::saveDevices() {
+    String json = serializeDevices();
+    if (writerHandle == nullptr) {
+        return writeFile(json);
+    }
+    
+    // A newer snapshot replaces one the writer has not picked up yet
+    xSemaphoreTake(writeMutex, portMAX_DELAY);
+    pendingWrite = json;
+    writePending = true;
+    xSemaphoreGive(writeMutex);
+    
+    xTaskNotifyGive(writerHandle);
+    return true;
+}
+
+// Serialize the devices file contents
+String DeviceManager::serializeDevices() {
     // Create a JSON document
     DynamicJsonDocument doc(4096);
     JsonArray devicesArray = doc.createNestedArray("devices");
@@ -58,6 +255,10 @@ bool DeviceManager::saveDevices() {
         deviceObj["name"] = device.name;
         deviceObj["alexaName"] = device.alexaName;
         deviceObj["alexaEnabled"] = device.alexaEnabled;
+        if (device.type == DeviceType::DIMMER) {
+            deviceObj["type"] = "dimmer";
+            deviceObj["level"] = device.level;
+        }
         
         // Add input pins
         JsonArray inputPinsArray = deviceObj.createNestedArray("inputPins");
@@ -78,21 +279,33 @@ bool DeviceManager::saveDevices() {
         }
     }
     
+    String json;
+    serializeJson(doc, json);
+    return json;
+}
+
+// Write the devices file
+bool DeviceManager::writeFile(const String& json) {
+    uint32_t start = micros();
+    
     // Open the file for writing
     File file = LittleFS.open(configFile, "w");
     if (!file) {
         Serial.println("Failed to open devices file for writing");
+        metrics.recordWrite(metrics.deviceWrites, micros() - start, false);
         return false;
     }
     
-    // Serialize JSON to file
-    if (serializeJson(doc, file) == 0) {
+    // Write JSON to file
+    if (file.print(json) != json.length()) {
         Serial.println("Failed to write devices to file");
         file.close();
+        metrics.recordWrite(metrics.deviceWrites, micros() - start, false);
         return false;
     }
     
     file.close();
+    metrics.recordWrite(metrics.deviceWrites, micros() - start, true);
     return true;
 }
 
@@ -133,6 +346,8 @@ bool DeviceManager::loadDevices() {
         device.name = deviceObj["name"].as<std::string>();
         device.alexaName = deviceObj["alexaName"].as<std::string>();
         device.alexaEnabled = deviceObj["alexaEnabled"].as<bool>();
+        device.type = strcmp(deviceObj["type"] | "relay", "dimmer") == 0 ? DeviceType::DIMMER : DeviceType::RELAY;
+        device.level = constrain(deviceObj["level"] | 255, 1, 255);
         
         // Read input pins
         JsonArray inputPinsArray = deviceObj["inputPins"];
@@ -171,8 +386,13 @@ bool DeviceManager::addDevice(const Device& device) {
     }
     
     // Add device to list
+    xSemaphoreTake(mutex, portMAX_DELAY);
     devices.push_back(device);
     
+    // Configure only the new device's pins
+    setupDevicePins(devices.back());
+    xSemaphoreGive(mutex);
+    
     // Save devices to file
     return saveDevices();
 }
@@ -182,9 +402,17 @@ bool DeviceManager::updateDevice(int channel, const Device& device) {
     // Find device
     for (size_t i = 0; i < devices.size(); i++) {
         if (devices[i].channel == channel) {
+            Device oldDevice = devices[i];
+            
             // Update device
+            xSemaphoreTake(mutex, portMAX_DELAY);
             devices[i] = device;
             
+            // Reconfigure only this device's pins, releasing the ones it no longer uses
+            releaseDevicePins(oldDevice);
+            setupDevicePins(devices[i]);
+            xSemaphoreGive(mutex);
+            
             // Save devices to file
             return saveDevices();
         }
@@ -198,8 +426,15 @@ bool DeviceManager::deleteDevice(int channel) {
     // Find device
     for (auto it = devices.begin(); it != devices.end(); ++it) {
         if (it->channel == channel) {
+            Device oldDevice = *it;
+            
             // Remove device
+            xSemaphoreTake(mutex, portMAX_DELAY);
             devices.erase(it);
+            xSemaphoreGive(mutex);
+            
+            // Switch the device off and release its pins
+            releaseDevicePins(oldDevice);
             
             // Save devices to file
             return saveDevices();
@@ -209,12 +444,34 @@ bool DeviceManager::deleteDevice(int channel) {
     return false;
 }
 
-// Get all devices
-std::vector<Device>& DeviceManager::getAllDevices() {
-    return devices;
+// Get a copy of all devices (safe from any task)
+std::vector<Device> DeviceManager::getAllDevices() {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    std::vector<Device> copy = devices;
+    xSemaphoreGive(mutex);
+    return copy;
+}
+
+// Get a copy of a device, returns false if there is none (safe from any task)
+bool DeviceManager::getDevice(int channel, Device& device) {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    Device* found = getDeviceByChannel(channel);
+    if (found != nullptr) {
+        device = *found;
+    }
+    xSemaphoreGive(mutex);
+    return found != nullptr;
+}
+
+// Check if a device exists (safe from any task)
+bool DeviceManager::hasDevice(int channel) {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    bool found = getDeviceByChannel(channel) != nullptr;
+    xSemaphoreGive(mutex);
+    return found;
 }
 
-// Get device by channel
+// Get device by channel (live entry, control plane only)
 Device* DeviceManager::getDeviceByChannel(int channel) {
     for (Device& device : devices) {
         if (device.channel == channel) {
@@ -225,7 +482,7 @@ Device* DeviceManager::getDeviceByChannel(int channel) {
     return nullptr;
 }
 
-// Toggle device state
+// Set device state (the control plane turns toggles into an explicit state)
 bool DeviceManager::toggleDevice(int channel, bool newState) {
     // Find device
     Device* device = getDeviceByChannel(channel);
@@ -233,31 +490,146 @@ bool DeviceManager::toggleDevice(int channel, bool newState) {
         return false;
     }
     
-    // Toggle state if newState is -1, otherwise set to newState
-    if (newState == -1) {
-        device->outputState[0] = !device->outputState[0];
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    device->outputState[0] = newState;
+    xSemaphoreGive(mutex);
+    
+    // Set output pin
+    if (device->type == DeviceType::DIMMER) {
+        writeDimmer(*device, DIMMER_DEFAULT_FADE_MS);
     } else {
-        device->outputState[0] = newState;
+        digitalWrite(device->outputPins[0], device->outputState[0] ? LOW : HIGH);  // HIGH = OFF, LOW = ON
     }
     
-    // Set output pin
-    digitalWrite(device->outputPins[0], device->outputState[0] ? LOW : HIGH);  // HIGH = OFF, LOW = ON
+    // Notify listeners
+    for (auto& listener : stateListeners) {
+        listener(channel, device->outputState[0]);
+    }
     
-    // Save devices to file
-    saveDevices();
+    // Save devices to file once changes settle
+    scheduleSave();
     
     return true;
 }
 
-// Get device state
-bool DeviceManager::getDeviceState(int channel) {
+// Set a dimmer's level (0 = off), fading over fadeMs
+bool DeviceManager::setDeviceLevel(int channel, uint8_t level, uint16_t fadeMs) {
     // Find device
     Device* device = getDeviceByChannel(channel);
-    if (device == nullptr) {
+    if (device == nullptr || device->type != DeviceType::DIMMER) {
+        return false;
+    }
+    
+    // Level 0 switches off and keeps the last level for the next "on"
+    bool stateChanged = device->outputState[0] != (level > 0);
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    device->outputState[0] = level > 0;
+    if (level > 0) {
+        device->level = level;
+    }
+    xSemaphoreGive(mutex);
+    
+    writeDimmer(*device, fadeMs);
+    
+    // Notify listeners
+    if (stateChanged || level > 0) {
+        for (auto& listener : stateListeners) {
+            listener(channel, device->outputState[0]);
+        }
+    }
+    
+    // Save devices to file once changes settle
+    scheduleSave();
+    
+    return true;
+}
+
+// Drive a dimmer output to its current level, fading over fadeMs
+void DeviceManager::writeDimmer(const Device& device, uint16_t fadeMs) {
+    if (device.ledcChannel < 0) {
+        return;
+    }
+    
+    ledc_channel_t ledcChannel = (ledc_channel_t)device.ledcChannel;
+    uint32_t duty = device.outputState[0] ? (uint32_t)device.level * DIMMER_MAX_DUTY / 255 : 0;
+    
+    // The fade runs in the LEDC peripheral, no CPU time is spent on it
+    if (fadeMs > 0) {
+        ledc_set_fade_with_time(LEDC_HIGH_SPEED_MODE, ledcChannel, duty, fadeMs);
+        ledc_fade_start(LEDC_HIGH_SPEED_MODE, ledcChannel, LEDC_FADE_NO_WAIT);
+    } else {
+        ledc_set_duty(LEDC_HIGH_SPEED_MODE, ledcChannel, duty);
+        ledc_update_duty(LEDC_HIGH_SPEED_MODE, ledcChannel);
+    }
+}
+
+// Save state changes once they settle, coalescing bursts into one write
+void DeviceManager::scheduleSave() {
+    lastStateChange = millis();
+    savePending = true;
+}
+
+// Write coalesced state changes to file (called by the control plane)
+void DeviceManager::handle() {
+    if (savePending && millis() - lastStateChange >= STATE_SAVE_DELAY_MS) {
+        savePending = false;
+        saveDevices();
+    }
+}
+
+// Start the task that writes the devices file (called by the control plane)
+bool DeviceManager::startWriter() {
+    if (writerHandle != nullptr) {
+        return true;
+    }
+    
+    BaseType_t created = xTaskCreatePinnedToCore(
+        writerTask,
+        "DeviceWriterTask",
+        4096,
+        this,
+        WRITER_PRIORITY,
+        &writerHandle,
+        WRITER_CORE);
+    
+    if (created != pdPASS) {
+        Serial.println("Failed to create device writer task");
+        writerHandle = nullptr;
         return false;
     }
     
-    return device->outputState[0];
+    return true;
+}
+
+// Writer task
+void DeviceManager::writerTask(void* parameter) {
+    DeviceManager* deviceManager = static_cast<DeviceManager*>(parameter);
+    
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        
+        // Take the latest snapshot, later saves may queue another meanwhile
+        xSemaphoreTake(deviceManager->writeMutex, portMAX_DELAY);
+        if (!deviceManager->writePending) {
+            xSemaphoreGive(deviceManager->writeMutex);
+            continue;
+        }
+        String json = deviceManager->pendingWrite;
+        deviceManager->pendingWrite = String();
+        deviceManager->writePending = false;
+        xSemaphoreGive(deviceManager->writeMutex);
+        
+        deviceManager->writeFile(json);
+    }
+}
+
+// Get device state
+bool DeviceManager::getDeviceState(int channel) {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    Device* device = getDeviceByChannel(channel);
+    bool state = device != nullptr && device->outputState[0];
+    xSemaphoreGive(mutex);
+    return state;
 }
 
 // Create default devices if none exist
@@ -312,19 +684,26 @@ void DeviceManager::createDefaultDevicesIfNeeded() {
     }
 }
 
-// Check device inputs (buttons)
-void DeviceManager::checkInputs() {
+// Check device inputs (buttons), reporting the channel of each press
+void DeviceManager::checkInputs(const std::function<void(int channel)>& onPress) {
     for (Device& device : devices) {
         for (size_t i = 0; i < device.inputPins.size(); i++) {
             bool currentState = digitalRead(device.inputPins[i]) == HIGH;
             
             // Trigger only on rising edge
             if (currentState && !device.inputState[i]) {
-                toggleDevice(device.channel);
+                onPress(device.channel);
             }
             
             // Save input state for edge detection
+            xSemaphoreTake(mutex, portMAX_DELAY);
             device.inputState[i] = currentState;
+            xSemaphoreGive(mutex);
         }
     }
 }
+
+// Register a listener for device state changes (call before tasks start)
+void DeviceManager::onStateChange(DeviceStateListener listener) {
+    stateListeners.push_back(listener);
+}
@@ -0,0 +1,339 @@
+#include "../include/EventStream.h"
+#include "../include/Metrics.h"
+#include <algorithm>
+
+// Constructor
+EventStream::EventStream(const char* url, DeviceManager* deviceManager) {
+    this->events = new AsyncEventSource(url);
+    this->deviceManager = deviceManager;
+    this->mutex = xSemaphoreCreateRecursiveMutex();
+    this->taskHandle = nullptr;
+    this->statusProvider = nullptr;
+    this->statusCheckRequested = false;
+    this->ringCount = 0;
+    
+    // Random starting point, so IDs from before a reboot don't match new events
+    this->currentSeq = esp_random() >> 1;
+    this->flushedSeq = currentSeq;
+}
+
+// Attach the event source to a server and start the task
+void EventStream::begin(AsyncWebServer* server) {
+    // New clients get what they missed (or the current state), sent to that client only
+    events->onConnect([this](AsyncEventSourceClient *client) {
+        metrics.sseClients++;
+        
+        xSemaphoreTakeRecursive(this->mutex, portMAX_DELAY);
+        this->clients.push_back({client, false, 0});
+        
+        // Browsers send the ID of the last event they saw when reconnecting
+        String message;
+        uint32_t lastId = client->lastId();
+        if (lastId != 0 && this->buildSince(lastId, message)) {
+            if (message.length() > 0) {
+                this->sendTo(client, message.c_str(), "states", this->currentSeq);
+            }
+        } else {
+            message = this->buildSnapshot();
+            this->sendTo(client, message.c_str(), "snapshot", this->currentSeq);
+        }
+        
+        // Current status, without an ID since it is not part of the replay sequence
+        if (this->statusProvider) {
+            String key;
+            message = this->buildStatus(key);
+            this->sendTo(client, message.c_str(), "status", 0);
+        }
+        
+        xSemaphoreGiveRecursive(this->mutex);
+        
+        // The task sleeps while nobody is connected, wake it for heartbeats
+        if (this->taskHandle != nullptr) {
+            xTaskNotifyGive(this->taskHandle);
+        }
+    });
+    
+    events->onDisconnect([this](AsyncEventSourceClient *client) {
+        metrics.sseClients--;
+        
+        xSemaphoreTakeRecursive(this->mutex, portMAX_DELAY);
+        for (auto it = this->clients.begin(); it != this->clients.end(); ++it) {
+            if (it->client == client) {
+                this->clients.erase(it);
+                break;
+            }
+        }
+        xSemaphoreGiveRecursive(this->mutex);
+    });
+    
+    server->addHandler(events);
+    
+    // Start event stream task
+    xTaskCreatePinnedToCore(
+        eventStreamTask,
+        "EventStreamTask",
+        4096,
+        this,
+        1,
+        &taskHandle,
+        0);
+}
+
+// Queue a device state change for the next flush
+void EventStream::publishState(int channel, bool state) {
+    xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
+    currentSeq++;
+    ring[currentSeq % RING_SIZE] = {currentSeq, channel, state};
+    if (ringCount < RING_SIZE) {
+        ringCount++;
+    }
+    xSemaphoreGiveRecursive(mutex);
+    
+    // Wake the task, repeated changes within the window are coalesced
+    if (taskHandle != nullptr) {
+        xTaskNotifyGive(taskHandle);
+    }
+}
+
+// Only admit clients whose connect request passes the filter
+void EventStream::setFilter(ArRequestFilterFunction filter) {
+    events->setFilter(filter);
+}
+
+// Set the system status source (enables "status" events)
+void EventStream::setStatusProvider(StatusProvider provider) {
+    statusProvider = provider;
+}
+
+// Check the system status on the next task iteration (e.g. after a WiFi event)
+void EventStream::requestStatusCheck() {
+    statusCheckRequested = true;
+    if (taskHandle != nullptr) {
+        xTaskNotifyGive(taskHandle);
+    }
+}
+
+// Number of connected clients
+size_t EventStream::clientCount() {
+    xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
+    size_t count = clients.size();
+    xSemaphoreGiveRecursive(mutex);
+    return count;
+}
+
+// Event stream task
+void EventStream::eventStreamTask(void* parameter) {
+    EventStream* stream = static_cast<EventStream*>(parameter);
+    unsigned long lastHeartbeat = millis();
+    unsigned long lastStatusCheck = millis();
+    
+    for (;;) {
+        // Sleep until a state change, a connect or the next heartbeat or status check
+        if (ulTaskNotifyTake(pdTRUE, stream->nextWakeTicks(lastHeartbeat, lastStatusCheck)) > 0) {
+            // Let further changes within the flush window pile up
+            vTaskDelay(pdMS_TO_TICKS(FLUSH_WINDOW_MS));
+            ulTaskNotifyTake(pdTRUE, 0);
+            stream->flush();
+        }
+        
+        if (stream->statusCheckRequested || millis() - lastStatusCheck >= STATUS_CHECK_INTERVAL_MS) {
+            stream->statusCheckRequested = false;
+            stream->checkStatus();
+            lastStatusCheck = millis();
+        }
+        
+        if (millis() - lastHeartbeat >= HEARTBEAT_INTERVAL_MS) {
+            stream->heartbeat();
+            lastHeartbeat = millis();
+        }
+    }
+}
+
+// Time the task may sleep before the next heartbeat or status check is due
+TickType_t EventStream::nextWakeTicks(unsigned long lastHeartbeat, unsigned long lastStatusCheck) {
+    // Nothing is due without clients; a connect or state change wakes the task
+    if (clientCount() == 0) {
+        return portMAX_DELAY;
+    }
+    
+    unsigned long now = millis();
+    unsigned long sinceHeartbeat = std::min<unsigned long>(now - lastHeartbeat, HEARTBEAT_INTERVAL_MS);
+    unsigned long sinceStatusCheck = std::min<unsigned long>(now - lastStatusCheck, STATUS_CHECK_INTERVAL_MS);
+    unsigned long wait = std::min(HEARTBEAT_INTERVAL_MS - sinceHeartbeat, STATUS_CHECK_INTERVAL_MS - sinceStatusCheck);
+    return pdMS_TO_TICKS(wait);
+}
+
+// Send pending state changes to all clients
+void EventStream::flush() {
+    xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
+    
+    if (flushedSeq == currentSeq) {
+        xSemaphoreGiveRecursive(mutex);
+        return;
+    }
+    
+    // One multi-channel event for everything that changed in the window,
+    // everyone gets a snapshot if more changed than the ring holds
+    String message;
+    String snapshot;
+    bool complete = buildSince(flushedSeq, message);
+    if (!complete) {
+        snapshot = buildSnapshot();
+    }
+    flushedSeq = currentSeq;
+    
+    for (EventClient& client : clients) {
+        // Slow client: drop the update and resynchronize once it catches up
+        if (client.client->packetsWaiting() >= MAX_CLIENT_QUEUE) {
+            client.needsResync = true;
+            metrics.sseEventsDropped++;
+            continue;
+        }
+        
+        if (client.needsResync || !complete) {
+            if (snapshot.length() == 0) {
+                snapshot = buildSnapshot();
+            }
+            client.needsResync = !sendTo(client.client, snapshot.c_str(), "snapshot", currentSeq);
+        } else {
+            client.needsResync = !sendTo(client.client, message.c_str(), "states", currentSeq);
+        }
+    }
+    
+    xSemaphoreGiveRecursive(mutex);
+}
+
+// Send heartbeats and close dead clients
+void EventStream::heartbeat() {
+    xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
+    
+    std::vector<AsyncEventSourceClient*> deadClients;
+    for (EventClient& client : clients) {
+        // Data still queued since the last heartbeat means the peer is not reading
+        if (client.client->packetsWaiting() > 0) {
+            if (++client.stalledBeats >= MAX_STALLED_BEATS) {
+                deadClients.push_back(client.client);
+            }
+            continue;
+        }
+        
+        // No ID, so the browser's Last-Event-ID keeps pointing at real state
+        client.stalledBeats = 0;
+        sendTo(client.client, "{}", "heartbeat", 0);
+    }
+    
+    // Closing removes the client through onDisconnect
+    for (AsyncEventSourceClient* client : deadClients) {
+        Serial.println("Closing stalled event stream client");
+        client->close();
+    }
+    
+    xSemaphoreGiveRecursive(mutex);
+}
+
+// Publish the system status if it changed meaningfully
+void EventStream::checkStatus() {
+    if (!statusProvider) {
+        return;
+    }
+    
+    xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
+    
+    // Nobody is listening
+    if (clients.empty()) {
+        xSemaphoreGiveRecursive(mutex);
+        return;
+    }
+    
+    String key;
+    String message = buildStatus(key);
+    if (key != lastStatusKey) {
+        lastStatusKey = key;
+        for (EventClient& client : clients) {
+            if (client.client->packetsWaiting() < MAX_CLIENT_QUEUE) {
+                sendTo(client.client, message.c_str(), "status", 0);
+            }
+        }
+    }
+    
+    xSemaphoreGiveRecursive(mutex);
+}
+
+// Build the system status message and its change key
+String EventStream::buildStatus(String& key) {
+    DynamicJsonDocument doc(1024);
+    statusProvider(doc.to<JsonObject>());
+    
+    // Only these changes are worth a push; uptime is computed by the client
+    int rssi = doc["wifi"]["rssi"].as<int>();
+    uint32_t freeHeap = doc["freeHeap"].as<uint32_t>();
+    key = String(doc["wifi"]["connected"].as<bool>() ? "1" : "0") + "/" +
+          doc["wifi"]["ip"].as<String>() + "/" +
+          String((rssi - RSSI_BUCKET_DB + 1) / RSSI_BUCKET_DB) + "/" +
+          String(freeHeap / HEAP_BUCKET_BYTES);
+    
+    String message;
+    serializeJson(doc, message);
+    return message;
+}
+
+// Build the full device state message
+String EventStream::buildSnapshot() {
+    DynamicJsonDocument doc(1024);
+    JsonArray devicesArray = doc.createNestedArray("devices");
+    
+    for (const Device& device : deviceManager->getAllDevices()) {
+        JsonObject deviceObj = devicesArray.createNestedObject();
+        deviceObj["channel"] = device.channel;
+        deviceObj["state"] = device.outputState[0];
+    }
+    
+    String message;
+    serializeJson(doc, message);
+    return message;
+}
+
+// Build one "states" message with the changes after a sequence number,
+// returns false if they are no longer all in the ring
+bool EventStream::buildSince(uint32_t seq, String& message) {
+    uint32_t missed = currentSeq - seq;
+    if (missed == 0) {
+        message = "";
+        return true;
+    }
+    
+    // Too old, or an ID from before a reboot
+    if (missed > ringCount) {
+        return false;
+    }
+    
+    // Latest state per channel
+    std::map<int, bool> states;
+    for (uint32_t s = seq + 1; s != currentSeq + 1; s++) {
+        const StateEvent& event = ring[s % RING_SIZE];
+        states[event.channel] = event.state;
+    }
+    
+    DynamicJsonDocument doc(1024);
+    JsonArray devicesArray = doc.createNestedArray("devices");
+    for (const auto& state : states) {
+        JsonObject deviceObj = devicesArray.createNestedObject();
+        deviceObj["channel"] = state.first;
+        deviceObj["state"] = state.second;
+    }
+    
+    message = "";
+    serializeJson(doc, message);
+    return true;
+}
+
+// Send a message to a single client, tracking drops
+bool EventStream::sendTo(AsyncEventSourceClient* client, const char* message, const char* event, uint32_t id) {
+    if (client->send(message, event, id)) {
+        metrics.sseEventsSent++;
+        return true;
+    }
+    
+    metrics.sseEventsDropped++;
+    return false;
+}
@@ -0,0 +1,198 @@
+#include "../include/LoopMonitor.h"
+
+// Global loop monitor instance
+LoopMonitor loopMonitor;
+
+// Handler duration upper bounds in microseconds (an implicit +Inf bucket follows)
+static const uint32_t loopBucketsMicros[] = {100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000};
+static_assert(sizeof(loopBucketsMicros) / sizeof(loopBucketsMicros[0]) + 1 == LOOP_BUCKET_COUNT, "bucket count mismatch");
+
+// Handler names, in LoopHandler order
+static const char* const handlerNames[] = {"network", "alexa", "ota"};
+static_assert(sizeof(handlerNames) / sizeof(handlerNames[0]) == static_cast<size_t>(LoopHandler::COUNT), "handler name mismatch");
+
+// Constructor
+LoopMonitor::LoopMonitor() {
+    this->loopTask = nullptr;
+    this->watchdogTimer = nullptr;
+    this->currentHandler = -1;
+    this->handlerStartMicros = 0;
+    this->overrunReported = false;
+    this->iterationStartMicros = 0;
+    this->slowestHandler = -1;
+    this->slowestMicros = 0;
+    this->iterations = 0;
+    this->overruns = 0;
+    this->wakeups = 0;
+    
+    for (auto& stats : handlers) {
+        stats.count = 0;
+        stats.sumMicros = 0;
+        stats.maxMicros = 0;
+        for (auto& bucket : stats.buckets) {
+            bucket = 0;
+        }
+    }
+}
+
+// Start monitoring (call from the loop task)
+bool LoopMonitor::begin() {
+    loopTask = xTaskGetCurrentTaskHandle();
+    
+    watchdogTimer = xTimerCreate("LoopWatchdog", pdMS_TO_TICKS(ITERATION_BUDGET_MS), pdFALSE, this, watchdogCallback);
+    if (watchdogTimer == nullptr) {
+        Serial.println("Failed to create loop watchdog timer");
+        return false;
+    }
+    
+    return true;
+}
+
+// Sleep until woken or the poll period runs out, then start an iteration
+void LoopMonitor::wait() {
+    if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(POLL_PERIOD_MS)) > 0) {
+        wakeups++;
+    }
+    
+    iterations++;
+    iterationStartMicros = micros();
+    slowestHandler = -1;
+    slowestMicros = 0;
+    overrunReported = false;
+    
+    if (watchdogTimer != nullptr) {
+        xTimerReset(watchdogTimer, 0);
+    }
+}
+
+// Wake the loop (safe from any task)
+void LoopMonitor::wake() {
+    if (loopTask != nullptr) {
+        xTaskNotifyGive(loopTask);
+    }
+}
+
+// Start timing a handler
+void LoopMonitor::enter(LoopHandler handler) {
+    handlerStartMicros = micros();
+    currentHandler = static_cast<int>(handler);
+}
+
+// Stop timing the current handler
+void LoopMonitor::leave() {
+    int index = currentHandler.exchange(-1);
+    if (index < 0) {
+        return;
+    }
+    
+    uint32_t duration = micros() - handlerStartMicros;
+    LoopHandlerStats& stats = handlers[index];
+    stats.count++;
+    stats.sumMicros += duration;
+    if (duration > stats.maxMicros) {
+        stats.maxMicros = duration;
+    }
+    
+    size_t bucket = 0;
+    while (bucket < LOOP_BUCKET_COUNT - 1 && duration > loopBucketsMicros[bucket]) {
+        bucket++;
+    }
+    stats.buckets[bucket]++;
+    
+    if (duration > slowestMicros) {
+        slowestMicros = duration;
+        slowestHandler = index;
+    }
+}
+
+// Finish the iteration and check it against the budget
+void LoopMonitor::endIteration() {
+    if (watchdogTimer != nullptr) {
+        xTimerStop(watchdogTimer, 0);
+    }
+    
+    uint32_t duration = micros() - iterationStartMicros;
+    if (duration <= ITERATION_BUDGET_MS * 1000) {
+        return;
+    }
+    
+    overruns++;
+    Serial.printf("Loop watchdog: iteration took %u us (budget %u ms), slowest handler %s took %u us\n",
+                  duration, ITERATION_BUDGET_MS,
+                  slowestHandler >= 0 ? handlerNames[slowestHandler] : "none", slowestMicros);
+}
+
+// Watchdog timer callback
+void LoopMonitor::watchdogCallback(TimerHandle_t timer) {
+    LoopMonitor* monitor = static_cast<LoopMonitor*>(pvTimerGetTimerID(timer));
+    
+    // Name the handler while it is still blocking; endIteration() reports the total
+    int index = monitor->currentHandler.load();
+    if (index >= 0 && !monitor->overrunReported.exchange(true)) {
+        Serial.printf("Loop watchdog: %s still running after %u us\n",
+                      handlerNames[index], (unsigned)(micros() - monitor->handlerStartMicros.load()));
+    }
+}
+
+// Estimate a percentile of a handler's durations in microseconds
+uint32_t LoopMonitor::percentile(const LoopHandlerStats& stats, uint32_t permille) {
+    uint32_t count = stats.count.load();
+    if (count == 0) {
+        return 0;
+    }
+    
+    // Upper bound of the bucket holding the rank, capped by the maximum seen
+    uint32_t rank = ((uint64_t)count * permille + 999) / 1000;
+    uint32_t cumulative = 0;
+    for (size_t b = 0; b < LOOP_BUCKET_COUNT - 1; b++) {
+        cumulative += stats.buckets[b].load();
+        if (cumulative >= rank) {
+            return min(loopBucketsMicros[b], stats.maxMicros.load());
+        }
+    }
+    return stats.maxMicros.load();
+}
+
+// Render loop statistics in text exposition format
+void LoopMonitor::render(Print& out) {
+    out.print("# HELP smarthome_loop_handler_duration_seconds Time spent in each main loop handler\n");
+    out.print("# TYPE smarthome_loop_handler_duration_seconds histogram\n");
+    for (size_t i = 0; i < static_cast<size_t>(LoopHandler::COUNT); i++) {
+        LoopHandlerStats& stats = handlers[i];
+        uint32_t count = stats.count.load();
+        uint32_t cumulative = 0;
+        for (size_t b = 0; b < LOOP_BUCKET_COUNT - 1; b++) {
+            cumulative += stats.buckets[b].load();
+            out.printf("smarthome_loop_handler_duration_seconds_bucket{handler=\"%s\",le=\"%.6f\"} %u\n",
+                       handlerNames[i], loopBucketsMicros[b] / 1e6, cumulative);
+        }
+        out.printf("smarthome_loop_handler_duration_seconds_bucket{handler=\"%s\",le=\"+Inf\"} %u\n", handlerNames[i], count);
+        out.printf("smarthome_loop_handler_duration_seconds_sum{handler=\"%s\"} %.6f\n", handlerNames[i], stats.sumMicros.load() / 1e6);
+        out.printf("smarthome_loop_handler_duration_seconds_count{handler=\"%s\"} %u\n", handlerNames[i], count);
+    }
+    
+    // Percentiles since boot, estimated from the buckets
+    out.print("# HELP smarthome_loop_handler_duration_quantile_seconds Estimated handler duration percentiles\n");
+    out.print("# TYPE smarthome_loop_handler_duration_quantile_seconds gauge\n");
+    for (size_t i = 0; i < static_cast<size_t>(LoopHandler::COUNT); i++) {
+        out.printf("smarthome_loop_handler_duration_quantile_seconds{handler=\"%s\",quantile=\"0.5\"} %.6f\n", handlerNames[i], percentile(handlers[i], 500) / 1e6);
+        out.printf("smarthome_loop_handler_duration_quantile_seconds{handler=\"%s\",quantile=\"0.9\"} %.6f\n", handlerNames[i], percentile(handlers[i], 900) / 1e6);
+        out.printf("smarthome_loop_handler_duration_quantile_seconds{handler=\"%s\",quantile=\"0.99\"} %.6f\n", handlerNames[i], percentile(handlers[i], 990) / 1e6);
+    }
+    
+    out.print("# HELP smarthome_loop_handler_duration_max_seconds Longest run of each handler\n");
+    out.print("# TYPE smarthome_loop_handler_duration_max_seconds gauge\n");
+    for (size_t i = 0; i < static_cast<size_t>(LoopHandler::COUNT); i++) {
+        out.printf("smarthome_loop_handler_duration_max_seconds{handler=\"%s\"} %.6f\n", handlerNames[i], handlers[i].maxMicros.load() / 1e6);
+    }
+    
+    out.print("# HELP smarthome_loop_iterations_total Main loop iterations\n");
+    out.print("# TYPE smarthome_loop_iterations_total counter\n");
+    out.printf("smarthome_loop_iterations_total %u\n", iterations.load());
+    out.print("# HELP smarthome_loop_wakeups_total Iterations started by a wake-up rather than the poll period\n");
+    out.print("# TYPE smarthome_loop_wakeups_total counter\n");
+    out.printf("smarthome_loop_wakeups_total %u\n", wakeups.load());
+    out.print("# HELP smarthome_loop_overruns_total Iterations over the watchdog budget\n");
+    out.print("# TYPE smarthome_loop_overruns_total counter\n");
+    out.printf("smarthome_loop_overruns_total %u\n", overruns.load());
+}
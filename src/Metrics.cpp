@@ -0,0 +1,278 @@
+#include "../include/Metrics.h"
+#include <esp_heap_caps.h>
+#include "../include/TaskProfiler.h"
+
+// Global metrics instance
+Metrics metrics;
+
+// Latency histogram upper bounds in milliseconds (an implicit +Inf bucket follows)
+static const uint32_t latencyBucketsMs[] = {5, 10, 25, 50, 100, 250, 500, 1000, 2500};
+static_assert(sizeof(latencyBucketsMs) / sizeof(latencyBucketsMs[0]) + 1 == METRICS_LATENCY_BUCKET_COUNT, "bucket count mismatch");
+
+// Routes tracked individually; anything else is folded into "static" or "other"
+static const char* const routeNames[] = {
+    "/api/login",
+    "/api/logout",
+    "/api/devices",
+    "/api/devices/toggle",
+    "/api/devices/add",
+    "/api/devices/update",
+    "/api/devices/delete",
+    "/api/users",
+    "/api/users/add",
+    "/api/users/update",
+    "/api/users/delete",
+    "/api/status",
+    "/api/metrics",
+    "/api/bootstrap",
+    "static",
+    "other"
+};
+static_assert(sizeof(routeNames) / sizeof(routeNames[0]) == METRICS_ROUTE_COUNT, "route count mismatch");
+
+static const size_t ROUTE_STATIC = METRICS_ROUTE_COUNT - 2;
+static const size_t ROUTE_OTHER = METRICS_ROUTE_COUNT - 1;
+
+// Reset a write-metrics block
+static void resetWrites(WriteMetrics& writes) {
+    writes.count = 0;
+    writes.failures = 0;
+    writes.sumMicros = 0;
+    writes.maxMicros = 0;
+}
+
+// Reset a histogram
+static void resetHistogram(RouteMetrics& histogram) {
+    histogram.count = 0;
+    histogram.sumMicros = 0;
+    for (auto& bucket : histogram.buckets) {
+        bucket = 0;
+    }
+}
+
+// Constructor
+Metrics::Metrics() {
+    for (RouteMetrics& route : routes) {
+        resetHistogram(route);
+    }
+    resetHistogram(wifiModeLatency[0]);
+    resetHistogram(wifiModeLatency[1]);
+    
+    resetWrites(deviceWrites);
+    resetWrites(userWrites);
+    
+    sseClients = 0;
+    sseEventsSent = 0;
+    sseEventsDropped = 0;
+    requestsShed = 0;
+    alexaCommandsOn = 0;
+    alexaCommandsOff = 0;
+    alexaCommandsDropped = 0;
+    controlCommands = 0;
+    controlCommandsDropped = 0;
+    controlLatencyMaxMicros = 0;
+    wifiPowerSave = false;
+    wifiPowerSaveSwitches = 0;
+    otaInProgress = false;
+    otaBytesTotal = 0;
+    otaBytesReceived = 0;
+    otaBytesWritten = 0;
+    otaThroughputBps = 0;
+    otaUpdatesSucceeded = 0;
+    otaUpdatesFailed = 0;
+    otaFsFilesWritten = 0;
+    otaFsBytesWritten = 0;
+}
+
+// Find the route slot for a URL
+size_t Metrics::routeIndex(const String& url) {
+    for (size_t i = 0; i < ROUTE_STATIC; i++) {
+        if (url == routeNames[i]) {
+            return i;
+        }
+    }
+    
+    return url.startsWith("/api/") ? ROUTE_OTHER : ROUTE_STATIC;
+}
+
+// Update an atomic maximum
+void Metrics::updateMax(std::atomic<uint32_t>& target, uint32_t value) {
+    uint32_t current = target.load();
+    while (value > current && !target.compare_exchange_weak(current, value)) {
+    }
+}
+
+// Add a duration to a histogram
+void Metrics::recordLatency(RouteMetrics& histogram, uint32_t durationMicros) {
+    histogram.count++;
+    histogram.sumMicros += durationMicros;
+    
+    size_t bucket = 0;
+    while (bucket < METRICS_LATENCY_BUCKET_COUNT - 1 && durationMicros > latencyBucketsMs[bucket] * 1000) {
+        bucket++;
+    }
+    histogram.buckets[bucket]++;
+}
+
+// Record a completed HTTP request (powerSave: modem sleep was on when it arrived)
+void Metrics::recordRequest(const String& url, uint32_t durationMicros, bool powerSave) {
+    recordLatency(routes[routeIndex(url)], durationMicros);
+    recordLatency(wifiModeLatency[powerSave ? 1 : 0], durationMicros);
+}
+
+// Average request latency in microseconds with power save on or off, 0 if none seen
+uint32_t Metrics::getAverageLatency(bool powerSave) {
+    RouteMetrics& histogram = wifiModeLatency[powerSave ? 1 : 0];
+    uint32_t count = histogram.count.load();
+    return count > 0 ? histogram.sumMicros.load() / count : 0;
+}
+
+// Write one histogram's buckets, sum and count
+void Metrics::renderHistogram(Print& out, const char* name, const char* label, const char* value, RouteMetrics& histogram) {
+    uint32_t count = histogram.count.load();
+    uint32_t cumulative = 0;
+    for (size_t b = 0; b < METRICS_LATENCY_BUCKET_COUNT - 1; b++) {
+        cumulative += histogram.buckets[b].load();
+        out.printf("%s_bucket{%s=\"%s\",le=\"%.3f\"} %u\n", name, label, value, latencyBucketsMs[b] / 1000.0, cumulative);
+    }
+    out.printf("%s_bucket{%s=\"%s\",le=\"+Inf\"} %u\n", name, label, value, count);
+    out.printf("%s_sum{%s=\"%s\"} %.6f\n", name, label, value, histogram.sumMicros.load() / 1e6);
+    out.printf("%s_count{%s=\"%s\"} %u\n", name, label, value, count);
+}
+
+// Record a command applied by the control plane
+void Metrics::recordControlCommand(uint32_t latencyMicros) {
+    controlCommands++;
+    updateMax(controlLatencyMaxMicros, latencyMicros);
+}
+
+// Record a file write
+void Metrics::recordWrite(WriteMetrics& writes, uint32_t durationMicros, bool success) {
+    writes.count++;
+    if (!success) {
+        writes.failures++;
+    }
+    writes.sumMicros += durationMicros;
+    updateMax(writes.maxMicros, durationMicros);
+}
+
+// Write one write-metrics block
+void Metrics::renderWrites(Print& out, const char* file, WriteMetrics& writes) {
+    out.printf("smarthome_fs_writes_total{file=\"%s\"} %u\n", file, writes.count.load());
+    out.printf("smarthome_fs_write_failures_total{file=\"%s\"} %u\n", file, writes.failures.load());
+    out.printf("smarthome_fs_write_seconds_total{file=\"%s\"} %.6f\n", file, writes.sumMicros.load() / 1e6);
+    out.printf("smarthome_fs_write_seconds_max{file=\"%s\"} %.6f\n", file, writes.maxMicros.load() / 1e6);
+}
+
+// Render all metrics in text exposition format
+void Metrics::render(Print& out) {
+    // HTTP requests
+    out.print("# HELP smarthome_http_request_duration_seconds HTTP request latency by route\n");
+    out.print("# TYPE smarthome_http_request_duration_seconds histogram\n");
+    for (size_t i = 0; i < METRICS_ROUTE_COUNT; i++) {
+        if (routes[i].count.load() > 0) {
+            renderHistogram(out, "smarthome_http_request_duration_seconds", "route", routeNames[i], routes[i]);
+        }
+    }
+    
+    // The same requests split by WiFi power-save mode
+    out.print("# HELP smarthome_http_request_duration_by_wifi_ps_seconds HTTP request latency by WiFi power-save mode\n");
+    out.print("# TYPE smarthome_http_request_duration_by_wifi_ps_seconds histogram\n");
+    renderHistogram(out, "smarthome_http_request_duration_by_wifi_ps_seconds", "ps", "none", wifiModeLatency[0]);
+    renderHistogram(out, "smarthome_http_request_duration_by_wifi_ps_seconds", "ps", "modem", wifiModeLatency[1]);
+    
+    out.print("# HELP smarthome_http_requests_shed_total Requests rejected with 503 by admission control\n");
+    out.print("# TYPE smarthome_http_requests_shed_total counter\n");
+    out.printf("smarthome_http_requests_shed_total %u\n", requestsShed.load());
+    
+    // Persistence
+    out.print("# HELP smarthome_fs_writes_total Configuration file writes\n");
+    out.print("# TYPE smarthome_fs_writes_total counter\n");
+    renderWrites(out, "devices.json", deviceWrites);
+    renderWrites(out, "users.json", userWrites);
+    
+    // Heap
+    out.print("# HELP smarthome_heap_free_bytes Current free heap\n");
+    out.print("# TYPE smarthome_heap_free_bytes gauge\n");
+    out.printf("smarthome_heap_free_bytes %u\n", ESP.getFreeHeap());
+    out.print("# HELP smarthome_heap_min_free_bytes Lowest free heap since boot\n");
+    out.print("# TYPE smarthome_heap_min_free_bytes gauge\n");
+    out.printf("smarthome_heap_min_free_bytes %u\n", ESP.getMinFreeHeap());
+    out.print("# HELP smarthome_heap_largest_free_block_bytes Largest allocatable block\n");
+    out.print("# TYPE smarthome_heap_largest_free_block_bytes gauge\n");
+    out.printf("smarthome_heap_largest_free_block_bytes %u\n", (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+    
+    // Task stacks, for every task the profiler saw in its latest sample
+    TaskStackFree stacks[TASK_PROFILER_MAX_TASKS];
+    size_t stackCount = taskProfiler.getStacks(stacks, TASK_PROFILER_MAX_TASKS);
+    out.print("# HELP smarthome_task_stack_free_min_bytes Stack high-water mark (minimum free stack) per task\n");
+    out.print("# TYPE smarthome_task_stack_free_min_bytes gauge\n");
+    for (size_t i = 0; i < stackCount; i++) {
+        out.printf("smarthome_task_stack_free_min_bytes{task=\"%s\"} %u\n", stacks[i].name, stacks[i].stackFree);
+    }
+    
+    // Server-sent events
+    out.print("# HELP smarthome_sse_clients Connected event stream clients\n");
+    out.print("# TYPE smarthome_sse_clients gauge\n");
+    out.printf("smarthome_sse_clients %u\n", sseClients.load());
+    out.print("# TYPE smarthome_sse_events_sent_total counter\n");
+    out.printf("smarthome_sse_events_sent_total %u\n", sseEventsSent.load());
+    out.print("# TYPE smarthome_sse_events_dropped_total counter\n");
+    out.printf("smarthome_sse_events_dropped_total %u\n", sseEventsDropped.load());
+    
+    // Alexa
+    out.print("# HELP smarthome_alexa_commands_total Commands received from Alexa\n");
+    out.print("# TYPE smarthome_alexa_commands_total counter\n");
+    out.printf("smarthome_alexa_commands_total{state=\"on\"} %u\n", alexaCommandsOn.load());
+    out.printf("smarthome_alexa_commands_total{state=\"off\"} %u\n", alexaCommandsOff.load());
+    out.print("# HELP smarthome_alexa_commands_dropped_total Alexa commands rejected because the queue was full\n");
+    out.print("# TYPE smarthome_alexa_commands_dropped_total counter\n");
+    out.printf("smarthome_alexa_commands_dropped_total %u\n", alexaCommandsDropped.load());
+    
+    // Device control plane
+    out.print("# HELP smarthome_control_commands_total Device commands applied by the control plane\n");
+    out.print("# TYPE smarthome_control_commands_total counter\n");
+    out.printf("smarthome_control_commands_total %u\n", controlCommands.load());
+    out.print("# HELP smarthome_control_commands_dropped_total Device commands rejected because the queue was full\n");
+    out.print("# TYPE smarthome_control_commands_dropped_total counter\n");
+    out.printf("smarthome_control_commands_dropped_total %u\n", controlCommandsDropped.load());
+    out.print("# HELP smarthome_control_latency_max_seconds Longest time a command waited to be applied\n");
+    out.print("# TYPE smarthome_control_latency_max_seconds gauge\n");
+    out.printf("smarthome_control_latency_max_seconds %.6f\n", controlLatencyMaxMicros.load() / 1e6);
+    
+    // WiFi power save
+    out.print("# HELP smarthome_wifi_power_save Modem sleep enabled (1) or radio always on (0)\n");
+    out.print("# TYPE smarthome_wifi_power_save gauge\n");
+    out.printf("smarthome_wifi_power_save %u\n", wifiPowerSave.load() ? 1 : 0);
+    out.print("# TYPE smarthome_wifi_power_save_switches_total counter\n");
+    out.printf("smarthome_wifi_power_save_switches_total %u\n", wifiPowerSaveSwitches.load());
+    
+    // Firmware updates
+    uint32_t otaTotal = otaBytesTotal.load();
+    out.print("# HELP smarthome_ota_in_progress Firmware update being received\n");
+    out.print("# TYPE smarthome_ota_in_progress gauge\n");
+    out.printf("smarthome_ota_in_progress %u\n", otaInProgress.load() ? 1 : 0);
+    out.print("# HELP smarthome_ota_progress_ratio Share of the current or last upload received\n");
+    out.print("# TYPE smarthome_ota_progress_ratio gauge\n");
+    out.printf("smarthome_ota_progress_ratio %.3f\n", otaTotal > 0 ? (double)otaBytesReceived.load() / otaTotal : 0.0);
+    out.print("# TYPE smarthome_ota_bytes_received gauge\n");
+    out.printf("smarthome_ota_bytes_received %u\n", otaBytesReceived.load());
+    out.print("# HELP smarthome_ota_bytes_written Image bytes written to flash (after inflating)\n");
+    out.print("# TYPE smarthome_ota_bytes_written gauge\n");
+    out.printf("smarthome_ota_bytes_written %u\n", otaBytesWritten.load());
+    out.print("# HELP smarthome_ota_throughput_bytes_per_second Upload rate of the current or last update\n");
+    out.print("# TYPE smarthome_ota_throughput_bytes_per_second gauge\n");
+    out.printf("smarthome_ota_throughput_bytes_per_second %u\n", otaThroughputBps.load());
+    out.print("# TYPE smarthome_ota_updates_total counter\n");
+    out.printf("smarthome_ota_updates_total{result=\"success\"} %u\n", otaUpdatesSucceeded.load());
+    out.printf("smarthome_ota_updates_total{result=\"failure\"} %u\n", otaUpdatesFailed.load());
+    out.print("# HELP smarthome_ota_fs_files_written_total Web assets replaced by delta file system updates\n");
+    out.print("# TYPE smarthome_ota_fs_files_written_total counter\n");
+    out.printf("smarthome_ota_fs_files_written_total %u\n", otaFsFilesWritten.load());
+    out.print("# TYPE smarthome_ota_fs_bytes_written_total counter\n");
+    out.printf("smarthome_ota_fs_bytes_written_total %u\n", otaFsBytesWritten.load());
+    
+    // Uptime
+    out.print("# TYPE smarthome_uptime_seconds counter\n");
+    out.printf("smarthome_uptime_seconds %lu\n", millis() / 1000);
+}
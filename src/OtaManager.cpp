@@ -1,39 +1,637 @@
 #include "../include/OtaManager.h"
+#include "../include/Metrics.h"
+
+// First byte of an ESP32 application image
+static const uint8_t ESP_IMAGE_MAGIC = 0xE9;
+
+// Directories holding web assets (pages are gzipped files in the root)
+static const char* const assetDirs[] = {"/css", "/js", "/img"};
 
 // Constructor
-OtaManager::OtaManager(AsyncWebServer* server) {
+OtaManager::OtaManager(AsyncWebServer* server, UserManager* userManager, SessionManager* sessionManager) {
     this->server = server;
+    this->userManager = userManager;
+    this->sessionManager = sessionManager;
+    this->admissionControl = nullptr;
     this->otaEnabled = false;
+    this->rebootAtMillis = 0;
+    
+    this->session.request = nullptr;
+    this->session.active = false;
+    this->session.error = nullptr;
+    this->session.inflator = nullptr;
+    this->session.window = nullptr;
+    
+    this->fsUpload.request = nullptr;
+    this->fsUpload.active = false;
+    this->fsUpload.error = nullptr;
+}
+
+// Share request cleanup with the admission layer (set before begin())
+void OtaManager::setAdmissionControl(AdmissionControl* admissionControl) {
+    this->admissionControl = admissionControl;
 }
 
 // Initialize OTA manager
 void OtaManager::begin() {
-    // Setup ElegantOTA
-    ElegantOTA.begin(server); // Initialize ElegantOTA
+    // Firmware upload: the image is the raw request body
+    server->on("/ota/firmware", HTTP_POST, [this](AsyncWebServerRequest *request) {
+        // Any other type is parsed as form data and never reaches the body handler
+        if (!isBinaryBody(request)) {
+            sendError(request, 415, "Content-Type must be application/octet-stream");
+            return;
+        }
+        
+        // Check if OTA is enabled
+        if (!this->otaEnabled) {
+            sendError(request, 403, "OTA updates are disabled");
+            return;
+        }
+        
+        // Check if user is admin
+        if (!this->sessionManager->adminMiddleware(request, this->userManager)) {
+            sendError(request, 403, "Admin permission required");
+            return;
+        }
+        
+        if (request->contentLength() == 0) {
+            sendError(request, 400, "Firmware image is required");
+            return;
+        }
+        
+        // The body went to another update
+        if (this->session.request != request) {
+            sendError(request, 409, "Another update is in progress");
+            return;
+        }
+        
+        if (this->session.error != nullptr) {
+            sendError(request, 400, this->session.error);
+            return;
+        }
+        
+        request->send(200, "application/json", "{\"success\":true,\"message\":\"Update complete, restarting\"}");
+    }, nullptr, [this](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+        bool last = index + len == total;
+        
+        if (index == 0) {
+            // One update at a time, admins only
+            if (!isBinaryBody(request) || !this->otaEnabled || this->session.active || !this->sessionManager->adminMiddleware(request, this->userManager)) {
+                return;
+            }
+            
+            size_t headerLength = 0;
+            metrics.otaBytesReceived = 0;
+            if (!this->startUpdate(request, data, len, total, headerLength)) {
+                return;
+            }
+            
+            // A dropped connection leaves a partial image behind
+            this->onRelease(request, [this, request]() {
+                if (this->session.request == request && this->session.active) {
+                    this->abortUpdate("Connection lost");
+                }
+            });
+            
+            metrics.otaBytesReceived += headerLength;
+            data += headerLength;
+            len -= headerLength;
+        } else if (this->session.request != request || !this->session.active) {
+            return;
+        }
+        
+        this->receiveChunk(data, len);
+        
+        if (last && this->session.active) {
+            this->finishUpdate();
+        }
+    });
     
-    // Set authentication
-    ElegantOTA.setAuth("admin", "admin123");
+    // Web asset manifest (lists the files that differ, optionally prunes stale ones)
+    AsyncCallbackJsonWebHandler* manifestHandler = new AsyncCallbackJsonWebHandler("/ota/fs/manifest", [this](AsyncWebServerRequest *request, JsonVariant &json) {
+        this->handleManifest(request, json);
+    }, 8192);
+    server->addHandler(manifestHandler);
     
-    // Add security middleware to OTA endpoints
-    server->on("/update", HTTP_GET, [this](AsyncWebServerRequest *request) {
+    // Web asset upload: the file is the raw request body, ?path= names it
+    server->on("/ota/fs/file", HTTP_POST, [this](AsyncWebServerRequest *request) {
+        // Any other type is parsed as form data and never reaches the body handler
+        if (!isBinaryBody(request)) {
+            sendError(request, 415, "Content-Type must be application/octet-stream");
+            return;
+        }
+        
         // Check if OTA is enabled
         if (!this->otaEnabled) {
-            request->send(403, "text/plain", "OTA updates are disabled");
+            sendError(request, 403, "OTA updates are disabled");
             return;
         }
         
-        // Check if user is authenticated as admin
-        if (!request->authenticate("admin", "admin123")) {
-            return request->requestAuthentication();
+        // Check if user is admin
+        if (!this->sessionManager->adminMiddleware(request, this->userManager)) {
+            sendError(request, 403, "Admin permission required");
+            return;
         }
         
-        // Allow access to OTA update page
-        request->send(200, "text/html", "<html><head><title>ESP32 OTA Update</title></head><body><h1>ESP32 OTA Update</h1><div id='ota-update'></div><script src='/ElegantOTA.js'></script></body></html>");
+        if (request->contentLength() == 0) {
+            sendError(request, 400, "File content is required");
+            return;
+        }
+        
+        // The body went to another upload
+        if (this->fsUpload.request != request) {
+            sendError(request, 409, "Another upload is in progress");
+            return;
+        }
+        
+        if (this->fsUpload.error != nullptr) {
+            sendError(request, 400, this->fsUpload.error);
+            return;
+        }
+        
+        request->send(200, "application/json", "{\"success\":true,\"message\":\"File updated\"}");
+    }, nullptr, [this](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+        if (index == 0) {
+            // One upload at a time, admins only
+            if (!isBinaryBody(request) || !this->otaEnabled || this->fsUpload.active || !this->sessionManager->adminMiddleware(request, this->userManager)) {
+                return;
+            }
+            
+            if (!this->startFileUpload(request)) {
+                return;
+            }
+            
+            // A dropped connection leaves a partial file behind
+            this->onRelease(request, [this, request]() {
+                if (this->fsUpload.request == request && this->fsUpload.active) {
+                    this->abortFileUpload("Connection lost");
+                }
+            });
+        } else if (this->fsUpload.request != request || !this->fsUpload.active) {
+            return;
+        }
+        
+        mbedtls_sha256_update(&this->fsUpload.sha, data, len);
+        if (this->fsUpload.file.write(data, len) != len) {
+            this->abortFileUpload("Failed to write file");
+            return;
+        }
+        
+        if (index + len == total) {
+            this->finishFileUpload();
+        }
     });
     
     Serial.println("OTA manager initialized");
 }
 
+// Compare a web asset manifest with the file system, optionally removing stale assets
+void OtaManager::handleManifest(AsyncWebServerRequest* request, JsonVariant& json) {
+    // Check if OTA is enabled
+    if (!otaEnabled) {
+        sendError(request, 403, "OTA updates are disabled");
+        return;
+    }
+    
+    // Check if user is admin
+    if (!sessionManager->adminMiddleware(request, userManager)) {
+        sendError(request, 403, "Admin permission required");
+        return;
+    }
+    
+    JsonArray files = json["files"].as<JsonArray>();
+    if (files.isNull()) {
+        sendError(request, 400, "File list is required");
+        return;
+    }
+    
+    DynamicJsonDocument doc(4096);
+    doc["success"] = true;
+    JsonArray needed = doc.createNestedArray("needed");
+    
+    // Files that are missing or differ
+    for (JsonObject entry : files) {
+        String path = entry["path"] | "";
+        uint8_t expected[32];
+        uint8_t actual[32];
+        if (!isAssetPath(path) || !parseDigest(entry["sha256"] | "", expected)) {
+            sendError(request, 400, "Invalid manifest entry");
+            return;
+        }
+        
+        if (!hashFile(path, actual) || memcmp(expected, actual, sizeof(actual)) != 0) {
+            needed.add(path);
+        }
+    }
+    
+    // Stale assets are only removed once nothing is missing, so a page is
+    // never left pointing at a file that is gone
+    if ((json["prune"] | false) && needed.size() == 0) {
+        JsonArray removed = doc.createNestedArray("removed");
+        for (const char* dir : assetDirs) {
+            pruneAssets(dir, files, removed);
+        }
+    }
+    
+    String response;
+    serializeJson(doc, response);
+    request->send(200, "application/json", response);
+}
+
+// Start receiving a web asset, returns false (with fsUpload.error set) if it can't
+bool OtaManager::startFileUpload(AsyncWebServerRequest* request) {
+    fsUpload.request = request;
+    fsUpload.error = nullptr;
+    fsUpload.path = request->hasParam("path") ? request->getParam("path")->value() : "";
+    
+    if (!isAssetPath(fsUpload.path)) {
+        fsUpload.error = "Not a web asset path";
+        return false;
+    }
+    
+    if (!request->hasHeader("X-File-SHA256") || !parseDigest(request->getHeader("X-File-SHA256")->value(), fsUpload.expectedDigest)) {
+        fsUpload.error = "Missing or invalid X-File-SHA256 header";
+        return false;
+    }
+    
+    // The current file keeps being served until the new one is verified
+    fsUpload.file = LittleFS.open(fsUpload.path + ".tmp", FILE_WRITE, true);
+    if (!fsUpload.file) {
+        fsUpload.error = "Failed to create file";
+        return false;
+    }
+    
+    mbedtls_sha256_init(&fsUpload.sha);
+    mbedtls_sha256_starts(&fsUpload.sha, 0);
+    fsUpload.active = true;
+    return true;
+}
+
+// Check the digest and move the file into place
+void OtaManager::finishFileUpload() {
+    size_t size = fsUpload.file.size();
+    fsUpload.file.close();
+    
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&fsUpload.sha, digest);
+    if (memcmp(digest, fsUpload.expectedDigest, sizeof(digest)) != 0) {
+        abortFileUpload("SHA-256 mismatch");
+        return;
+    }
+    
+    // Rename replaces the old file in one step
+    String tempPath = fsUpload.path + ".tmp";
+    if (!LittleFS.rename(tempPath, fsUpload.path)) {
+        LittleFS.remove(fsUpload.path);
+        if (!LittleFS.rename(tempPath, fsUpload.path)) {
+            abortFileUpload("Failed to replace file");
+            return;
+        }
+    }
+    
+    mbedtls_sha256_free(&fsUpload.sha);
+    fsUpload.active = false;
+    metrics.otaFsFilesWritten++;
+    metrics.otaFsBytesWritten += size;
+    
+    Serial.printf("Web asset updated: %s (%u bytes)\n", fsUpload.path.c_str(), (unsigned)size);
+}
+
+// Abort the file upload and remove the partial file
+void OtaManager::abortFileUpload(const char* error) {
+    if (!fsUpload.active) {
+        return;
+    }
+    
+    fsUpload.error = error;
+    fsUpload.file.close();
+    mbedtls_sha256_free(&fsUpload.sha);
+    LittleFS.remove(fsUpload.path + ".tmp");
+    fsUpload.active = false;
+    
+    Serial.printf("Web asset update failed (%s): %s\n", fsUpload.path.c_str(), error);
+}
+
+// Remove assets in a directory that are not in the manifest
+void OtaManager::pruneAssets(const char* dir, JsonArray files, JsonArray removed) {
+    File root = LittleFS.open(dir);
+    if (!root || !root.isDirectory()) {
+        return;
+    }
+    
+    // Collect first, removing while iterating would skip entries
+    std::vector<String> stale;
+    File entry = root.openNextFile();
+    while (entry) {
+        String path = entry.path();
+        bool listed = false;
+        for (JsonObject file : files) {
+            if (file["path"] == path) {
+                listed = true;
+                break;
+            }
+        }
+        if (!entry.isDirectory() && !listed) {
+            stale.push_back(path);
+        }
+        entry.close();
+        entry = root.openNextFile();
+    }
+    root.close();
+    
+    for (const String& path : stale) {
+        if (LittleFS.remove(path)) {
+            removed.add(path);
+            Serial.printf("Web asset removed: %s\n", path.c_str());
+        }
+    }
+}
+
+// Whether a path is a web asset that may be replaced
+bool OtaManager::isAssetPath(const String& path) {
+    if (!path.startsWith("/") || path.indexOf("..") >= 0 || path.endsWith(".tmp")) {
+        return false;
+    }
+    
+    for (const char* dir : assetDirs) {
+        if (path.startsWith(String(dir) + "/")) {
+            return true;
+        }
+    }
+    
+    // Pages, stored gzipped in the root
+    return path.lastIndexOf('/') == 0 && path.endsWith(".html.gz");
+}
+
+// Whether the request body is sent as application/octet-stream
+bool OtaManager::isBinaryBody(AsyncWebServerRequest* request) {
+    return request->contentType().equalsIgnoreCase("application/octet-stream");
+}
+
+// SHA-256 of a file, returns false if it can't be read
+bool OtaManager::hashFile(const String& path, uint8_t* digest) {
+    if (!LittleFS.exists(path)) {
+        return false;
+    }
+    
+    File file = LittleFS.open(path, FILE_READ);
+    if (!file) {
+        return false;
+    }
+    
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    
+    uint8_t buffer[512];
+    size_t read;
+    while ((read = file.read(buffer, sizeof(buffer))) > 0) {
+        mbedtls_sha256_update(&sha, buffer, read);
+    }
+    file.close();
+    
+    mbedtls_sha256_finish(&sha, digest);
+    mbedtls_sha256_free(&sha);
+    return true;
+}
+
+// Send a JSON error response
+void OtaManager::sendError(AsyncWebServerRequest* request, int code, const char* message) {
+    request->send(code, "application/json", "{\"success\":false,\"message\":\"" + String(message) + "\"}");
+}
+
+// Start an update from the first chunk, returns false (with session.error set) if it can't;
+// headerLength is set to the bytes preceding the image (gzip header)
+bool OtaManager::startUpdate(AsyncWebServerRequest* request, const uint8_t* data, size_t len, size_t total, size_t& headerLength) {
+    session.request = request;
+    session.error = nullptr;
+    session.compressed = len >= 2 && data[0] == 0x1f && data[1] == 0x8b;
+    session.inflateDone = false;
+    session.windowPos = 0;
+    session.startMillis = millis();
+    mbedtls_sha256_init(&session.sha);
+    mbedtls_sha256_starts(&session.sha, 0);
+    session.active = true;
+    
+    metrics.otaInProgress = true;
+    metrics.otaBytesTotal = total;
+    metrics.otaBytesWritten = 0;
+    metrics.otaThroughputBps = 0;
+    
+    // Digest of the (uncompressed) image
+    if (!request->hasHeader("X-Firmware-SHA256") || !parseDigest(request->getHeader("X-Firmware-SHA256")->value(), session.expectedDigest)) {
+        abortUpdate("Missing or invalid X-Firmware-SHA256 header");
+        return false;
+    }
+    
+    headerLength = 0;
+    if (session.compressed) {
+        headerLength = gzipHeaderLength(data, len);
+        if (headerLength == 0) {
+            abortUpdate("Invalid gzip header");
+            return false;
+        }
+        
+        // Inflate state and its 32 KB dictionary, only held during the update
+        session.inflator = (tinfl_decompressor*)malloc(sizeof(tinfl_decompressor));
+        session.window = (uint8_t*)malloc(TINFL_LZ_DICT_SIZE);
+        if (session.inflator == nullptr || session.window == nullptr) {
+            abortUpdate("Not enough memory to inflate the image");
+            return false;
+        }
+        tinfl_init(session.inflator);
+    } else if (len == 0 || data[0] != ESP_IMAGE_MAGIC) {
+        abortUpdate("Not a firmware image");
+        return false;
+    }
+    
+    // The inflated size is only known at the end
+    if (!Update.begin(session.compressed ? UPDATE_SIZE_UNKNOWN : total, U_FLASH)) {
+        abortUpdate(Update.errorString());
+        return false;
+    }
+    
+    Serial.printf("OTA update started (%u bytes%s)\n", (unsigned)total, session.compressed ? ", compressed" : "");
+    return true;
+}
+
+// Feed a chunk of the upload
+void OtaManager::receiveChunk(uint8_t* data, size_t len) {
+    metrics.otaBytesReceived += len;
+    uint32_t elapsed = millis() - session.startMillis;
+    if (elapsed > 0) {
+        metrics.otaThroughputBps = (uint64_t)metrics.otaBytesReceived.load() * 1000 / elapsed;
+    }
+    
+    if (!session.compressed) {
+        writeImage(data, len);
+        return;
+    }
+    
+    // Inflate until the chunk is used up and all pending output is written;
+    // anything after the deflate stream is the gzip trailer
+    while (!session.inflateDone) {
+        size_t inBytes = len;
+        size_t outBytes = TINFL_LZ_DICT_SIZE - session.windowPos;
+        tinfl_status status = tinfl_decompress(session.inflator, data, &inBytes,
+                                               session.window, session.window + session.windowPos, &outBytes,
+                                               TINFL_FLAG_HAS_MORE_INPUT);
+        data += inBytes;
+        len -= inBytes;
+        
+        // The window wraps, earlier output stays available as dictionary
+        if (outBytes > 0) {
+            writeImage(session.window + session.windowPos, outBytes);
+            session.windowPos = (session.windowPos + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+        }
+        
+        if (!session.active) {
+            return;
+        }
+        
+        if (status == TINFL_STATUS_DONE) {
+            session.inflateDone = true;
+        } else if (status < TINFL_STATUS_DONE) {
+            abortUpdate("Corrupt compressed image");
+            return;
+        } else if (status == TINFL_STATUS_NEEDS_MORE_INPUT) {
+            return;
+        }
+    }
+}
+
+// Write image bytes to the update partition and the digest
+void OtaManager::writeImage(const uint8_t* data, size_t len) {
+    mbedtls_sha256_update(&session.sha, data, len);
+    
+    if (Update.write((uint8_t*)data, len) != len) {
+        abortUpdate(Update.errorString());
+        return;
+    }
+    
+    metrics.otaBytesWritten += len;
+}
+
+// Check the digest and activate the new partition
+void OtaManager::finishUpdate() {
+    if (session.compressed && !session.inflateDone) {
+        abortUpdate("Truncated compressed image");
+        return;
+    }
+    
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&session.sha, digest);
+    if (memcmp(digest, session.expectedDigest, sizeof(digest)) != 0) {
+        abortUpdate("SHA-256 mismatch");
+        return;
+    }
+    
+    // Verifies the image and switches the boot partition
+    if (!Update.end(true)) {
+        abortUpdate(Update.errorString());
+        return;
+    }
+    
+    uint32_t duration = millis() - session.startMillis;
+    metrics.otaUpdatesSucceeded++;
+    metrics.otaInProgress = false;
+    releaseSession();
+    
+    Serial.printf("OTA update complete: %u bytes written in %u ms\n", metrics.otaBytesWritten.load(), duration);
+    
+    // Leave time for the response to go out
+    rebootAtMillis = millis() + 1000;
+}
+
+// Abort the update and release its buffers
+void OtaManager::abortUpdate(const char* error) {
+    if (!session.active) {
+        return;
+    }
+    
+    session.error = error;
+    Update.abort();
+    metrics.otaUpdatesFailed++;
+    metrics.otaInProgress = false;
+    releaseSession();
+    
+    Serial.printf("OTA update failed: %s\n", error);
+}
+
+// Release the session buffers
+void OtaManager::releaseSession() {
+    mbedtls_sha256_free(&session.sha);
+    free(session.inflator);
+    free(session.window);
+    session.inflator = nullptr;
+    session.window = nullptr;
+    session.active = false;
+}
+
+// Run a handler once the request's connection is released
+void OtaManager::onRelease(AsyncWebServerRequest* request, ArDisconnectHandler handler) {
+    // The admission layer already holds the request's only disconnect handler
+    if (admissionControl != nullptr) {
+        admissionControl->onRelease(request, handler);
+    } else {
+        request->onDisconnect(handler);
+    }
+}
+
+// Skip the gzip header, returns its length or 0 if it is invalid
+size_t OtaManager::gzipHeaderLength(const uint8_t* data, size_t len) {
+    // Magic, deflate method, flags, mtime, xfl, os
+    if (len < 10 || data[0] != 0x1f || data[1] != 0x8b || data[2] != 8) {
+        return 0;
+    }
+    
+    uint8_t flags = data[3];
+    size_t pos = 10;
+    
+    // FEXTRA
+    if (flags & 0x04) {
+        if (pos + 2 > len) {
+            return 0;
+        }
+        pos += 2 + (data[pos] | (data[pos + 1] << 8));
+    }
+    
+    // FNAME and FCOMMENT, zero terminated
+    for (uint8_t flag : {0x08, 0x10}) {
+        if (flags & flag) {
+            while (pos < len && data[pos] != 0) {
+                pos++;
+            }
+            pos++;
+        }
+    }
+    
+    // FHCRC
+    if (flags & 0x02) {
+        pos += 2;
+    }
+    
+    // The whole header has to be in the first chunk
+    return pos <= len ? pos : 0;
+}
+
+// Parse a hex SHA-256 digest
+bool OtaManager::parseDigest(const String& hex, uint8_t* digest) {
+    if (hex.length() != 64) {
+        return false;
+    }
+    
+    for (size_t i = 0; i < 32; i++) {
+        char byteText[3] = {hex[i * 2], hex[i * 2 + 1], 0};
+        if (!isxdigit(byteText[0]) || !isxdigit(byteText[1])) {
+            return false;
+        }
+        digest[i] = strtoul(byteText, nullptr, 16);
+    }
+    
+    return true;
+}
+
 // Enable/disable OTA updates
 void OtaManager::setEnabled(bool enabled) {
     this->otaEnabled = enabled;
@@ -47,5 +645,10 @@ bool OtaManager::isEnabled() {
 
 // Handle OTA requests (must be called in loop)
 void OtaManager::handle() {
-    ElegantOTA.loop();
+    // Restart into the new firmware once the response is out
+    if (rebootAtMillis != 0 && (int32_t)(millis() - rebootAtMillis) >= 0) {
+        Serial.println("Restarting into the new firmware");
+        delay(100);
+        ESP.restart();
+    }
 }
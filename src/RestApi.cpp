@@ -1,4 +1,8 @@
 #include "../include/RestApi.h"
+#include "../include/AlexaManager.h"
+#include "../include/Metrics.h"
+#include "../include/TaskProfiler.h"
+#include "../include/LoopMonitor.h"
 
 // Constructor
 RestApi::RestApi(AsyncWebServer* server, UserManager* userManager, DeviceManager* deviceManager, SessionManager* sessionManager) {
@@ -13,6 +17,21 @@ void RestApi::begin() {
     setupRoutes();
 }
 
+// Set the Alexa manager notified of device configuration changes
+void RestApi::setAlexaManager(AlexaManager* alexaManager) {
+    this->alexaManager = alexaManager;
+}
+
+// Set the WiFi manager reporting connection statistics
+void RestApi::setWiFiManager(WiFiManager* wifiManager) {
+    this->wifiManager = wifiManager;
+}
+
+// Set the control plane that applies device changes
+void RestApi::setControlPlane(ControlPlane* controlPlane) {
+    this->controlPlane = controlPlane;
+}
+
 // Setup API routes
 void RestApi::setupRoutes() {
     // Login endpoint
@@ -31,12 +50,52 @@ void RestApi::setupRoutes() {
         this->handleGetDevices(request);
     });
     
+    // Toggle device endpoint, MessagePack body (registered first so the filter
+    // picks it before the JSON handler)
+    server->on("/api/devices/toggle", HTTP_POST, [this](AsyncWebServerRequest *request) {
+        this->handleMsgPackBody(request, &RestApi::handleToggleDevice);
+    }, nullptr, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+        // Accumulate the body, freed together with the request
+        if (index == 0 && total <= 1024) {
+            request->_tempObject = malloc(total);
+        }
+        if (request->_tempObject != nullptr) {
+            memcpy(static_cast<uint8_t*>(request->_tempObject) + index, data, len);
+        }
+    }).setFilter([](AsyncWebServerRequest *request) {
+        return request->contentType().equalsIgnoreCase("application/msgpack");
+    });
+    
     // Toggle device endpoint
     AsyncCallbackJsonWebHandler* toggleHandler = new AsyncCallbackJsonWebHandler("/api/devices/toggle", [this](AsyncWebServerRequest *request, JsonVariant &json) {
         this->handleToggleDevice(request, json);
     });
     server->addHandler(toggleHandler);
     
+    // Dimmer level endpoint
+    AsyncCallbackJsonWebHandler* levelHandler = new AsyncCallbackJsonWebHandler("/api/devices/level", [this](AsyncWebServerRequest *request, JsonVariant &json) {
+        this->handleSetLevel(request, json);
+    });
+    server->addHandler(levelHandler);
+    
+    // Add device endpoint (admin only)
+    AsyncCallbackJsonWebHandler* addDeviceHandler = new AsyncCallbackJsonWebHandler("/api/devices/add", [this](AsyncWebServerRequest *request, JsonVariant &json) {
+        this->handleAddDevice(request, json);
+    });
+    server->addHandler(addDeviceHandler);
+    
+    // Update device endpoint (admin only)
+    AsyncCallbackJsonWebHandler* updateDeviceHandler = new AsyncCallbackJsonWebHandler("/api/devices/update", [this](AsyncWebServerRequest *request, JsonVariant &json) {
+        this->handleUpdateDevice(request, json);
+    });
+    server->addHandler(updateDeviceHandler);
+    
+    // Delete device endpoint (admin only)
+    AsyncCallbackJsonWebHandler* deleteDeviceHandler = new AsyncCallbackJsonWebHandler("/api/devices/delete", [this](AsyncWebServerRequest *request, JsonVariant &json) {
+        this->handleDeleteDevice(request, json);
+    });
+    server->addHandler(deleteDeviceHandler);
+    
     // Get users endpoint (admin only)
     server->on("/api/users", HTTP_GET, [this](AsyncWebServerRequest *request) {
         this->handleGetUsers(request);
@@ -60,10 +119,33 @@ void RestApi::setupRoutes() {
     });
     server->addHandler(deleteUserHandler);
     
+    // Wi-Fi power-save policy endpoint (admin only)
+    AsyncCallbackJsonWebHandler* wifiPowerHandler = new AsyncCallbackJsonWebHandler("/api/wifi/power", [this](AsyncWebServerRequest *request, JsonVariant &json) {
+        this->handleSetWiFiPower(request, json);
+    });
+    server->addHandler(wifiPowerHandler);
+    
+    // Bootstrap endpoint (identity, status and devices in one response)
+    server->on("/api/bootstrap", HTTP_GET, [this](AsyncWebServerRequest *request) {
+        this->handleBootstrap(request);
+    });
+    
     // Get system status endpoint
     server->on("/api/status", HTTP_GET, [this](AsyncWebServerRequest *request) {
         this->handleGetStatus(request);
     });
+    
+    // Metrics endpoint (Prometheus text format). Deliberately public so a
+    // scraper can read it without a session; it only carries counters,
+    // latencies, heap and stack figures, no network or user details.
+    server->on("/api/metrics", HTTP_GET, [this](AsyncWebServerRequest *request) {
+        this->handleGetMetrics(request);
+    });
+    
+    // Task profiler endpoint (CPU share and stack headroom per task)
+    server->on("/api/tasks", HTTP_GET, [this](AsyncWebServerRequest *request) {
+        this->handleGetTasks(request);
+    });
 }
 
 // API handlers
@@ -119,33 +201,28 @@ void RestApi::handleLogout(AsyncWebServerRequest *request) {
 }
 
 void RestApi::handleGetDevices(AsyncWebServerRequest *request) {
-    // Check authentication
-    if (!sessionManager->authMiddleware(request, userManager)) {
+    // Check authentication and get username from session
+    String username = sessionManager->getSessionUsername(request);
+    if (username.length() == 0) {
         request->send(401, "application/json", "{\"success\":false,\"message\":\"Unauthorized\"}");
         return;
     }
     
-    // Get username from session
-    String cookie = request->getHeader("Cookie")->value();
-    int sessionStart = cookie.indexOf("session=");
-    sessionStart += 8;  // Length of "session="
-    int sessionEnd = cookie.indexOf(";", sessionStart);
-    if (sessionEnd == -1) {
-        sessionEnd = cookie.length();
-    }
-    
-    String sessionId = cookie.substring(sessionStart, sessionEnd);
-    String username = sessionManager->getUsernameFromSession(sessionId);
+    // Create JSON response
+    DynamicJsonDocument doc(4096);
+    addDevices(doc.createNestedArray("devices"), username);
     
+    // Send response
+    sendDocument(request, 200, doc);
+}
+
+// Add the devices visible to a user, with their permissions
+void RestApi::addDevices(JsonArray devicesArray, const String& username) {
     // Get user role
     UserRole role = userManager->getUserRole(username);
     
-    // Create JSON response
-    DynamicJsonDocument doc(4096);
-    JsonArray devicesArray = doc.createNestedArray("devices");
-    
     // Add devices to response
-    for (Device& device : deviceManager->getAllDevices()) {
+    for (const Device& device : deviceManager->getAllDevices()) {
         // Check if user can control this device
         bool canControl = (role == UserRole::ADMIN) || userManager->canControlDevice(username, device.channel);
         bool state = device.outputState[0];
@@ -156,12 +233,28 @@ void RestApi::handleGetDevices(AsyncWebServerRequest *request) {
         deviceObj["state"] = state;
         deviceObj["canControl"] = canControl;
         deviceObj["alexaEnabled"] = device.alexaEnabled;
+        if (device.type == DeviceType::DIMMER) {
+            deviceObj["type"] = "dimmer";
+            deviceObj["level"] = device.level;
+        } else {
+            deviceObj["type"] = "relay";
+        }
+        
+        // Admins also get the wiring so devices can be edited
+        if (role == UserRole::ADMIN) {
+            deviceObj["alexaName"] = device.alexaName;
+            
+            JsonArray inputPinsArray = deviceObj.createNestedArray("inputPins");
+            for (int pin : device.inputPins) {
+                inputPinsArray.add(pin);
+            }
+            
+            JsonArray outputPinsArray = deviceObj.createNestedArray("outputPins");
+            for (int pin : device.outputPins) {
+                outputPinsArray.add(pin);
+            }
+        }
     }
-    
-    // Send response
-    String response;
-    serializeJson(doc, response);
-    request->send(200, "application/json", response);
 }
 
 void RestApi::handleToggleDevice(AsyncWebServerRequest *request, JsonVariant &json) {
@@ -169,31 +262,262 @@ void RestApi::handleToggleDevice(AsyncWebServerRequest *request, JsonVariant &js
     
     // Check if channel is provided
     if (!jsonObj.containsKey("channel")) {
-        request->send(400, "application/json", "{\"success\":false,\"message\":\"Channel is required\"}");
+        sendMessage(request, 400, false, "Channel is required");
         return;
     }
     
     int channel = jsonObj["channel"].as<int>();
-    bool state = jsonObj.containsKey("state") ? jsonObj["state"].as<bool>() : -1;
     
     // Check if device exists
-    Device* device = deviceManager->getDeviceByChannel(channel);
-    if (device == nullptr) {
-        request->send(404, "application/json", "{\"success\":false,\"message\":\"Device not found\"}");
+    if (!deviceManager->hasDevice(channel)) {
+        sendMessage(request, 404, false, "Device not found");
         return;
     }
     
     // Check if user can control this device
     if (!sessionManager->deviceControlMiddleware(request, userManager, channel)) {
-        request->send(403, "application/json", "{\"success\":false,\"message\":\"Permission denied\"}");
+        sendMessage(request, 403, false, "Permission denied");
         return;
     }
     
-    // Toggle device
-    if (deviceManager->toggleDevice(channel, state)) {
-        request->send(200, "application/json", "{\"success\":true,\"message\":\"Device toggled\"}");
+    // Queue the command (without a state the device is toggled); the
+    // control plane switches the output, the state event follows
+    bool queued = jsonObj.containsKey("state") ? controlPlane->setState(channel, jsonObj["state"].as<bool>()) : controlPlane->toggle(channel);
+    if (queued) {
+        sendMessage(request, 200, true, "Device toggled");
     } else {
-        request->send(500, "application/json", "{\"success\":false,\"message\":\"Failed to toggle device\"}");
+        sendMessage(request, 503, false, "Device control is busy");
+    }
+}
+
+void RestApi::handleSetLevel(AsyncWebServerRequest *request, JsonVariant &json) {
+    JsonObject jsonObj = json.as<JsonObject>();
+    
+    // Check if channel and level are provided
+    if (!jsonObj.containsKey("channel") || !jsonObj.containsKey("level")) {
+        sendMessage(request, 400, false, "Channel and level are required");
+        return;
+    }
+    
+    int channel = jsonObj["channel"].as<int>();
+    int level = jsonObj["level"].as<int>();
+    int fadeMs = jsonObj["fadeMs"] | (int)DeviceManager::DIMMER_DEFAULT_FADE_MS;
+    if (level < 0 || level > 255 || fadeMs < 0 || fadeMs > DeviceManager::DIMMER_MAX_FADE_MS) {
+        sendMessage(request, 400, false, "Level must be 0-255 and fadeMs 0-10000");
+        return;
+    }
+    
+    // Check if device exists and is a dimmer
+    Device device;
+    if (!deviceManager->getDevice(channel, device)) {
+        sendMessage(request, 404, false, "Device not found");
+        return;
+    }
+    if (device.type != DeviceType::DIMMER) {
+        sendMessage(request, 400, false, "Device is not a dimmer");
+        return;
+    }
+    
+    // Check if user can control this device
+    if (!sessionManager->deviceControlMiddleware(request, userManager, channel)) {
+        sendMessage(request, 403, false, "Permission denied");
+        return;
+    }
+    
+    // Queue the level, the control plane starts the fade
+    if (controlPlane->setLevel(channel, level, fadeMs)) {
+        sendMessage(request, 200, true, "Level set");
+    } else {
+        sendMessage(request, 503, false, "Device control is busy");
+    }
+}
+
+void RestApi::handleAddDevice(AsyncWebServerRequest *request, JsonVariant &json) {
+    // Check if user is admin
+    if (!sessionManager->adminMiddleware(request, userManager)) {
+        request->send(403, "application/json", "{\"success\":false,\"message\":\"Admin permission required\"}");
+        return;
+    }
+    
+    JsonObject jsonObj = json.as<JsonObject>();
+    
+    // Check if required fields are provided
+    if (!jsonObj.containsKey("channel") || !jsonObj.containsKey("name") || !jsonObj.containsKey("outputPins")) {
+        request->send(400, "application/json", "{\"success\":false,\"message\":\"Channel, name, and output pins are required\"}");
+        return;
+    }
+    
+    Device device;
+    device.channel = jsonObj["channel"].as<int>();
+    device.alexaEnabled = false;
+    parseDevice(jsonObj, device);
+    
+    // Check if device already exists
+    if (deviceManager->hasDevice(device.channel)) {
+        request->send(409, "application/json", "{\"success\":false,\"message\":\"Device already exists\"}");
+        return;
+    }
+    
+    // Validate pins and add the device on the control plane, which owns the device list
+    String error;
+    bool added = controlPlane->call([&]() {
+        return deviceManager->validateDevice(device, device.channel, error) && deviceManager->addDevice(device);
+    });
+    if (!added && error.length() > 0) {
+        DynamicJsonDocument doc(256);
+        doc["success"] = false;
+        doc["message"] = error;
+        String response;
+        serializeJson(doc, response);
+        request->send(400, "application/json", response);
+        return;
+    }
+    
+    if (!added) {
+        request->send(500, "application/json", "{\"success\":false,\"message\":\"Failed to add device\"}");
+        return;
+    }
+    
+    // Register only this device with Alexa
+    if (alexaManager != nullptr) {
+        alexaManager->addOrUpdateDevice(device.channel);
+    }
+    
+    request->send(200, "application/json", "{\"success\":true,\"message\":\"Device added\"}");
+}
+
+void RestApi::handleUpdateDevice(AsyncWebServerRequest *request, JsonVariant &json) {
+    // Check if user is admin
+    if (!sessionManager->adminMiddleware(request, userManager)) {
+        request->send(403, "application/json", "{\"success\":false,\"message\":\"Admin permission required\"}");
+        return;
+    }
+    
+    JsonObject jsonObj = json.as<JsonObject>();
+    
+    // Check if channel is provided
+    if (!jsonObj.containsKey("channel")) {
+        request->send(400, "application/json", "{\"success\":false,\"message\":\"Channel is required\"}");
+        return;
+    }
+    
+    int channel = jsonObj["channel"].as<int>();
+    
+    // Start from the current configuration so partial updates keep other fields;
+    // read, validated and applied on the control plane, which owns the device list
+    String error;
+    bool found = true;
+    bool updated = controlPlane->call([&]() {
+        Device device;
+        if (!deviceManager->getDevice(channel, device)) {
+            found = false;
+            return false;
+        }
+        
+        parseDevice(jsonObj, device);
+        device.channel = channel;
+        return deviceManager->validateDevice(device, channel, error) && deviceManager->updateDevice(channel, device);
+    });
+    
+    if (!found) {
+        request->send(404, "application/json", "{\"success\":false,\"message\":\"Device not found\"}");
+        return;
+    }
+    
+    if (!updated && error.length() > 0) {
+        DynamicJsonDocument doc(256);
+        doc["success"] = false;
+        doc["message"] = error;
+        String response;
+        serializeJson(doc, response);
+        request->send(400, "application/json", response);
+        return;
+    }
+    
+    if (!updated) {
+        request->send(500, "application/json", "{\"success\":false,\"message\":\"Failed to update device\"}");
+        return;
+    }
+    
+    // Update only this device in Alexa
+    if (alexaManager != nullptr) {
+        alexaManager->addOrUpdateDevice(channel);
+    }
+    
+    request->send(200, "application/json", "{\"success\":true,\"message\":\"Device updated\"}");
+}
+
+void RestApi::handleDeleteDevice(AsyncWebServerRequest *request, JsonVariant &json) {
+    // Check if user is admin
+    if (!sessionManager->adminMiddleware(request, userManager)) {
+        request->send(403, "application/json", "{\"success\":false,\"message\":\"Admin permission required\"}");
+        return;
+    }
+    
+    JsonObject jsonObj = json.as<JsonObject>();
+    
+    // Check if channel is provided
+    if (!jsonObj.containsKey("channel")) {
+        request->send(400, "application/json", "{\"success\":false,\"message\":\"Channel is required\"}");
+        return;
+    }
+    
+    int channel = jsonObj["channel"].as<int>();
+    
+    // Delete device (on the control plane)
+    if (!controlPlane->call([&]() { return deviceManager->deleteDevice(channel); })) {
+        request->send(404, "application/json", "{\"success\":false,\"message\":\"Device not found\"}");
+        return;
+    }
+    
+    // Remove only this device from Alexa
+    if (alexaManager != nullptr) {
+        alexaManager->removeDevice(channel);
+    }
+    
+    request->send(200, "application/json", "{\"success\":true,\"message\":\"Device deleted\"}");
+}
+
+// Fill a device from a JSON body, keeping fields that are not present
+void RestApi::parseDevice(JsonObject jsonObj, Device& device) {
+    if (jsonObj.containsKey("name")) {
+        device.name = jsonObj["name"].as<std::string>();
+    }
+    
+    if (jsonObj.containsKey("alexaName")) {
+        device.alexaName = jsonObj["alexaName"].as<std::string>();
+    } else if (device.alexaName.empty()) {
+        device.alexaName = device.name;
+    }
+    
+    if (jsonObj.containsKey("alexaEnabled")) {
+        device.alexaEnabled = jsonObj["alexaEnabled"].as<bool>();
+    }
+    
+    if (jsonObj.containsKey("type")) {
+        device.type = jsonObj["type"] == "dimmer" ? DeviceType::DIMMER : DeviceType::RELAY;
+    }
+    
+    if (jsonObj.containsKey("level")) {
+        device.level = constrain(jsonObj["level"].as<int>(), 1, 255);
+    }
+    
+    // Read input pins
+    if (jsonObj.containsKey("inputPins")) {
+        device.inputPins.clear();
+        for (JsonVariant pin : jsonObj["inputPins"].as<JsonArray>()) {
+            device.inputPins.push_back(pin.as<int>());
+        }
+        device.inputState.assign(device.inputPins.size(), false);
+    }
+    
+    // Read output pins, keeping the current state when the pin count is unchanged
+    if (jsonObj.containsKey("outputPins")) {
+        device.outputPins.clear();
+        for (JsonVariant pin : jsonObj["outputPins"].as<JsonArray>()) {
+            device.outputPins.push_back(pin.as<int>());
+        }
+        device.outputState.resize(device.outputPins.size(), false);
     }
 }
 
@@ -329,6 +653,36 @@ void RestApi::handleDeleteUser(AsyncWebServerRequest *request, JsonVariant &json
     }
 }
 
+void RestApi::handleSetWiFiPower(AsyncWebServerRequest *request, JsonVariant &json) {
+    // Check if user is admin
+    if (!sessionManager->adminMiddleware(request, userManager)) {
+        request->send(403, "application/json", "{\"success\":false,\"message\":\"Admin permission required\"}");
+        return;
+    }
+    
+    if (wifiManager == nullptr) {
+        request->send(503, "application/json", "{\"success\":false,\"message\":\"WiFi not available\"}");
+        return;
+    }
+    
+    JsonObject jsonObj = json.as<JsonObject>();
+    String policy = jsonObj["policy"] | "";
+    
+    // Set policy
+    if (policy == "auto") {
+        wifiManager->setPowerPolicy(WiFiPowerPolicy::AUTO);
+    } else if (policy == "performance") {
+        wifiManager->setPowerPolicy(WiFiPowerPolicy::PERFORMANCE);
+    } else if (policy == "powersave") {
+        wifiManager->setPowerPolicy(WiFiPowerPolicy::POWER_SAVE);
+    } else {
+        request->send(400, "application/json", "{\"success\":false,\"message\":\"Policy must be auto, performance or powersave\"}");
+        return;
+    }
+    
+    request->send(200, "application/json", "{\"success\":true,\"message\":\"WiFi power policy updated\"}");
+}
+
 void RestApi::handleGetStatus(AsyncWebServerRequest *request) {
     // Check authentication
     if (!sessionManager->authMiddleware(request, userManager)) {
@@ -338,15 +692,138 @@ void RestApi::handleGetStatus(AsyncWebServerRequest *request) {
     
     // Create JSON response
     DynamicJsonDocument doc(1024);
-    doc["wifi"]["connected"] = WiFi.status() == WL_CONNECTED;
-    doc["wifi"]["ssid"] = WiFi.SSID();
-    doc["wifi"]["rssi"] = WiFi.RSSI();
-    doc["wifi"]["ip"] = WiFi.localIP().toString();
-    doc["uptime"] = millis() / 1000;
-    doc["freeHeap"] = ESP.getFreeHeap();
+    addStatus(doc.to<JsonObject>());
     
     // Send response
-    String response;
-    serializeJson(doc, response);
-    request->send(200, "application/json", response);
+    sendDocument(request, 200, doc);
+}
+
+// Add system status fields
+void RestApi::addStatus(JsonObject statusObj) {
+    statusObj["wifi"]["connected"] = WiFi.status() == WL_CONNECTED;
+    statusObj["wifi"]["ssid"] = WiFi.SSID();
+    statusObj["wifi"]["rssi"] = WiFi.RSSI();
+    statusObj["wifi"]["ip"] = WiFi.localIP().toString();
+    
+    // Supervisor state and disconnect reasons (wifi_err_reason_t codes)
+    if (wifiManager != nullptr) {
+        static const char* const stateNames[] = {"idle", "connecting", "connected", "backoff"};
+        statusObj["wifi"]["state"] = stateNames[static_cast<int>(wifiManager->getState())];
+        statusObj["wifi"]["disconnects"] = wifiManager->getDisconnectCount();
+        statusObj["wifi"]["reconnectAttempts"] = wifiManager->getReconnectAttempts();
+        
+        WiFiDisconnectCount reasons[WIFI_MAX_DISCONNECT_REASONS];
+        size_t count = wifiManager->getDisconnectReasons(reasons, WIFI_MAX_DISCONNECT_REASONS);
+        JsonObject reasonsObj = statusObj["wifi"].createNestedObject("disconnectReasons");
+        for (size_t i = 0; i < count; i++) {
+            reasonsObj[String(reasons[i].reason)] = reasons[i].count;
+        }
+        
+        // Power-save policy and the mean request latency seen in each mode
+        static const char* const policyNames[] = {"auto", "performance", "powersave"};
+        statusObj["wifi"]["powerPolicy"] = policyNames[static_cast<int>(wifiManager->getPowerPolicy())];
+        statusObj["wifi"]["powerSave"] = wifiManager->isPowerSaveActive();
+        statusObj["wifi"]["latencyUs"]["none"] = metrics.getAverageLatency(false);
+        statusObj["wifi"]["latencyUs"]["modem"] = metrics.getAverageLatency(true);
+    }
+    statusObj["uptime"] = millis() / 1000;
+    statusObj["freeHeap"] = ESP.getFreeHeap();
+}
+
+void RestApi::handleBootstrap(AsyncWebServerRequest *request) {
+    // One session lookup for everything the UI needs on page load
+    String username = sessionManager->getSessionUsername(request);
+    if (username.length() == 0) {
+        request->send(401, "application/json", "{\"success\":false,\"message\":\"Unauthorized\"}");
+        return;
+    }
+    
+    UserRole role = userManager->getUserRole(username);
+    
+    // Create JSON response
+    DynamicJsonDocument doc(5120);
+    doc["user"]["username"] = username;
+    doc["user"]["role"] = static_cast<int>(role);
+    doc["user"]["isAdmin"] = role == UserRole::ADMIN;
+    addStatus(doc.createNestedObject("status"));
+    addDevices(doc.createNestedArray("devices"), username);
+    
+    // Stream the response
+    sendDocument(request, 200, doc);
+}
+
+void RestApi::handleGetMetrics(AsyncWebServerRequest *request) {
+    // Stream the metrics straight into the response buffer
+    AsyncResponseStream *response = request->beginResponseStream("text/plain; version=0.0.4");
+    metrics.render(*response);
+    loopMonitor.render(*response);
+    request->send(response);
+}
+
+void RestApi::handleGetTasks(AsyncWebServerRequest *request) {
+    // Check authentication
+    if (!sessionManager->authMiddleware(request, userManager)) {
+        request->send(401, "application/json", "{\"success\":false,\"message\":\"Unauthorized\"}");
+        return;
+    }
+    
+    // Create JSON response
+    DynamicJsonDocument doc(4096);
+    doc["cpuAvailable"] = TaskProfiler::hasCpuStats();
+    doc["coresAvailable"] = TaskProfiler::hasCoreStats();
+    doc["windowSeconds"] = TASK_PROFILER_WINDOW * TaskProfiler::SAMPLE_PERIOD_MS / 1000;
+    taskProfiler.addTasks(doc.createNestedArray("tasks"));
+    taskProfiler.addCores(doc.createNestedArray("cores"));
+    
+    // Send response
+    sendDocument(request, 200, doc);
+}
+
+// Check if the client asked for a MessagePack response (Accept: application/msgpack)
+bool RestApi::wantsMsgPack(AsyncWebServerRequest *request) {
+    if (!request->hasHeader("Accept")) {
+        return false;
+    }
+    
+    return request->getHeader("Accept")->value().indexOf("application/msgpack") != -1;
+}
+
+// Send a document as JSON or MessagePack depending on the Accept header
+void RestApi::sendDocument(AsyncWebServerRequest *request, int code, const JsonDocument& doc) {
+    AsyncResponseStream *response;
+    if (wantsMsgPack(request)) {
+        response = request->beginResponseStream("application/msgpack");
+        serializeMsgPack(doc, *response);
+    } else {
+        response = request->beginResponseStream("application/json");
+        serializeJson(doc, *response);
+    }
+    response->setCode(code);
+    request->send(response);
+}
+
+// Send a {success, message} reply as JSON or MessagePack
+void RestApi::sendMessage(AsyncWebServerRequest *request, int code, bool success, const char* message) {
+    StaticJsonDocument<192> doc;
+    doc["success"] = success;
+    doc["message"] = message;
+    sendDocument(request, code, doc);
+}
+
+// Decode a MessagePack request body and pass it to a JSON handler
+void RestApi::handleMsgPackBody(AsyncWebServerRequest *request, void (RestApi::*handler)(AsyncWebServerRequest*, JsonVariant&)) {
+    if (request->_tempObject == nullptr) {
+        sendMessage(request, 400, false, "Invalid request body");
+        return;
+    }
+    
+    DynamicJsonDocument doc(512);
+    DeserializationError error = deserializeMsgPack(doc, static_cast<const uint8_t*>(request->_tempObject), request->contentLength());
+    if (error) {
+        sendMessage(request, 400, false, "Invalid MessagePack body");
+        return;
+    }
+    
+    JsonVariant json = doc.as<JsonVariant>();
+    (this->*handler)(request, json);
 }
@@ -69,6 +69,38 @@ String SessionManager::getUsernameFromSession(const String& sessionId) {
     return sessions[sessionId];
 }
 
+// Get session ID from the request cookie (empty if none)
+String SessionManager::getSessionId(AsyncWebServerRequest *request) {
+    // Check if request has session cookie
+    if (!request->hasHeader("Cookie")) {
+        return "";
+    }
+    
+    String cookie = request->getHeader("Cookie")->value();
+    int sessionStart = cookie.indexOf("session=");
+    if (sessionStart == -1) {
+        return "";
+    }
+    
+    sessionStart += 8;  // Length of "session="
+    int sessionEnd = cookie.indexOf(";", sessionStart);
+    if (sessionEnd == -1) {
+        sessionEnd = cookie.length();
+    }
+    
+    return cookie.substring(sessionStart, sessionEnd);
+}
+
+// Validate the request's session and return its username (empty if not authenticated)
+String SessionManager::getSessionUsername(AsyncWebServerRequest *request) {
+    String sessionId = getSessionId(request);
+    if (sessionId.length() == 0 || !validateSession(sessionId)) {
+        return "";
+    }
+    
+    return getUsernameFromSession(sessionId);
+}
+
 // Delete a session
 bool SessionManager::deleteSession(const String& sessionId) {
     // Check if session exists
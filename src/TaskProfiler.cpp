@@ -0,0 +1,409 @@
+#include "../include/TaskProfiler.h"
+#if !configGENERATE_RUN_TIME_STATS
+#include <esp_freertos_hooks.h>
+#endif
+
+// Global profiler instance
+TaskProfiler taskProfiler;
+
+#if !configGENERATE_RUN_TIME_STATS
+// Idle loop iterations of each core, counted by the idle hooks
+static volatile uint32_t idleCount[TASK_PROFILER_CORES];
+
+// Count an idle loop iteration of a core. The idle task keeps spinning
+// instead of waiting for an interrupt, so the count grows with idle time
+// rather than with the number of interrupts
+static bool countIdle(int core) {
+    idleCount[core]++;
+    return false;
+}
+
+// Idle hook of core 0
+static bool idleHookCore0() {
+    return countIdle(0);
+}
+
+#if TASK_PROFILER_CORES > 1
+// Idle hook of core 1
+static bool idleHookCore1() {
+    return countIdle(1);
+}
+#endif
+#endif
+
+// Constructor
+TaskProfiler::TaskProfiler() {
+    this->mutex = nullptr;
+    this->taskHandle = nullptr;
+    this->lastTotalRunTime = 0;
+    
+    for (TaskProfile& profile : profiles) {
+        profile.handle = nullptr;
+    }
+
+#if !configGENERATE_RUN_TIME_STATS
+    this->lastCoreSampleTick = 0;
+    this->coreNext = 0;
+    this->coreSamples = 0;
+    for (int core = 0; core < TASK_PROFILER_CORES; core++) {
+        this->lastIdleCount[core] = 0;
+        this->idleRate[core] = 0;
+    }
+#endif
+}
+
+// Start sampling
+bool TaskProfiler::begin() {
+    if (taskHandle != nullptr) {
+        return true;
+    }
+    
+    mutex = xSemaphoreCreateMutex();
+    if (mutex == nullptr) {
+        Serial.println("Failed to create profiler mutex");
+        return false;
+    }
+
+#if !configGENERATE_RUN_TIME_STATS
+    // Core loads are measured from the idle tasks instead
+    esp_register_freertos_idle_hook_for_cpu(idleHookCore0, 0);
+#if TASK_PROFILER_CORES > 1
+    esp_register_freertos_idle_hook_for_cpu(idleHookCore1, 1);
+#endif
+    calibrateCores();
+#endif
+
+    BaseType_t created = xTaskCreatePinnedToCore(
+        task,
+        "ProfilerTask",
+        3072,
+        this,
+        1,
+        &taskHandle,
+        0);
+    
+    if (created != pdPASS) {
+        Serial.println("Failed to create profiler task");
+        taskHandle = nullptr;
+        return false;
+    }
+    
+    return true;
+}
+
+// Whether CPU shares are available in this build
+bool TaskProfiler::hasCpuStats() {
+#if configGENERATE_RUN_TIME_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Whether per-core load is measured in this build (when CPU shares are not)
+bool TaskProfiler::hasCoreStats() {
+    return !hasCpuStats();
+}
+
+// Profiler task
+void TaskProfiler::task(void* parameter) {
+    TaskProfiler* profiler = static_cast<TaskProfiler*>(parameter);
+    TickType_t lastWake = xTaskGetTickCount();
+    
+    for (;;) {
+        profiler->sample();
+        profiler->readSerial();
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(SAMPLE_PERIOD_MS));
+    }
+}
+
+// Take one sample of all tasks
+void TaskProfiler::sample() {
+    // A few spare entries in case tasks are created meanwhile
+    UBaseType_t capacity = uxTaskGetNumberOfTasks() + 4;
+    TaskStatus_t* status = (TaskStatus_t*)malloc(capacity * sizeof(TaskStatus_t));
+    if (status == nullptr) {
+        return;
+    }
+    
+    uint32_t totalRunTime = 0;
+    UBaseType_t count = uxTaskGetSystemState(status, capacity, &totalRunTime);
+#if configGENERATE_RUN_TIME_STATS
+    uint32_t elapsed = totalRunTime - lastTotalRunTime;
+    lastTotalRunTime = totalRunTime;
+#endif
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    
+    for (TaskProfile& profile : profiles) {
+        profile.seen = false;
+    }
+    
+    for (UBaseType_t i = 0; i < count; i++) {
+        bool created;
+        TaskProfile* profile = findProfile(status[i].xHandle, created);
+        if (profile == nullptr) {
+            continue;
+        }
+        
+        profile->seen = true;
+        profile->priority = status[i].uxCurrentPriority;
+        profile->stackFree = status[i].usStackHighWaterMark;
+        if (created) {
+            strlcpy(profile->name, status[i].pcTaskName, sizeof(profile->name));
+        }
+
+#if configGENERATE_RUN_TIME_STATS
+        // A new task has no earlier counter to compare with
+        uint32_t runTime = status[i].ulRunTimeCounter;
+        if (!created && elapsed > 0) {
+            uint64_t share = (uint64_t)(runTime - profile->lastRunTime) * 1000 / elapsed;
+            profile->cpu[profile->next] = share > 1000 ? 1000 : share;
+            profile->next = (profile->next + 1) % TASK_PROFILER_WINDOW;
+            if (profile->samples < TASK_PROFILER_WINDOW) {
+                profile->samples++;
+            }
+        }
+        profile->lastRunTime = runTime;
+#endif
+    }
+    
+    // Deleted tasks give their slot back
+    for (TaskProfile& profile : profiles) {
+        if (!profile.seen) {
+            profile.handle = nullptr;
+        }
+    }
+
+#if !configGENERATE_RUN_TIME_STATS
+    sampleCores();
+#endif
+
+    xSemaphoreGive(mutex);
+    free(status);
+}
+
+#if !configGENERATE_RUN_TIME_STATS
+// Measure the idle loop rate of each core while nothing else runs
+void TaskProfiler::calibrateCores() {
+    for (int core = 0; core < TASK_PROFILER_CORES; core++) {
+        lastIdleCount[core] = idleCount[core];
+    }
+    lastCoreSampleTick = xTaskGetTickCount();
+    
+    // Called from setup(), so the loop task is blocked as well
+    vTaskDelay(pdMS_TO_TICKS(CALIBRATION_MS));
+    
+    TickType_t now = xTaskGetTickCount();
+    TickType_t elapsed = now - lastCoreSampleTick;
+    lastCoreSampleTick = now;
+    for (int core = 0; core < TASK_PROFILER_CORES; core++) {
+        uint32_t idle = idleCount[core];
+        idleRate[core] = elapsed > 0 ? (uint64_t)(idle - lastIdleCount[core]) * 1000 / elapsed : 0;
+        lastIdleCount[core] = idle;
+    }
+}
+
+// Take one sample of the core loads
+void TaskProfiler::sampleCores() {
+    TickType_t now = xTaskGetTickCount();
+    TickType_t elapsed = now - lastCoreSampleTick;
+    lastCoreSampleTick = now;
+    if (elapsed == 0) {
+        return;
+    }
+    
+    for (int core = 0; core < TASK_PROFILER_CORES; core++) {
+        uint32_t idle = idleCount[core];
+        uint32_t rate = (uint64_t)(idle - lastIdleCount[core]) * 1000 / elapsed;
+        lastIdleCount[core] = idle;
+        
+        // Calibration ran with some load left, this sample idled faster
+        if (rate > idleRate[core]) {
+            idleRate[core] = rate;
+        }
+        uint32_t idleShare = idleRate[core] > 0 ? (uint64_t)rate * 1000 / idleRate[core] : 0;
+        coreLoad[core][coreNext] = 1000 - idleShare;
+    }
+    
+    coreNext = (coreNext + 1) % TASK_PROFILER_WINDOW;
+    if (coreSamples < TASK_PROFILER_WINDOW) {
+        coreSamples++;
+    }
+}
+#endif
+
+// Find the profile of a task, claiming a free one if it is new
+TaskProfile* TaskProfiler::findProfile(TaskHandle_t handle, bool& created) {
+    TaskProfile* freeProfile = nullptr;
+    for (TaskProfile& profile : profiles) {
+        if (profile.handle == handle) {
+            created = false;
+            return &profile;
+        }
+        if (profile.handle == nullptr && freeProfile == nullptr) {
+            freeProfile = &profile;
+        }
+    }
+    
+    created = true;
+    if (freeProfile != nullptr) {
+        freeProfile->handle = handle;
+        freeProfile->next = 0;
+        freeProfile->samples = 0;
+        freeProfile->lastRunTime = 0;
+    }
+    return freeProfile;
+}
+
+// Average and maximum of a window of shares, in 0.1 %
+void TaskProfiler::summarize(const uint16_t* values, uint8_t samples, uint16_t& average, uint16_t& maximum) {
+    uint32_t sum = 0;
+    maximum = 0;
+    for (uint8_t i = 0; i < samples; i++) {
+        sum += values[i];
+        maximum = max(maximum, values[i]);
+    }
+    average = samples > 0 ? sum / samples : 0;
+}
+
+// Add one entry per task to a JSON array
+void TaskProfiler::addTasks(JsonArray tasks) {
+    if (mutex == nullptr) {
+        return;
+    }
+    
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (const TaskProfile& profile : profiles) {
+        if (profile.handle == nullptr) {
+            continue;
+        }
+        
+        JsonObject taskObj = tasks.createNestedObject();
+        taskObj["name"] = String(profile.name);
+        taskObj["priority"] = profile.priority;
+        taskObj["stackFree"] = profile.stackFree;
+        
+        // Percent of one core: latest sample, window average and peak
+        if (hasCpuStats() && profile.samples > 0) {
+            uint16_t average;
+            uint16_t maximum;
+            summarize(profile.cpu, profile.samples, average, maximum);
+            uint8_t latest = (profile.next + TASK_PROFILER_WINDOW - 1) % TASK_PROFILER_WINDOW;
+            taskObj["cpu"] = profile.cpu[latest] / 10.0;
+            taskObj["cpuAvg"] = average / 10.0;
+            taskObj["cpuMax"] = maximum / 10.0;
+        }
+    }
+    xSemaphoreGive(mutex);
+}
+
+// Add one entry per core to a JSON array (nothing without core stats)
+void TaskProfiler::addCores(JsonArray cores) {
+#if !configGENERATE_RUN_TIME_STATS
+    if (mutex == nullptr) {
+        return;
+    }
+    
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (coreSamples > 0) {
+        uint8_t latest = (coreNext + TASK_PROFILER_WINDOW - 1) % TASK_PROFILER_WINDOW;
+        for (int core = 0; core < TASK_PROFILER_CORES; core++) {
+            uint16_t average;
+            uint16_t maximum;
+            summarize(coreLoad[core], coreSamples, average, maximum);
+            
+            JsonObject coreObj = cores.createNestedObject();
+            coreObj["core"] = core;
+            coreObj["load"] = coreLoad[core][latest] / 10.0;
+            coreObj["loadAvg"] = average / 10.0;
+            coreObj["loadMax"] = maximum / 10.0;
+        }
+    }
+    xSemaphoreGive(mutex);
+#endif
+}
+
+// Copy the stack high-water marks of all tasks, returns how many were copied
+size_t TaskProfiler::getStacks(TaskStackFree* out, size_t max) {
+    if (mutex == nullptr) {
+        return 0;
+    }
+    
+    size_t count = 0;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (const TaskProfile& profile : profiles) {
+        if (profile.handle == nullptr || count == max) {
+            continue;
+        }
+        
+        strlcpy(out[count].name, profile.name, sizeof(out[count].name));
+        out[count].stackFree = profile.stackFree;
+        count++;
+    }
+    xSemaphoreGive(mutex);
+    return count;
+}
+
+// Print a table of all tasks
+void TaskProfiler::printReport(Print& out) {
+    if (mutex == nullptr) {
+        return;
+    }
+    
+    out.printf("%-16s %4s %7s %7s %7s %10s\n", "Task", "Prio", "CPU%", "Avg%", "Max%", "Stack free");
+    
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (const TaskProfile& profile : profiles) {
+        if (profile.handle == nullptr) {
+            continue;
+        }
+        
+        if (hasCpuStats() && profile.samples > 0) {
+            uint16_t average;
+            uint16_t maximum;
+            summarize(profile.cpu, profile.samples, average, maximum);
+            uint8_t latest = (profile.next + TASK_PROFILER_WINDOW - 1) % TASK_PROFILER_WINDOW;
+            out.printf("%-16s %4u %7.1f %7.1f %7.1f %10u\n", profile.name, profile.priority,
+                       profile.cpu[latest] / 10.0, average / 10.0, maximum / 10.0, profile.stackFree);
+        } else {
+            out.printf("%-16s %4u %7s %7s %7s %10u\n", profile.name, profile.priority, "-", "-", "-", profile.stackFree);
+        }
+    }
+
+#if !configGENERATE_RUN_TIME_STATS
+    // Per-task shares are not available, show how busy each core is
+    if (coreSamples > 0) {
+        uint8_t latest = (coreNext + TASK_PROFILER_WINDOW - 1) % TASK_PROFILER_WINDOW;
+        for (int core = 0; core < TASK_PROFILER_CORES; core++) {
+            uint16_t average;
+            uint16_t maximum;
+            summarize(coreLoad[core], coreSamples, average, maximum);
+            out.printf("Core %d load %17.1f %7.1f %7.1f\n", core, coreLoad[core][latest] / 10.0, average / 10.0, maximum / 10.0);
+        }
+    }
+#endif
+    xSemaphoreGive(mutex);
+    
+    out.printf("CPU shares are percent of one core over the last %u s\n",
+               TASK_PROFILER_WINDOW * SAMPLE_PERIOD_MS / 1000);
+}
+
+// Read serial console commands
+void TaskProfiler::readSerial() {
+    while (Serial.available() > 0) {
+        char c = Serial.read();
+        if (c != '\n' && c != '\r') {
+            if (serialLine.length() < 32) {
+                serialLine += c;
+            }
+            continue;
+        }
+        
+        serialLine.trim();
+        if (serialLine == "tasks") {
+            printReport(Serial);
+        }
+        serialLine = "";
+    }
+}
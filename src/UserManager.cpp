@@ -1,6 +1,7 @@
 #include "../include/UserManager.h"
 #include <FS.h>
 #include "../include/credentials.h"
+#include "../include/Metrics.h"
 
 // Constructor
 UserManager::UserManager() {
@@ -41,6 +42,8 @@ String UserManager::hashPassword(const String& password) {
 
 // Save users to file
 bool UserManager::saveUsers() {
+    uint32_t start = micros();
+    
     // Create a JSON document
     DynamicJsonDocument doc(4096);
     JsonArray usersArray = doc.createNestedArray("users");
@@ -63,6 +66,7 @@ bool UserManager::saveUsers() {
     File file = LittleFS.open(configFile, "w");
     if (!file) {
         Serial.println("Failed to open users file for writing");
+        metrics.recordWrite(metrics.userWrites, micros() - start, false);
         return false;
     }
     
@@ -70,10 +74,12 @@ bool UserManager::saveUsers() {
     if (serializeJson(doc, file) == 0) {
         Serial.println("Failed to write users to file");
         file.close();
+        metrics.recordWrite(metrics.userWrites, micros() - start, false);
         return false;
     }
     
     file.close();
+    metrics.recordWrite(metrics.userWrites, micros() - start, true);
     return true;
 }
 
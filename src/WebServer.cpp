@@ -1,5 +1,9 @@
 #include "../include/WebServer.h"
 #include <LittleFS.h>
+#include "../include/OtaManager.h"
+#ifdef WEB_ASSETS_IN_FLASH
+#include "WebAssetsData.h"
+#endif
 
 // Constructor
 WebServer::WebServer(WiFiManager* wifiManager, UserManager* userManager, DeviceManager* deviceManager) {
@@ -15,13 +19,31 @@ WebServer::WebServer(WiFiManager* wifiManager, UserManager* userManager, DeviceM
     
     // Create REST API
     this->restApi = new RestApi(server, userManager, deviceManager, sessionManager);
+    this->restApi->setWiFiManager(wifiManager);
     
-    // Create event source
-    this->events = new AsyncEventSource("/events");
+    // Create event stream
+    this->eventStream = new EventStream("/events", deviceManager);
+    
+    // Create admission control
+    this->admissionControl = new AdmissionControl();
+    
+    // Web activity keeps the radio out of modem sleep
+    admissionControl->onActivity([this]() {
+        this->wifiManager->noteActivity();
+    });
+    
+    // Follow device state changes from the start, before the control plane runs
+    // (the event stream drops them until it is started)
+    deviceManager->onStateChange([this](int channel, bool state) {
+        this->sendDeviceStateEvent(channel, state);
+    });
 }
 
 // Initialize the web server
 void WebServer::begin() {
+    // Shed load under memory pressure before any handler runs
+    admissionControl->attach(server);
+    
     // Initialize REST API
     restApi->begin();
     
@@ -31,17 +53,20 @@ void WebServer::begin() {
     // Serve static files
     serveStatic();
     
-    // Setup OTA updates
-    ElegantOTA.begin(server);
-    
-    // Add event handler
-    events->onConnect([this](AsyncEventSourceClient *client) {
-        // Send current device states when client connects
-        for (Device& device : deviceManager->getAllDevices()) {
-            this->sendDeviceStateEvent(device.channel, device.outputState[0]);
+    // Push device state and system status changes to the web UI; the stream
+    // carries network and heap details, so it needs a session like /api/status
+    eventStream->setFilter([this](AsyncWebServerRequest *request) {
+        return this->sessionManager->authMiddleware(request, this->userManager);
+    });
+    eventStream->setStatusProvider([this](JsonObject statusObj) {
+        this->restApi->addStatus(statusObj);
+    });
+    eventStream->begin(server);
+    WiFi.onEvent([this](WiFiEvent_t event, WiFiEventInfo_t info) {
+        if (event == SYSTEM_EVENT_STA_GOT_IP || event == SYSTEM_EVENT_STA_DISCONNECTED) {
+            this->eventStream->requestStatusCheck();
         }
     });
-    server->addHandler(events);
     
     // Start server
     server->begin();
@@ -52,19 +77,19 @@ void WebServer::begin() {
 // Setup web routes
 void WebServer::setupRoutes() {
     // Serve index page
-    server->on("/", HTTP_GET, [](AsyncWebServerRequest *request) {
-        request->send(LittleFS, "/index.html", "text/html");
+    server->on("/", HTTP_GET, [this](AsyncWebServerRequest *request) {
+        this->sendPage(request, "/index.html");
     });
     
     // Serve login page
-    server->on("/login", HTTP_GET, [](AsyncWebServerRequest *request) {
-        request->send(LittleFS, "/login.html", "text/html");
+    server->on("/login", HTTP_GET, [this](AsyncWebServerRequest *request) {
+        this->sendPage(request, "/login.html");
     });
     
     // Serve admin page
     server->on("/admin", HTTP_GET, [this](AsyncWebServerRequest *request) {
         if (sessionManager->adminMiddleware(request, userManager)) {
-            request->send(LittleFS, "/admin.html", "text/html");
+            this->sendPage(request, "/admin.html");
         } else {
             request->redirect("/login");
         }
@@ -77,27 +102,163 @@ void WebServer::setupRoutes() {
 }
 
 // Serve static files from LittleFS
+// CSS and JavaScript names carry a content hash (see scripts/pre_build.py) and
+// are stored as .gz only, which the static handler serves with
+// Content-Encoding: gzip. A changed file gets a new name, so browsers may cache
+// them forever.
 void WebServer::serveStatic() {
+#ifdef WEB_ASSETS_IN_FLASH
+    // Serve CSS, JavaScript and images straight from flash
+    auto handler = [this](AsyncWebServerRequest *request) {
+        if (!this->sendAsset(request, request->url())) {
+            request->send(404, "text/plain", "Not found");
+        }
+    };
+    server->on("/css/*", HTTP_GET, handler);
+    server->on("/js/*", HTTP_GET, handler);
+    server->on("/img/*", HTTP_GET, handler);
+#else
     // Serve CSS files
-    server->serveStatic("/css/", LittleFS, "/css/");
+    server->serveStatic("/css/", LittleFS, "/css/").setCacheControl("public, max-age=31536000, immutable");
     
     // Serve JavaScript files
-    server->serveStatic("/js/", LittleFS, "/js/");
+    server->serveStatic("/js/", LittleFS, "/js/").setCacheControl("public, max-age=31536000, immutable");
     
     // Serve images
-    server->serveStatic("/img/", LittleFS, "/img/");
+    server->serveStatic("/img/", LittleFS, "/img/").setCacheControl("public, max-age=86400");
+#endif
+}
+
+// Send an HTML page (stored gzipped, always revalidated against its ETag)
+void WebServer::sendPage(AsyncWebServerRequest *request, const char* path) {
+#ifdef WEB_ASSETS_IN_FLASH
+    if (sendAsset(request, path)) {
+        return;
+    }
+#endif
+
+    // Pages are stored as <path>.gz, served with Content-Encoding: gzip
+    String storedPath = LittleFS.exists(path) ? String(path) : String(path) + ".gz";
+    String etag = getPageEtag(storedPath);
+    
+    // Unchanged since the client's copy
+    if (etag.length() > 0 && request->hasHeader("If-None-Match") && request->getHeader("If-None-Match")->value() == etag) {
+        AsyncWebServerResponse *response = request->beginResponse(304);
+        response->addHeader("ETag", etag);
+        response->addHeader("Cache-Control", "no-cache");
+        request->send(response);
+        return;
+    }
+    
+    AsyncWebServerResponse *response = request->beginResponse(LittleFS, path, "text/html");
+    if (etag.length() > 0) {
+        response->addHeader("ETag", etag);
+    }
+    response->addHeader("Cache-Control", "no-cache");
+    request->send(response);
+}
+
+// Quoted content hash of a stored page, empty if it can't be read
+// Same value as the flash build's ETag (first 8 hex digits of the SHA-256 of
+// the stored bytes). Hashed once and again only after the file is replaced,
+// e.g. by a delta update.
+String WebServer::getPageEtag(const String& storedPath) {
+    File file = LittleFS.open(storedPath, FILE_READ);
+    if (!file) {
+        return String();
+    }
+    size_t size = file.size();
+    time_t lastWrite = file.getLastWrite();
+    file.close();
+    
+    PageEtag* entry = nullptr;
+    for (PageEtag& page : pageEtags) {
+        if (page.path == storedPath) {
+            entry = &page;
+            break;
+        }
+    }
+    if (entry != nullptr && entry->size == size && entry->lastWrite == lastWrite) {
+        return entry->etag;
+    }
+    
+    uint8_t digest[32];
+    if (!OtaManager::hashFile(storedPath, digest)) {
+        return String();
+    }
+    char etag[11];
+    snprintf(etag, sizeof(etag), "\"%02x%02x%02x%02x\"", digest[0], digest[1], digest[2], digest[3]);
+    
+    if (entry == nullptr) {
+        pageEtags.push_back(PageEtag());
+        entry = &pageEtags.back();
+        entry->path = storedPath;
+    }
+    entry->size = size;
+    entry->lastWrite = lastWrite;
+    entry->etag = etag;
+    return entry->etag;
 }
 
 // Send device state update event
 void WebServer::sendDeviceStateEvent(int channel, bool state) {
-    // Create JSON message
-    DynamicJsonDocument doc(128);
-    doc["channel"] = channel;
-    doc["state"] = state;
-    
-    String message;
-    serializeJson(doc, message);
+    // Coalesced with other changes and flushed by the event stream task
+    eventStream->publishState(channel, state);
+}
+
+#ifdef WEB_ASSETS_IN_FLASH
+// Send an asset compiled into flash, returns false if there is none for the path
+bool WebServer::sendAsset(AsyncWebServerRequest *request, const String& path) {
+    for (size_t i = 0; i < WEB_ASSET_COUNT; i++) {
+        const WebAsset& asset = WEB_ASSETS[i];
+        if (path != asset.path) {
+            continue;
+        }
+        
+        // Unchanged since the client's copy, the ETag is a content hash
+        if (request->hasHeader("If-None-Match") && request->getHeader("If-None-Match")->value() == asset.etag) {
+            AsyncWebServerResponse *response = request->beginResponse(304);
+            response->addHeader("ETag", asset.etag);
+            request->send(response);
+            return true;
+        }
+        
+        // Served from flash without copying
+        AsyncWebServerResponse *response = request->beginResponse(200, asset.contentType, asset.data, asset.length);
+        if (asset.compressed) {
+            response->addHeader("Content-Encoding", "gzip");
+        }
+        response->addHeader("ETag", asset.etag);
+        response->addHeader("Cache-Control", asset.immutable ? "public, max-age=31536000, immutable" : "no-cache");
+        request->send(response);
+        return true;
+    }
     
-    // Send event
-    events->send(message.c_str(), "state", millis());
+    return false;
+}
+#endif
+
+// Get the underlying server instance
+AsyncWebServer* WebServer::getServer() {
+    return server;
+}
+
+// Get the session manager
+SessionManager* WebServer::getSessionManager() {
+    return sessionManager;
+}
+
+// Get the admission control layer
+AdmissionControl* WebServer::getAdmissionControl() {
+    return admissionControl;
+}
+
+// Set the Alexa manager notified of device configuration changes
+void WebServer::setAlexaManager(AlexaManager* alexaManager) {
+    restApi->setAlexaManager(alexaManager);
+}
+
+// Set the control plane that applies device changes
+void WebServer::setControlPlane(ControlPlane* controlPlane) {
+    restApi->setControlPlane(controlPlane);
 }
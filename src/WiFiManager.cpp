@@ -1,4 +1,6 @@
 #include "../include/WiFiManager.h"
+#include "../include/Metrics.h"
+#include <esp_wifi.h>
 
 // Constructor
 WiFiManager::WiFiManager() : 
@@ -10,10 +12,23 @@ WiFiManager::WiFiManager() :
     channel(1),
     hideSsid(false),
     maxConnections(4),
+    state(WiFiState::IDLE),
+    disconnectCount(0),
+    reconnectAttempts(0),
+    disconnectReasonCount(0),
+    powerPolicy(WiFiPowerPolicy::AUTO),
+    powerSaveActive(false),
+    lastActivityMillis(0),
     useStaticIp(false),
     softApEnabled(false),
-    isConnected(false)
+    isConnected(false),
+    staticIpActive(false),
+    bssidPinned(false),
+    fastConnectUsed(false),
+    connectedAtMillis(0)
 {
+    cache.valid = false;
+    
     // Create the event group
     wifiEventGroup = xEventGroupCreate();
 }
@@ -24,12 +39,26 @@ void WiFiManager::begin(const char* ssid, const char* password, const char* host
     this->password = password;
     this->hostname = hostname;
     
-    // Set WiFi mode to station
-    WiFi.mode(WIFI_STA);
+    // Set WiFi mode to station, keeping the Soft AP if it was started first
+    WiFi.mode(softApEnabled ? WIFI_AP_STA : WIFI_STA);
     
     // Set hostname
     WiFi.setHostname(hostname);
     
+    // Reconnects are left to the supervisor task
+    WiFi.setAutoReconnect(false);
+    
+    // The Arduino core starts the station in modem sleep (WIFI_PS_MIN_MODEM)
+    powerSaveActive = true;
+    metrics.wifiPowerSave = true;
+    
+    // Restore the power-save policy
+    Preferences prefs;
+    if (prefs.begin("wifipower", true)) {
+        powerPolicy = static_cast<WiFiPowerPolicy>(prefs.getUChar("policy", static_cast<uint8_t>(WiFiPowerPolicy::AUTO)));
+        prefs.end();
+    }
+    
     // Register event handlers
     WiFi.onEvent([this](WiFiEvent_t event, WiFiEventInfo_t info) {
         switch (event) {
@@ -43,13 +72,21 @@ void WiFiManager::begin(const char* ssid, const char* password, const char* host
                 Serial.print("WiFi got IP: ");
                 Serial.println(WiFi.localIP());
                 isConnected = true;
+                state = WiFiState::CONNECTED;
+                if (connectedAtMillis == 0) {
+                    connectedAtMillis = millis();
+                }
+                xEventGroupClearBits(wifiEventGroup, WIFI_FAIL_BIT);
                 xEventGroupSetBits(wifiEventGroup, WIFI_CONNECTED_BIT);
                 break;
             case SYSTEM_EVENT_STA_DISCONNECTED:
-                Serial.println("WiFi disconnected, attempting to reconnect...");
+                Serial.printf("WiFi disconnected (reason %u)\n", info.disconnected.reason);
                 isConnected = false;
+                recordDisconnect(info.disconnected.reason);
+                
+                // Wake the supervisor, which decides when to reconnect
+                xEventGroupClearBits(wifiEventGroup, WIFI_CONNECTED_BIT);
                 xEventGroupSetBits(wifiEventGroup, WIFI_FAIL_BIT);
-                WiFi.reconnect();
                 break;
             default:
                 break;
@@ -58,43 +95,66 @@ void WiFiManager::begin(const char* ssid, const char* password, const char* host
     
     // Configure static IP if needed
     if (useStaticIp) {
-        if (!WiFi.config(localIp, gateway, subnet, primaryDns, secondaryDns)) {
+        if (WiFi.config(localIp, gateway, subnet, primaryDns, secondaryDns)) {
+            staticIpActive = true;
+        } else {
             Serial.println("WiFi static IP configuration failed");
         }
     }
     
-    // Connect to WiFi
-    WiFi.begin(ssid, password);
-    Serial.println("Connecting to WiFi...");
+    // Connect and then supervise the connection in the background, so
+    // nothing waits for the access point
+    xTaskCreatePinnedToCore(
+        wifiMonitorTask,
+        "WiFiMonitorTask",
+        4096,
+        this,
+        1,
+        &wifiMonitorTaskHandle,
+        0);
+}
+
+// Connect to the access point, waiting until connected or failed
+void WiFiManager::connect() {
+    state = WiFiState::CONNECTING;
     
-    // Wait for connection or timeout
-    EventBits_t bits = xEventGroupWaitBits(
-        wifiEventGroup,
-        WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
-        pdFALSE,
-        pdFALSE,
-        portMAX_DELAY);
+    // Try the cached access point first, skipping the scan
+    EventBits_t bits = 0;
+    if (loadConnectionCache() && connectFast()) {
+        fastConnectUsed = true;
+        bssidPinned = true;
+        bits = WIFI_CONNECTED_BIT;
+    } else {
+        // Full scan and associate
+        WiFi.begin(ssid, password);
+        Serial.println("Connecting to WiFi...");
+        
+        // Wait for connection or timeout
+        bits = xEventGroupWaitBits(
+            wifiEventGroup,
+            WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
+            pdFALSE,
+            pdFALSE,
+            portMAX_DELAY);
+    }
     
     if (bits & WIFI_CONNECTED_BIT) {
-        Serial.println("Connected to WiFi");
+        Serial.printf("Connected to WiFi in %lu ms (%s connect)\n", connectedAtMillis, fastConnectUsed ? "fast" : "full");
         Serial.print("IP address: ");
         Serial.println(WiFi.localIP());
+        saveConnectionCache();
+        
+        // Set the mode the policy wants, whatever the driver started with
+        updatePowerSave(true);
     } else if (bits & WIFI_FAIL_BIT) {
         Serial.println("Failed to connect to WiFi");
     } else {
         Serial.println("UNEXPECTED EVENT");
     }
-    
-    // Start WiFi monitoring task
-    xTaskCreatePinnedToCore(
-        wifiMonitorTask,
-        "WiFiMonitorTask",
-        4096,
-        this,
-        1,
-        &wifiMonitorTaskHandle,
-        0);
-    
+}
+
+// Start the mDNS responder (once connected)
+void WiFiManager::startMdns() {
     // Start mDNS responder
     if (MDNS.begin(hostname)) {
         Serial.println("mDNS responder started");
@@ -188,35 +248,314 @@ String WiFiManager::getHostname() {
     return WiFi.getHostname();
 }
 
-// WiFi monitoring task
+// Milliseconds from boot until the first connection, 0 if not connected yet
+unsigned long WiFiManager::getConnectTime() {
+    return connectedAtMillis;
+}
+
+// Whether the boot connection used the cached BSSID and channel
+bool WiFiManager::usedFastConnect() {
+    return fastConnectUsed;
+}
+
+// Load the cached connection from NVS
+bool WiFiManager::loadConnectionCache() {
+    Preferences prefs;
+    if (!prefs.begin("wifi", true)) {
+        return false;
+    }
+    
+    cache.valid = prefs.getBytes("bssid", cache.bssid, sizeof(cache.bssid)) == sizeof(cache.bssid);
+    cache.channel = prefs.getUChar("channel", 0);
+    prefs.end();
+    
+    cache.valid = cache.valid && cache.channel > 0;
+    return cache.valid;
+}
+
+// Save the current connection to NVS if it changed
+void WiFiManager::saveConnectionCache() {
+    WiFiConnectionCache current;
+    current.valid = true;
+    memcpy(current.bssid, WiFi.BSSID(), sizeof(current.bssid));
+    current.channel = WiFi.channel();
+    
+    // Only write when something changed, to spare the flash
+    if (cache.valid && memcmp(cache.bssid, current.bssid, sizeof(current.bssid)) == 0 && cache.channel == current.channel) {
+        return;
+    }
+    
+    Preferences prefs;
+    if (!prefs.begin("wifi", false)) {
+        Serial.println("Failed to open WiFi cache for writing");
+        return;
+    }
+    prefs.putBytes("bssid", current.bssid, sizeof(current.bssid));
+    prefs.putUChar("channel", current.channel);
+    prefs.end();
+    
+    cache = current;
+}
+
+// Forget the cached connection
+void WiFiManager::clearConnectionCache() {
+    Preferences prefs;
+    if (prefs.begin("wifi", false)) {
+        prefs.clear();
+        prefs.end();
+    }
+    cache.valid = false;
+}
+
+// Connect directly to the cached BSSID and channel
+bool WiFiManager::connectFast() {
+    Serial.printf("Fast connect to %02X:%02X:%02X:%02X:%02X:%02X on channel %u\n",
+                  cache.bssid[0], cache.bssid[1], cache.bssid[2], cache.bssid[3], cache.bssid[4], cache.bssid[5], cache.channel);
+    
+    // The address still comes from DHCP (unless a static IP is configured),
+    // so the lease is renewed for as long as the board runs; the router
+    // normally hands the same address to the same MAC anyway
+    xEventGroupClearBits(wifiEventGroup, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT);
+    WiFi.begin(ssid, password, cache.channel, cache.bssid);
+    
+    EventBits_t bits = xEventGroupWaitBits(
+        wifiEventGroup,
+        WIFI_CONNECTED_BIT,
+        pdFALSE,
+        pdFALSE,
+        pdMS_TO_TICKS(FAST_CONNECT_TIMEOUT_MS));
+    
+    if (bits & WIFI_CONNECTED_BIT) {
+        return true;
+    }
+    
+    // Access point moved, fall back to a full scan
+    Serial.println("Fast connect failed, falling back to full scan");
+    clearConnectionCache();
+    WiFi.disconnect();
+    
+    // Let the disconnect event pass before waiting again
+    vTaskDelay(pdMS_TO_TICKS(100));
+    xEventGroupClearBits(wifiEventGroup, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT);
+    return false;
+}
+
+// Get the supervisor state
+WiFiState WiFiManager::getState() {
+    return state;
+}
+
+// Get the number of disconnects since boot
+uint32_t WiFiManager::getDisconnectCount() {
+    return disconnectCount;
+}
+
+// Get the number of reconnect attempts since boot
+uint32_t WiFiManager::getReconnectAttempts() {
+    return reconnectAttempts;
+}
+
+// Copy the disconnect reason counters, returns how many were copied
+size_t WiFiManager::getDisconnectReasons(WiFiDisconnectCount* out, size_t max) {
+    portENTER_CRITICAL(&reasonLock);
+    size_t count = min(max, disconnectReasonCount);
+    memcpy(out, disconnectReasons, count * sizeof(WiFiDisconnectCount));
+    portEXIT_CRITICAL(&reasonLock);
+    return count;
+}
+
+// Count a disconnect and its reason (called from the WiFi event handler)
+void WiFiManager::recordDisconnect(uint8_t reason) {
+    disconnectCount++;
+    
+    portENTER_CRITICAL(&reasonLock);
+    size_t i = 0;
+    while (i < disconnectReasonCount && disconnectReasons[i].reason != reason) {
+        i++;
+    }
+    if (i == disconnectReasonCount && disconnectReasonCount < WIFI_MAX_DISCONNECT_REASONS) {
+        disconnectReasons[i] = {reason, 0};
+        disconnectReasonCount++;
+    }
+    if (i < disconnectReasonCount) {
+        disconnectReasons[i].count++;
+    }
+    portEXIT_CRITICAL(&reasonLock);
+}
+
+// Backoff before a reconnect attempt: exponential, capped, with jitter
+uint32_t WiFiManager::backoffDelay(uint32_t attempt) {
+    uint32_t delayMs = BACKOFF_BASE_MS << min(attempt, (uint32_t)6);
+    if (delayMs > BACKOFF_MAX_MS) {
+        delayMs = BACKOFF_MAX_MS;
+    }
+    
+    // Anywhere between half and the full delay, so boards that lost the
+    // same access point don't all come back at the same moment
+    return delayMs / 2 + esp_random() % (delayMs / 2 + 1);
+}
+
+// Reconnect until connected, backing off between attempts
+void WiFiManager::reconnectWithBackoff() {
+    for (uint32_t attempt = 0; !isConnected; attempt++) {
+        uint32_t delayMs = backoffDelay(attempt);
+        state = WiFiState::BACKOFF;
+        Serial.printf("WiFi reconnect attempt %u in %u ms\n", attempt + 1, delayMs);
+        
+        // Wait out the backoff, unless the connection comes back by itself
+        EventBits_t bits = xEventGroupWaitBits(
+            wifiEventGroup,
+            WIFI_CONNECTED_BIT,
+            pdFALSE,
+            pdFALSE,
+            pdMS_TO_TICKS(delayMs));
+        if (bits & WIFI_CONNECTED_BIT) {
+            break;
+        }
+        
+        state = WiFiState::CONNECTING;
+        reconnectAttempts++;
+        xEventGroupClearBits(wifiEventGroup, WIFI_FAIL_BIT);
+        if (bssidPinned && attempt >= PINNED_RECONNECT_ATTEMPTS) {
+            // The access point may have been replaced or moved channel:
+            // forget it and let the driver scan for the network again
+            Serial.println("Cached access point unreachable, falling back to full scan");
+            clearConnectionCache();
+            bssidPinned = false;
+            WiFi.begin(ssid, password);
+        } else {
+            WiFi.reconnect();
+        }
+        
+        // Wait for connection, failure or timeout
+        bits = xEventGroupWaitBits(
+            wifiEventGroup,
+            WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
+            pdFALSE,
+            pdFALSE,
+            pdMS_TO_TICKS(CONNECT_TIMEOUT_MS));
+        if (bits & WIFI_CONNECTED_BIT) {
+            break;
+        }
+    }
+    
+    // Drop failures left over from the attempts, unless the link went down again
+    xEventGroupClearBits(wifiEventGroup, WIFI_FAIL_BIT);
+    if (!isConnected) {
+        xEventGroupSetBits(wifiEventGroup, WIFI_FAIL_BIT);
+        return;
+    }
+    
+    Serial.println("Reconnected to WiFi");
+    Serial.print("IP address: ");
+    Serial.println(WiFi.localIP());
+    
+    // Remember the access point found by the scan for the next boot
+    saveConnectionCache();
+    updatePowerSave(true);
+}
+
+// Note web activity (keeps the radio awake under the auto policy)
+void WiFiManager::noteActivity() {
+    lastActivityMillis = millis();
+    
+    // Wake the radio right away, the supervisor takes it from there
+    if (powerSaveActive && powerPolicy == WiFiPowerPolicy::AUTO) {
+        applyPowerSave(false);
+        xEventGroupSetBits(wifiEventGroup, WIFI_ACTIVITY_BIT);
+    }
+}
+
+// Set and persist the power-save policy
+void WiFiManager::setPowerPolicy(WiFiPowerPolicy policy) {
+    powerPolicy = policy;
+    
+    Preferences prefs;
+    if (prefs.begin("wifipower", false)) {
+        prefs.putUChar("policy", static_cast<uint8_t>(policy));
+        prefs.end();
+    }
+    
+    // Let the supervisor apply it
+    xEventGroupSetBits(wifiEventGroup, WIFI_ACTIVITY_BIT);
+}
+
+// Get the power-save policy
+WiFiPowerPolicy WiFiManager::getPowerPolicy() {
+    return powerPolicy;
+}
+
+// Whether modem sleep is currently enabled
+bool WiFiManager::isPowerSaveActive() {
+    return powerSaveActive;
+}
+
+// Switch modem sleep on or off
+void WiFiManager::applyPowerSave(bool enable) {
+    if (esp_wifi_set_ps(enable ? WIFI_PS_MIN_MODEM : WIFI_PS_NONE) != ESP_OK) {
+        Serial.println("Failed to set WiFi power save mode");
+        return;
+    }
+    
+    if (powerSaveActive.exchange(enable) != enable) {
+        metrics.wifiPowerSave = enable;
+        metrics.wifiPowerSaveSwitches++;
+    }
+}
+
+// Apply the policy to the current activity (force: set the mode even if it looks unchanged)
+void WiFiManager::updatePowerSave(bool force) {
+    bool enable;
+    switch (powerPolicy.load()) {
+        case WiFiPowerPolicy::PERFORMANCE:
+            enable = false;
+            break;
+        case WiFiPowerPolicy::POWER_SAVE:
+            enable = true;
+            break;
+        default:
+            // An open event stream means someone is watching the UI
+            enable = millis() - lastActivityMillis >= POWER_SAVE_IDLE_MS && metrics.sseClients == 0;
+            break;
+    }
+    
+    if (force || enable != powerSaveActive) {
+        applyPowerSave(enable);
+    }
+}
+
+// How long the supervisor may sleep before the next power-save check
+TickType_t WiFiManager::powerCheckTicks() {
+    // Only the auto policy with the radio awake has a deadline to watch
+    if (powerPolicy == WiFiPowerPolicy::AUTO && !powerSaveActive) {
+        return pdMS_TO_TICKS(POWER_SAVE_CHECK_MS);
+    }
+    return portMAX_DELAY;
+}
+
+// WiFi supervisor task (initial connect, then reconnects on disconnect)
 void WiFiManager::wifiMonitorTask(void* parameter) {
     WiFiManager* wifiManager = static_cast<WiFiManager*>(parameter);
     
+    // Initial connection
+    wifiManager->connect();
+    
     for (;;) {
-        // Check WiFi connection status
-        if (WiFi.status() != WL_CONNECTED) {
-            Serial.println("WiFi connection lost, attempting to reconnect...");
-            WiFi.disconnect();
-            WiFi.reconnect();
-            
-            // Wait for connection or timeout
-            EventBits_t bits = xEventGroupWaitBits(
-                wifiManager->wifiEventGroup,
-                WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
-                pdFALSE,
-                pdFALSE,
-                10000 / portTICK_PERIOD_MS);
-            
-            if (bits & WIFI_CONNECTED_BIT) {
-                Serial.println("Reconnected to WiFi");
-                Serial.print("IP address: ");
-                Serial.println(WiFi.localIP());
-            } else if (bits & WIFI_FAIL_BIT) {
-                Serial.println("Failed to reconnect to WiFi");
-            }
+        // Sleep until the connection drops, the power-save state needs a
+        // look, or (radio awake under the auto policy) the idle check is due
+        EventBits_t bits = xEventGroupWaitBits(
+            wifiManager->wifiEventGroup,
+            WIFI_FAIL_BIT | WIFI_ACTIVITY_BIT,
+            pdTRUE,
+            pdFALSE,
+            wifiManager->powerCheckTicks());
+        
+        if ((bits & WIFI_FAIL_BIT) && !wifiManager->isConnected) {
+            wifiManager->reconnectWithBackoff();
         }
         
-        // Check every 30 seconds
-        vTaskDelay(30000 / portTICK_PERIOD_MS);
+        if (wifiManager->isConnected) {
+            wifiManager->updatePowerSave();
+        }
     }
 }
@@ -6,6 +6,9 @@
 #include "WebServer.h"
 #include "OtaManager.h"
 #include "AlexaManager.h"
+#include "ControlPlane.h"
+#include "TaskProfiler.h"
+#include "LoopMonitor.h"
 #include "credentials.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -14,19 +17,38 @@
 WiFiManager wifiManager;
 UserManager userManager;
 DeviceManager deviceManager;
+ControlPlane controlPlane(&deviceManager);
 WebServer* webServer;
 OtaManager* otaManager;
 AlexaManager* alexaManager;
 
-// Task handles
-TaskHandle_t taskButtonsHandle;
+// Set once the network services have been started
+bool networkServicesStarted = false;
 
-// Task to check physical buttons
-void taskButtons(void* parameter) {
-  for (;;) {
-    deviceManager.checkInputs();
-    vTaskDelay(pdMS_TO_TICKS(30)); // debounce and CPU friendly
-  }
+// Start the services that need the network, once WiFi is connected
+void startNetworkServices() {
+  // mDNS
+  wifiManager.startMdns();
+  
+  // Web server
+  webServer->begin();
+  
+  // Create OTA manager
+  AsyncWebServer* server = webServer->getServer();
+  otaManager = new OtaManager(server, &userManager, webServer->getSessionManager());
+  otaManager->setAdmissionControl(webServer->getAdmissionControl());
+  otaManager->begin();
+  otaManager->setEnabled(true);
+  
+  // Alexa
+  alexaManager->begin(server);
+  
+  networkServicesStarted = true;
+  Serial.println("Network services started");
+  
+  // Time until devices can be toggled over the network
+  Serial.printf("Time to first toggle: %lu ms (WiFi %s connect after %lu ms)\n",
+                millis(), wifiManager.usedFastConnect() ? "fast" : "full", wifiManager.getConnectTime());
 }
 
 void setup() {
@@ -34,26 +56,13 @@ void setup() {
   Serial.begin(115200);
   Serial.println("\n\nESP32 Smart Home System Starting...");
   
+  // Stage 1: local control (filesystem, pins, buttons), no network needed
+  
   // Initialize LittleFS
   if (!LittleFS.begin(true)) {
     Serial.println("Failed to mount LittleFS");
   }
   
-  // Initialize WiFi
-  wifiManager.begin(WIFI_SSID, WIFI_PASSWORD, "esp32-smart-home");
-  
-  // Configure static IP if needed
-  IPAddress localIP(192, 168, 0, 222);
-  IPAddress gateway(192, 168, 0, 1);
-  IPAddress subnet(255, 255, 0, 0);
-  IPAddress primaryDNS(8, 8, 8, 8);
-  IPAddress secondaryDNS(8, 8, 4, 4);
-  wifiManager.configureStaticIp(localIP, gateway, subnet, primaryDNS, secondaryDNS);
-  
-  // Configure and start Soft AP
-  wifiManager.configureSoftAp(SOFT_AP_SSID, SOFT_AP_PASSWORD, 10, false, 2);
-  wifiManager.startSoftAp();
-  
   // Initialize user manager
   if (!userManager.begin()) {
     Serial.println("Failed to initialize user manager");
@@ -64,41 +73,77 @@ void setup() {
     Serial.println("Failed to initialize device manager");
   }
   
-  // Create web server
+  // Create web server and Alexa manager (started later); they subscribe to
+  // device state changes, which must happen before the control plane starts
   webServer = new WebServer(&wifiManager, &userManager, &deviceManager);
-  webServer->begin();
+  alexaManager = new AlexaManager(&deviceManager);
+  webServer->setAlexaManager(alexaManager);
+  webServer->setControlPlane(&controlPlane);
+  alexaManager->setControlPlane(&controlPlane);
   
-  // Create OTA manager
-  AsyncWebServer* server = webServer->getServer();
-  otaManager = new OtaManager(server);
-  otaManager->begin();
-  otaManager->setEnabled(true);
+  // Start the control plane (buttons and all device changes)
+  if (!controlPlane.begin()) {
+    Serial.println("Failed to start control plane");
+  }
   
-  // Create Alexa manager
-  alexaManager = new AlexaManager(&deviceManager);
-  alexaManager->begin();
-  
-  // Create button checking task
-  xTaskCreatePinnedToCore(
-    taskButtons,
-    "TaskButtons",
-    4096,
-    NULL,
-    1,
-    &taskButtonsHandle,
-    1
-  );
+  // Start the task profiler (GET /api/tasks, "tasks" on the serial console)
+  if (!taskProfiler.begin()) {
+    Serial.println("Failed to start task profiler");
+  }
+  
+  Serial.printf("Local control ready after %lu ms\n", millis());
+  
+  // Stage 2: network, connecting in the background
+  
+  // Configure and start Soft AP
+  wifiManager.configureSoftAp(SOFT_AP_SSID, SOFT_AP_PASSWORD, 10, false, 2);
+  wifiManager.startSoftAp();
+  
+  // Initialize WiFi
+  wifiManager.begin(WIFI_SSID, WIFI_PASSWORD, "esp32-smart-home");
+  
+  // Configure static IP if needed
+  IPAddress localIP(192, 168, 0, 222);
+  IPAddress gateway(192, 168, 0, 1);
+  IPAddress subnet(255, 255, 0, 0);
+  IPAddress primaryDNS(8, 8, 8, 8);
+  IPAddress secondaryDNS(8, 8, 4, 4);
+  wifiManager.configureStaticIp(localIP, gateway, subnet, primaryDNS, secondaryDNS);
+  
+  // Trace loop handlers and wake the loop as soon as WiFi connects
+  if (!loopMonitor.begin()) {
+    Serial.println("Failed to start loop monitor");
+  }
+  WiFi.onEvent([](WiFiEvent_t event, WiFiEventInfo_t info) {
+    loopMonitor.wake();
+  }, SYSTEM_EVENT_STA_GOT_IP);
   
   Serial.println("ESP32 Smart Home System Started");
 }
 
 void loop() {
+  // Sleep until there is work (or the poll period runs out)
+  loopMonitor.wait();
+  
+  // Stage 3: network services, started once WiFi reports a connection
+  if (!networkServicesStarted && wifiManager.isWiFiConnected()) {
+    loopMonitor.enter(LoopHandler::NETWORK);
+    startNetworkServices();
+    loopMonitor.leave();
+  }
+  
   // Handle Alexa events
+  loopMonitor.enter(LoopHandler::ALEXA);
   alexaManager->handle();
+  loopMonitor.leave();
   
   // Handle OTA updates
-  otaManager->handle();
+  if (otaManager != nullptr) {
+    loopMonitor.enter(LoopHandler::OTA);
+    otaManager->handle();
+    loopMonitor.leave();
+  }
   
-  // Small delay to prevent watchdog issues
-  delay(10);
+  // Log the iteration if it went over budget
+  loopMonitor.endIteration();
 }
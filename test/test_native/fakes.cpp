@@ -0,0 +1,41 @@
+// Link-time stand-ins for the managers the native build leaves out
+// (WiFiManager and AlexaManager drive the radio and the Hue emulation).
+// RestApi only calls them when they are set, which the tests don't do.
+
+#include "../../include/WiFiManager.h"
+#include "../../include/AlexaManager.h"
+
+WiFiState WiFiManager::getState() {
+    return WiFiState::IDLE;
+}
+
+uint32_t WiFiManager::getDisconnectCount() {
+    return 0;
+}
+
+uint32_t WiFiManager::getReconnectAttempts() {
+    return 0;
+}
+
+size_t WiFiManager::getDisconnectReasons(WiFiDisconnectCount* out, size_t max) {
+    return 0;
+}
+
+void WiFiManager::setPowerPolicy(WiFiPowerPolicy policy) {
+}
+
+WiFiPowerPolicy WiFiManager::getPowerPolicy() {
+    return WiFiPowerPolicy::AUTO;
+}
+
+bool WiFiManager::isPowerSaveActive() {
+    return false;
+}
+
+bool AlexaManager::addOrUpdateDevice(int channel) {
+    return false;
+}
+
+bool AlexaManager::removeDevice(int channel) {
+    return false;
+}
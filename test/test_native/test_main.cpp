@@ -0,0 +1,316 @@
+// Host tests for the managers and the REST API, built against the
+// NativeArduino stand-ins (lib/NativeArduino).
+//
+// Run with:
+//   pio test -e native
+
+#include <Arduino.h>
+#include <NativeArduino.h>
+#include <LittleFS.h>
+#include <ESPAsyncWebServer.h>
+#include <Update.h>
+#include <mbedtls/sha256.h>
+#include <unity.h>
+#include "../../include/DeviceManager.h"
+#include "../../include/UserManager.h"
+#include "../../include/SessionManager.h"
+#include "../../include/ControlPlane.h"
+#include "../../include/RestApi.h"
+#include "../../include/AdmissionControl.h"
+#include "../../include/OtaManager.h"
+#include "../../include/Metrics.h"
+
+void setUp() {
+    // Every test starts from an empty filesystem
+    LittleFS.begin(true);
+    LittleFS.format();
+}
+
+void tearDown() {
+}
+
+// Send a request through the server and return it with its response
+static AsyncWebServerRequest* request(AsyncWebServer& server, WebRequestMethodComposite method, const char* url,
+                                      const String& cookie = String(), const char* json = nullptr) {
+    AsyncWebServerRequest* req = new AsyncWebServerRequest(method, url);
+    if (cookie.length() > 0) {
+        req->setHeader("Cookie", cookie);
+    }
+    if (json != nullptr) {
+        req->setBody(json, "application/json");
+    }
+    server.dispatch(req);
+    return req;
+}
+
+void test_devices_created_and_saved_on_first_boot() {
+    DeviceManager devices;
+    TEST_ASSERT_TRUE(devices.begin());
+    TEST_ASSERT_EQUAL(4, devices.getAllDevices().size());
+    TEST_ASSERT_TRUE(LittleFS.exists("/devices.json"));
+    
+    // Relays are active low, so off drives the pin high
+    TEST_ASSERT_EQUAL(OUTPUT, NativeArduino::getPinMode(21));
+    TEST_ASSERT_EQUAL(HIGH, NativeArduino::getPinLevel(21));
+    
+    // A second boot loads the same devices from the file
+    DeviceManager reloaded;
+    TEST_ASSERT_TRUE(reloaded.begin());
+    TEST_ASSERT_EQUAL(4, reloaded.getAllDevices().size());
+    Device device;
+    TEST_ASSERT_TRUE(reloaded.getDevice(3, device));
+    TEST_ASSERT_EQUAL_STRING("Luz_Quarto", device.name.c_str());
+    TEST_ASSERT_EQUAL(2, device.inputPins.size());
+}
+
+void test_toggle_drives_output_and_saves_after_quiet_time() {
+    DeviceManager devices;
+    devices.begin();
+    
+    int notifiedChannel = -1;
+    bool notifiedState = false;
+    devices.onStateChange([&](int channel, bool state) {
+        notifiedChannel = channel;
+        notifiedState = state;
+    });
+    
+    TEST_ASSERT_TRUE(devices.toggleDevice(1, true));
+    TEST_ASSERT_EQUAL(LOW, NativeArduino::getPinLevel(22));
+    TEST_ASSERT_EQUAL(1, notifiedChannel);
+    TEST_ASSERT_TRUE(notifiedState);
+    
+    // The write waits for the state to settle
+    devices.handle();
+    DeviceManager early;
+    early.begin();
+    TEST_ASSERT_FALSE(early.getDeviceState(1));
+    
+    NativeArduino::advanceMillis(DeviceManager::STATE_SAVE_DELAY_MS);
+    devices.handle();
+    DeviceManager saved;
+    saved.begin();
+    TEST_ASSERT_TRUE(saved.getDeviceState(1));
+}
+
+void test_configuration_saved_by_writer_task() {
+    // Never destroyed, as the writer task keeps using it
+    static DeviceManager& devices = *new DeviceManager();
+    devices.begin();
+    TEST_ASSERT_TRUE(devices.startWriter());
+    
+    Device device;
+    TEST_ASSERT_TRUE(devices.getDevice(3, device));
+    device.name = "Luz_Escritorio";
+    uint32_t writes = metrics.deviceWrites.count;
+    TEST_ASSERT_TRUE(devices.updateDevice(3, device));
+    
+    // The update returns once the write is queued
+    for (int i = 0; i < 100 && metrics.deviceWrites.count == writes; i++) {
+        delay(10);
+    }
+    TEST_ASSERT_EQUAL(writes + 1, metrics.deviceWrites.count.load());
+    
+    DeviceManager saved;
+    saved.begin();
+    TEST_ASSERT_TRUE(saved.getDevice(3, device));
+    TEST_ASSERT_EQUAL_STRING("Luz_Escritorio", device.name.c_str());
+}
+
+void test_button_press_reported_once_per_edge() {
+    DeviceManager devices;
+    devices.begin();
+    
+    // Inputs are pulled up, so take the idle levels as the starting point
+    devices.checkInputs([](int channel) {});
+    
+    std::vector<int> presses;
+    auto record = [&](int channel) { presses.push_back(channel); };
+    
+    NativeArduino::setPinLevel(27, LOW);
+    devices.checkInputs(record);
+    NativeArduino::setPinLevel(27, HIGH);
+    devices.checkInputs(record);
+    devices.checkInputs(record);
+    
+    TEST_ASSERT_EQUAL(1, presses.size());
+    TEST_ASSERT_EQUAL(3, presses[0]);
+}
+
+void test_users_authenticate_and_check_permissions() {
+    UserManager users;
+    TEST_ASSERT_TRUE(users.begin());
+    TEST_ASSERT_TRUE(users.authenticate("admin", "admin123"));
+    TEST_ASSERT_FALSE(users.authenticate("admin", "wrong"));
+    
+    TEST_ASSERT_TRUE(users.addUser("guest", "secret", UserRole::OPERATOR, {1}));
+    TEST_ASSERT_TRUE(users.authenticate("guest", "secret"));
+    TEST_ASSERT_TRUE(users.canControlDevice("guest", 1));
+    TEST_ASSERT_FALSE(users.canControlDevice("guest", 2));
+    
+    // Users are kept across boots
+    UserManager reloaded;
+    reloaded.begin();
+    TEST_ASSERT_TRUE(reloaded.getUserRole("guest") == UserRole::OPERATOR);
+}
+
+void test_sessions_expire_after_an_hour_idle() {
+    SessionManager sessions;
+    String sessionId = sessions.createSession("admin");
+    TEST_ASSERT_TRUE(sessions.validateSession(sessionId));
+    TEST_ASSERT_EQUAL_STRING("admin", sessions.getUsernameFromSession(sessionId).c_str());
+    
+    NativeArduino::advanceMillis(3600000 + 1);
+    TEST_ASSERT_FALSE(sessions.validateSession(sessionId));
+}
+
+void test_rest_api_login_list_and_toggle() {
+    // Never destroyed, as the control plane task keeps using them
+    static DeviceManager& devices = *new DeviceManager();
+    static UserManager users;
+    static SessionManager sessions;
+    static ControlPlane& controlPlane = *new ControlPlane(&devices);
+    static AsyncWebServer server(80);
+    static RestApi api(&server, &users, &devices, &sessions);
+    
+    devices.begin();
+    users.begin();
+    api.setControlPlane(&controlPlane);
+    api.begin();
+    devices.checkInputs([](int channel) {});
+    TEST_ASSERT_TRUE(controlPlane.begin());
+    
+    // Without a session the API refuses
+    AsyncWebServerRequest* req = request(server, HTTP_GET, "/api/devices");
+    TEST_ASSERT_EQUAL(401, req->responseCode());
+    delete req;
+    
+    req = request(server, HTTP_POST, "/api/login", String(), "{\"username\":\"admin\",\"password\":\"admin123\"}");
+    TEST_ASSERT_EQUAL(200, req->responseCode());
+    const AsyncWebHeader* setCookie = req->responseHeader("Set-Cookie");
+    TEST_ASSERT_NOT_NULL(setCookie);
+    String cookie = setCookie->value().substring(0, setCookie->value().indexOf(";"));
+    delete req;
+    
+    req = request(server, HTTP_GET, "/api/devices", cookie);
+    TEST_ASSERT_EQUAL(200, req->responseCode());
+    TEST_ASSERT_TRUE(req->responseBody().indexOf("\"Luz_Corredor_Quintal\"") != -1);
+    delete req;
+    
+    req = request(server, HTTP_POST, "/api/devices/toggle", cookie, "{\"channel\":2}");
+    TEST_ASSERT_EQUAL(200, req->responseCode());
+    delete req;
+    
+    // Commands run in order on the control plane, so this sees the toggle
+    TEST_ASSERT_TRUE(controlPlane.call([]() { return devices.getDeviceState(2); }));
+    TEST_ASSERT_EQUAL(LOW, NativeArduino::getPinLevel(23));
+    
+    // Malformed JSON never reaches the handler
+    req = request(server, HTTP_POST, "/api/devices/toggle", cookie, "{\"channel\":");
+    TEST_ASSERT_EQUAL(400, req->responseCode());
+    delete req;
+}
+
+// Post a binary upload with its SHA-256 header
+static AsyncWebServerRequest* upload(AsyncWebServer& server, const char* url, const String& cookie,
+                                     const uint8_t* data, size_t len, const char* digestHeader, const String& digest) {
+    AsyncWebServerRequest* req = new AsyncWebServerRequest(HTTP_POST, url);
+    req->setHeader("Cookie", cookie);
+    req->setHeader(digestHeader, digest);
+    req->setBody(data, len, "application/octet-stream");
+    server.dispatch(req);
+    return req;
+}
+
+// Hex SHA-256 of a buffer
+static String sha256Hex(const uint8_t* data, size_t len) {
+    mbedtls_sha256_context sha;
+    uint8_t digest[32];
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    mbedtls_sha256_update(&sha, data, len);
+    mbedtls_sha256_finish(&sha, digest);
+    mbedtls_sha256_free(&sha);
+    
+    char hex[65];
+    for (int i = 0; i < 32; i++) {
+        snprintf(hex + i * 2, 3, "%02x", digest[i]);
+    }
+    return String(hex);
+}
+
+void test_ota_uploads_release_admission_slot() {
+    static UserManager users;
+    static SessionManager sessions;
+    static AsyncWebServer server(80);
+    static AdmissionControl admission;
+    static OtaManager ota(&server, &users, &sessions);
+    
+    users.begin();
+    admission.attach(&server);
+    ota.setAdmissionControl(&admission);
+    ota.begin();
+    ota.setEnabled(true);
+    String cookie = "session=" + sessions.createSession("admin");
+    
+    uint8_t image[4096];
+    for (size_t i = 0; i < sizeof(image); i++) {
+        image[i] = i * 7;
+    }
+    image[0] = 0xE9;
+    
+    // The request counts as in flight until its connection is released
+    AsyncWebServerRequest* req = upload(server, "/ota/firmware", cookie, image, sizeof(image), "X-Firmware-SHA256", sha256Hex(image, sizeof(image)));
+    TEST_ASSERT_EQUAL(200, req->responseCode());
+    TEST_ASSERT_EQUAL(sizeof(image), Update.activatedImage().size());
+    TEST_ASSERT_EQUAL(1, admission.getInFlight());
+    delete req;
+    TEST_ASSERT_EQUAL(0, admission.getInFlight());
+    
+    // A rejected image releases its slot as well
+    req = upload(server, "/ota/firmware", cookie, image, sizeof(image), "X-Firmware-SHA256", sha256Hex(image, 16));
+    TEST_ASSERT_EQUAL(400, req->responseCode());
+    TEST_ASSERT_TRUE(req->responseBody().indexOf("SHA-256 mismatch") != -1);
+    delete req;
+    TEST_ASSERT_EQUAL(0, admission.getInFlight());
+    
+    // A connection lost halfway aborts the update
+    req = new AsyncWebServerRequest(HTTP_POST, "/ota/firmware");
+    req->setHeader("Cookie", cookie);
+    req->setHeader("X-Firmware-SHA256", sha256Hex(image, sizeof(image)));
+    req->setBody(image, sizeof(image) / 2, "application/octet-stream");
+    req->setHeader("Content-Length", String((unsigned long)sizeof(image)));
+    server.dispatch(req);
+    TEST_ASSERT_TRUE(Update.isRunning());
+    delete req;
+    TEST_ASSERT_FALSE(Update.isRunning());
+    TEST_ASSERT_FALSE(metrics.otaInProgress);
+    TEST_ASSERT_EQUAL(0, admission.getInFlight());
+    
+    // Every file of a delta update is its own request
+    const char* css = "body { margin: 0; }";
+    for (int i = 0; i < 8; i++) {
+        req = new AsyncWebServerRequest(HTTP_POST, "/ota/fs/file");
+        req->setParam("path", "/css/style.css");
+        req->setHeader("Cookie", cookie);
+        req->setHeader("X-File-SHA256", sha256Hex((const uint8_t*)css, strlen(css)));
+        req->setBody((const uint8_t*)css, strlen(css), "application/octet-stream");
+        server.dispatch(req);
+        TEST_ASSERT_EQUAL(200, req->responseCode());
+        delete req;
+    }
+    TEST_ASSERT_EQUAL(0, admission.getInFlight());
+    TEST_ASSERT_TRUE(LittleFS.exists("/css/style.css"));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_devices_created_and_saved_on_first_boot);
+    RUN_TEST(test_toggle_drives_output_and_saves_after_quiet_time);
+    RUN_TEST(test_configuration_saved_by_writer_task);
+    RUN_TEST(test_button_press_reported_once_per_edge);
+    RUN_TEST(test_users_authenticate_and_check_permissions);
+    RUN_TEST(test_sessions_expire_after_an_hour_idle);
+    RUN_TEST(test_rest_api_login_list_and_toggle);
+    RUN_TEST(test_ota_uploads_release_admission_slot);
+    return UNITY_END();
+}